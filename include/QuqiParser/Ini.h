@@ -16,6 +16,7 @@
 #define INI_HPP
 
 #include <unordered_map>
+#include <functional>
 #include <string>
 #include <string_view>
 #include <fstream>
@@ -26,6 +27,22 @@ namespace qini
     class INIParser;
     class INIWriter;
 
+    /**
+     * @brief Hash of section and key names that also takes std::string_view, so lookups don't build a std::string.
+     */
+    struct name_hash_t
+    {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view name) const noexcept
+        {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    using keys_t = std::unordered_map<std::string, std::string, name_hash_t, std::equal_to<>>;
+    using sections_t = std::unordered_map<std::string, keys_t, name_hash_t, std::equal_to<>>;
+
     /**
      * @brief Class representing an INI object.
      */
@@ -44,9 +61,9 @@ namespace qini
             class iterator
             {
             public:
-                iterator(const std::unordered_map<std::string, std::string>::iterator& itor);
+                iterator(const keys_t::iterator& itor);
 
-                iterator(std::unordered_map<std::string, std::string>::iterator&& itor);
+                iterator(keys_t::iterator&& itor);
 
                 iterator& operator ++();
 
@@ -57,10 +74,10 @@ namespace qini
                 friend bool operator !=(const iterator& a, const iterator& b);
 
             private:
-                std::unordered_map<std::string, std::string>::iterator m_itor;
+                keys_t::iterator m_itor;
             };
 
-            Section(std::unordered_map<std::string, std::string>& section);
+            Section(keys_t& section);
 
             Section(const Section&) = delete;
             Section(Section&&) = delete;
@@ -68,16 +85,16 @@ namespace qini
             Section& operator =(const Section&) = delete;
             Section& operator =(Section&&) = delete;
 
-            std::string& operator [](const std::string& keyName);
+            std::string& operator [](std::string_view keyName);
 
-            const std::string& operator [](const std::string& keyName) const;
+            const std::string& operator [](std::string_view keyName) const;
 
             iterator begin();
 
             iterator end();
 
         private:
-            std::unordered_map<std::string, std::string>& m_keys;
+            keys_t& m_keys;
         };
 
         /**
@@ -92,9 +109,9 @@ namespace qini
             class const_iterator
             {
             public:
-                const_iterator(const std::unordered_map<std::string, std::string>::const_iterator& itor);
+                const_iterator(const keys_t::const_iterator& itor);
 
-                const_iterator(std::unordered_map<std::string, std::string>::const_iterator&& itor);
+                const_iterator(keys_t::const_iterator&& itor);
 
                 const_iterator& operator ++();
 
@@ -105,10 +122,10 @@ namespace qini
                 friend bool operator !=(const const_iterator& a, const const_iterator& b);
 
             private:
-                std::unordered_map<std::string, std::string>::const_iterator m_itor;
+                keys_t::const_iterator m_itor;
             };
 
-            Const_Section(const std::unordered_map<std::string, std::string>& section);
+            Const_Section(const keys_t& section);
 
             Const_Section(const Section&) = delete;
             Const_Section(Section&&) = delete;
@@ -116,14 +133,14 @@ namespace qini
             Const_Section& operator =(const Section&) = delete;
             Const_Section& operator =(Section&&) = delete;
 
-            const std::string& operator [](const std::string& keyName) const;
+            const std::string& operator [](std::string_view keyName) const;
 
             const_iterator begin();
 
             const_iterator end();
 
         private:
-            const std::unordered_map<std::string, std::string>& m_keys;
+            const keys_t& m_keys;
         };
 
         /**
@@ -132,9 +149,9 @@ namespace qini
         class iterator
         {
         public:
-            iterator(const std::unordered_map<std::string, std::unordered_map<std::string, std::string>>::iterator& itor);
+            iterator(const sections_t::iterator& itor);
 
-            iterator(std::unordered_map<std::string, std::unordered_map<std::string, std::string>>::iterator&& itor);
+            iterator(sections_t::iterator&& itor);
 
             iterator& operator ++();
 
@@ -145,7 +162,7 @@ namespace qini
             friend bool operator !=(const iterator& a, const iterator& b);
 
         private:
-            std::unordered_map<std::string, std::unordered_map<std::string, std::string>>::iterator m_itor;
+            sections_t::iterator m_itor;
         };
 
         /**
@@ -154,9 +171,9 @@ namespace qini
         class const_iterator
         {
         public:
-            const_iterator(const std::unordered_map<std::string, std::unordered_map<std::string, std::string>>::const_iterator& itor);
+            const_iterator(const sections_t::const_iterator& itor);
 
-            const_iterator(std::unordered_map<std::string, std::unordered_map<std::string, std::string>>::const_iterator&& itor);
+            const_iterator(sections_t::const_iterator&& itor);
 
             const_iterator& operator ++();
 
@@ -167,7 +184,7 @@ namespace qini
             friend bool operator !=(const const_iterator& a, const const_iterator& b);
 
         private:
-            std::unordered_map<std::string, std::unordered_map<std::string, std::string>>::const_iterator m_itor;
+            sections_t::const_iterator m_itor;
         };
 
         INIObject() = default;
@@ -182,9 +199,17 @@ namespace qini
 
         INIObject& operator =(INIObject&& ob) noexcept;
 
-        Section operator [](const std::string& sectionName);
+        Section operator [](std::string_view sectionName);
+
+        Const_Section operator [](std::string_view sectionName) const;
 
-        Const_Section operator [](const std::string& sectionName) const;
+        /**
+         * @brief Looks up a key without throwing.
+         * @param sectionName The name of the section.
+         * @param keyName The name of the key.
+         * @return The value, or nullptr if the section or the key doesn't exist.
+         */
+        const std::string* find(std::string_view sectionName, std::string_view keyName) const;
 
         iterator begin();
 
@@ -195,12 +220,67 @@ namespace qini
         friend bool operator !=(const INIObject& ia, const INIObject& ib);
 
     private:
-        std::unordered_map<std::string, std::unordered_map<std::string, std::string>> m_sections;
+        sections_t m_sections;
 
         friend class INIParser;
         friend class INIWriter;
     };
 
+    /**
+     * @brief Why INIParser failed to parse its input.
+     */
+    enum class INIErrorCode
+    {
+        None, ///< The input was parsed.
+        UnexpectedEnd, ///< The input ends in the middle of a section header or a key.
+        UnexpectedCharacter, ///< A character that can't appear where it is, such as a key without '='.
+        KeyOutsideSection, ///< A key before the first section header.
+    };
+
+    /**
+     * @brief Where and why parsing failed.
+     */
+    struct INIParseError
+    {
+        INIErrorCode code = INIErrorCode::None; ///< Why parsing failed, INIErrorCode::None if it didn't.
+        size_t offset = 0; ///< The offset in the input where parsing failed.
+
+        /**
+         * @brief Checks whether parsing failed.
+         * @return true if there is an error.
+         */
+        explicit operator bool() const
+        {
+            return code != INIErrorCode::None;
+        }
+
+        /**
+         * @brief Describes the error for a person.
+         * @param data The input that failed to parse.
+         * @return What went wrong, the line and column (from 1), and the
+         * line of input with a caret under the offset.
+         */
+        std::string describe(std::string_view data) const;
+    };
+
+    /**
+     * @brief The outcome of INIParser::tryParse(): the value, or the error.
+     */
+    struct INIParseResult
+    {
+        INIObject value; ///< The parsed value, empty if parsing failed.
+        INIParseError error; ///< Where and why parsing failed.
+
+        /**
+         * @brief Checks whether parsing succeeded.
+         * @return true if value holds the parsed input.
+         */
+        explicit operator bool() const
+        {
+            return !error;
+        }
+    };
+
     /**
      * @brief Class for parsing INI data.
      */
@@ -217,6 +297,13 @@ namespace qini
          */
         INIObject parse(std::string_view data);
 
+        /**
+         * @brief Parses INI data without throwing on invalid input.
+         * @param data The INI data to parse.
+         * @return The parsed INI object, or the error code and the offset where parsing failed.
+         */
+        INIParseResult tryParse(std::string_view data);
+
         /**
          * @brief Quickly parses INI data from a string view.
          * @param data The INI data to parse.
@@ -232,11 +319,11 @@ namespace qini
         static INIObject fastParse(std::ifstream& infile);
 
     protected:
-        bool skipSpace(std::string_view::iterator& i, std::string_view data, long long& error_line);
+        INIErrorCode _parse(std::string_view data, std::string_view::iterator& i, INIObject& object);
 
-        std::string getString(std::string_view::iterator& i, std::string_view data, long long error_line);
+        bool skipSpace(std::string_view::iterator& i, std::string_view data);
 
-        std::string get_logic_error_string(long long error_line);
+        std::string getString(std::string_view::iterator& i, std::string_view data);
     };
 
     /**
@@ -16,6 +16,7 @@
 #define JSON_HPP
 
 #include <string>
+#include <functional>
 #include <vector>
 #include <unordered_map>
 #include <variant>
@@ -23,6 +24,13 @@
 #include <fstream>
 #include <sstream>
 #include <memory>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <initializer_list>
+#include <tuple>
+#include <optional>
+#include <span>
 
 namespace qjson
 {
@@ -42,17 +50,195 @@ namespace qjson
 
     class JObject;
 
+    /**
+     * @brief A dict key with its hash worked out once, for looking the same key up many times.
+     */
+    class JKey
+    {
+    public:
+        /**
+         * @brief Constructs a key and hashes it.
+         * @param key The text of the key.
+         */
+        explicit JKey(std::string_view key);
+
+        /**
+         * @brief Gets the text of the key.
+         * @return The text.
+         */
+        const std::string& str() const;
+
+        /**
+         * @brief Gets the hash of the key, as dict_t hashes it.
+         * @return The hash.
+         */
+        size_t hash() const;
+
+        friend bool operator==(const JKey& key, std::string_view other);
+
+    private:
+        std::string m_key; ///< The text of the key.
+        size_t m_hash; ///< The hash of m_key.
+    };
+
+    /**
+     * @brief Hash of dict keys that also takes std::string_view and JKey, so lookups don't build a std::string.
+     */
+    struct key_hash_t
+    {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view key) const noexcept
+        {
+            return std::hash<std::string_view>{}(key);
+        }
+
+        size_t operator()(const JKey& key) const noexcept
+        {
+            return key.hash();
+        }
+    };
+
     using null_t = bool;
     using int_t = long long;
     using bool_t = bool;
     using double_t = long double;
     using string_t = std::string;
     using list_t = std::vector<JObject>;
-    using dict_t = std::unordered_map<std::string, JObject>;
-    using value_t = std::variant<int_t, bool_t, double_t, string_t, list_t, dict_t>;
+    using dict_t = std::unordered_map<std::string, JObject, key_hash_t, std::equal_to<>>;
+
+    /**
+     * @brief Storage of a list whose elements are all ints or all doubles, one machine word each.
+     *
+     * Const element access builds a JObject for each element asked for; only
+     * getList() const builds them all.
+     */
+    struct packed_t
+    {
+        /**
+         * @brief The JObjects built for const element access, one slot per element.
+         */
+        struct Elements
+        {
+            explicit Elements(size_t size);
+            ~Elements();
+
+            size_t size; ///< The number of slots.
+            std::unique_ptr<std::atomic<JObject*>[]> slots; ///< The JObject of each element, nullptr until it is asked for.
+        };
+
+        packed_t() = default;
+        packed_t(std::vector<std::int64_t> ints);
+        packed_t(std::vector<double> doubles);
+        packed_t(const packed_t& other);
+        packed_t(packed_t&& other) noexcept;
+        ~packed_t();
+
+        packed_t& operator=(const packed_t& other);
+        packed_t& operator=(packed_t&& other) noexcept;
+
+        /**
+         * @brief Frees the JObjects built for const access, before the numbers change.
+         */
+        void release();
+
+        std::variant<std::vector<std::int64_t>, std::vector<double>> numbers; ///< The elements.
+        mutable std::atomic<list_t*> unpacked{ nullptr }; ///< The elements as JObjects, built once by getList() const.
+        mutable std::atomic<Elements*> elements{ nullptr }; ///< The elements built one at a time by operator[] const and find().
+    };
+
+    /**
+     * @brief Keys shared by the dicts that have the same members in the same order.
+     */
+    struct shape_t
+    {
+        shape_t() = default;
+        shape_t(const shape_t&) = delete;
+        shape_t& operator=(const shape_t&) = delete;
+
+        std::vector<std::string> keys; ///< The keys, in order.
+        std::unordered_map<std::string_view, size_t, key_hash_t, std::equal_to<>> slots; ///< The index of each key in keys.
+        bool plainKeys = false; ///< Whether no key contains a quote or a backslash, so keys can be compared with the raw input.
+    };
+
+    /**
+     * @brief Storage of a dict as a shared shape and one value per key.
+     */
+    struct shaped_t
+    {
+        shaped_t() = default;
+        shaped_t(std::shared_ptr<const shape_t> shape, size_t size);
+        shaped_t(const shaped_t& other);
+        shaped_t(shaped_t&& other) noexcept;
+        ~shaped_t();
+
+        shaped_t& operator=(const shaped_t& other);
+        shaped_t& operator=(shaped_t&& other) noexcept;
+
+        std::shared_ptr<const shape_t> shape; ///< The keys, nullptr while the parser is filling the values.
+        list_t values; ///< The value of each key, in the order of the keys.
+        mutable std::atomic<dict_t*> unshaped{ nullptr }; ///< The members as a dict_t, built once by getDict() const.
+    };
+
+    /**
+     * @brief Storage of a number kept as written in the input, decoded on first use.
+     */
+    struct lexeme_t
+    {
+        lexeme_t() = default;
+        lexeme_t(std::string_view text);
+        lexeme_t(const lexeme_t& other);
+        lexeme_t(lexeme_t&& other) noexcept;
+
+        lexeme_t& operator=(const lexeme_t& other);
+        lexeme_t& operator=(lexeme_t&& other) noexcept;
+
+        std::string text; ///< The number as written in the input.
+        mutable std::atomic<unsigned char> state{ 0 }; ///< 0 until decoded, 1 while being decoded, 2 once decoded.
+        mutable union
+        {
+            int_t integer;
+            double_t real;
+        } decoded{ 0 }; ///< The decoded value, valid once state is 2.
+    };
+
+    using value_t = std::variant<int_t, bool_t, double_t, string_t, list_t, dict_t, packed_t, shaped_t, lexeme_t>;
+
+    /**
+     * @brief Heap memory used by a JObject and everything below it, in bytes, by category.
+     */
+    struct JMemoryUsage
+    {
+        size_t nodes = 0; ///< The reference counted storage of each value.
+        size_t strings = 0; ///< String values, dict_t keys and number lexemes too long to be stored inline.
+        size_t lists = 0; ///< The element arrays of lists, packed or not, by capacity.
+        size_t dicts = 0; ///< The buckets and members of dict_t, and the value arrays of shaped dicts.
+        size_t shapes = 0; ///< The keys of shaped dicts, counted once per shape.
+        size_t sources = 0; ///< Input text kept by JParserOptions::keepSource, counted once per parse.
+
+        size_t total() const
+        {
+            return nodes + strings + lists + dicts + shapes + sources;
+        }
+    };
 
     /**
      * @brief Class representing a JSON object.
+     *
+     * Copies are copy-on-write: they share the value until one of them is
+     * modified, and then only the modified path is cloned. A value that has
+     * handed out a mutable reference (operator[], getList(), getInt(), ...)
+     * is no longer shared, so writes through such a reference are never seen
+     * by other copies.
+     *
+     * Parsed lists whose elements are all ints or all doubles are stored
+     * packed (see getInts() and getDoubles()); they turn into a list of
+     * JObjects when they are accessed mutably or get an element of another type.
+     * Doubles are only packed if a double holds them exactly, so where long
+     * double is wider than double, a list of decimals such as 0.1 isn't packed.
+     * Likewise, parsed dicts whose keys repeat those of an earlier dict share
+     * one shape of keys (see isShaped()); const lookups go through the shape,
+     * and they turn into a dict_t when they are accessed mutably.
      */
     class JObject
     {
@@ -87,11 +273,72 @@ namespace qjson
         JObject& operator[](int itor);
         const JObject& operator[](const char* str) const;
         JObject& operator[](const char* str);
+        const JObject& operator[](std::string_view str) const;
+        JObject& operator[](std::string_view str);
+        const JObject& operator[](const JKey& key) const;
+        JObject& operator[](const JKey& key);
 
         void push_back(const JObject& jo);
         void push_back(JObject&& jo);
         void pop_back();
-        bool hasMember(const std::string& str) const;
+
+        /**
+         * @brief Constructs a list from its elements, which may be lists and dicts made the same way.
+         * @param elements The elements, in order.
+         * @return The list.
+         */
+        static JObject makeList(std::initializer_list<JObject> elements);
+
+        /**
+         * @brief Constructs a dict from its members, which may be lists and dicts made the same way.
+         * @param members The keys and values; a repeated key keeps its last value, as in parsing.
+         * @return The dict.
+         */
+        static JObject makeDict(std::initializer_list<std::pair<std::string_view, JObject>> members);
+
+        /**
+         * @brief Reserves room for the elements of a list or the members of a dict.
+         *
+         * Adding up to that many doesn't reallocate the list or rehash the dict.
+         * A packed list reserves its packed storage and stays packed.
+         * @param size The number of elements or members to make room for.
+         */
+        void reserve(size_t size);
+
+        /**
+         * @brief Constructs an element at the end of a list, in place.
+         *
+         * A null value becomes an empty list first.
+         * @param args The arguments of the JObject constructor, such as a moved string.
+         * @return The new element.
+         */
+        template<typename... Args>
+        JObject& emplace_back(Args&&... args)
+        {
+            return buildList().emplace_back(std::forward<Args>(args)...);
+        }
+
+        /**
+         * @brief Constructs a dict member in place, if the dict has no member with that key.
+         *
+         * A null value becomes an empty dict first. Like std::unordered_map::try_emplace,
+         * an existing member is left as it is and the arguments are not used.
+         * @param key The key of the member.
+         * @param args The arguments of the JObject constructor, such as a moved JObject.
+         * @return The member with that key.
+         */
+        template<typename... Args>
+        JObject& emplace(std::string_view key, Args&&... args)
+        {
+            dict_t& dict = buildDict();
+            auto member = dict.find(key);
+            if (member == dict.end())
+                member = dict.emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                    std::forward_as_tuple(std::forward<Args>(args)...)).first;
+            return member->second;
+        }
+        bool hasMember(std::string_view str) const;
+        bool hasMember(const JKey& key) const;
 
         JValueType getType() const;
         const list_t& getList() const;
@@ -102,14 +349,320 @@ namespace qjson
         long long& getInt();
         const long double& getDouble() const;
         long double& getDouble();
+
+        /**
+         * @brief Gets a non-negative integer, which may be too large for getInt().
+         *
+         * Numbers parsed with JParserOptions::lazyNumbers are read from their
+         * text, so any integer up to 2^64 - 1 can be got, whatever its type.
+         * @return The value.
+         */
+        std::uint64_t getUInt() const;
         const bool& getBool() const;
         bool& getBool();
         const std::string& getString() const;
         std::string& getString();
 
+        /**
+         * @brief Gets the value if it is an int, without throwing.
+         * @return The value, or std::nullopt for any other type.
+         */
+        std::optional<long long> tryGetInt() const;
+
+        /**
+         * @brief Gets the value if it is a double, without throwing.
+         * @return The value, or std::nullopt for any other type.
+         */
+        std::optional<long double> tryGetDouble() const;
+
+        /**
+         * @brief Gets the value if it is a bool, without throwing.
+         * @return The value, or std::nullopt for any other type.
+         */
+        std::optional<bool> tryGetBool() const;
+
+        /**
+         * @brief Gets the value if it is a string, without throwing.
+         * @return The string, or nullptr for any other type.
+         */
+        const std::string* tryGetString() const;
+
+        /**
+         * @brief Looks up a dict member without throwing.
+         * @param key The key of the member.
+         * @return The member, or nullptr if the value isn't a dict or has no such key.
+         */
+        const JObject* find(std::string_view key) const;
+
+        /**
+         * @brief Looks up a dict member by a key whose hash is already known, without throwing.
+         * @param key The key of the member.
+         * @return The member, or nullptr if the value isn't a dict or has no such key.
+         */
+        const JObject* find(const JKey& key) const;
+
+        /**
+         * @brief Looks up a list element without throwing.
+         * @param index The index of the element.
+         * @return The element, or nullptr if the value isn't a list or is too short.
+         */
+        const JObject* find(size_t index) const;
+
+        /**
+         * @brief Gets a structural hash of the value.
+         *
+         * Equal values have equal hashes, whatever the order of dict members.
+         * The hash is cached in the value and dropped when it is modified.
+         * @return The hash.
+         */
+        size_t hash() const;
+
+        /**
+         * @brief Gets the source text of a container parsed with JParserOptions::keepSource.
+         *
+         * JWriter::write() copies this text verbatim instead of writing the container again.
+         * @return The text, or an empty view if there is none, the container encloses an edit
+         * passed to JParser::reparse(), or it has been modified (or has handed out a mutable
+         * reference) since it was parsed.
+         */
+        std::string_view getSource() const;
+
+        /**
+         * @brief Checks whether the value is a list stored as packed ints or doubles.
+         * @return true if getInts() or getDoubles() can be used.
+         */
+        bool isPacked() const;
+
+        /**
+         * @brief Gets the elements of a list stored as packed ints.
+         * @return The elements, valid until the list is modified.
+         */
+        std::span<const std::int64_t> getInts() const;
+
+        /**
+         * @brief Gets the elements of a list stored as packed doubles.
+         * @return The elements, valid until the list is modified.
+         */
+        std::span<const double> getDoubles() const;
+
+        /**
+         * @brief Checks whether the value is a dict stored as a shared shape of keys and an array of values.
+         * @return true if the dict is stored that way.
+         */
+        bool isShaped() const;
+
+        /**
+         * @brief Gets a number parsed with JParserOptions::lazyNumbers as it was written.
+         *
+         * The text keeps integers of any size and decimals of any precision exactly.
+         * @return The text, or an empty view if the number wasn't parsed lazily
+         * or has been modified (or has handed out a mutable reference) since.
+         */
+        std::string_view getLexeme() const;
+
+        /**
+         * @brief Estimates the heap memory used by the value and everything below it.
+         *
+         * Sizes are worked out from the capacities of the containers, without the
+         * overhead of the allocator. Values shared within the tree, shapes and kept
+         * source text are counted once.
+         * @return The bytes used, by category.
+         */
+        JMemoryUsage memoryUsage() const;
+
+        /**
+         * @brief Rebuilds the value in compact storage, for documents that are kept for a long time.
+         *
+         * The nodes are allocated next to each other in large blocks. Lists and
+         * strings get exactly their size, lists of numbers are packed, and dicts
+         * become shaped dicts sharing one interned shape per sequence of keys
+         * (dict_t members are put in key order). Values shared within the tree
+         * stay shared.
+         *
+         * Each block is freed once none of its nodes is used any more, so edits
+         * give back the blocks they empty, while the nodes they add are allocated
+         * as usual. A document that keeps being edited can be compacted again.
+         *
+         * The value is unchanged, but references into it are invalidated; copies
+         * made before keep the old storage.
+         */
+        void compact();
+
     private:
-        std::unique_ptr<value_t> m_value; ///< The value of the JSON object.
+        /**
+         * @brief Input kept by the parser, shared by the containers parsed from it.
+         *
+         * A parse keeps the whole document; reparse() keeps only the text of
+         * the container it reparsed.
+         */
+        struct SourceText
+        {
+            struct Shift
+            {
+                size_t offset; ///< Where the edit starts.
+                size_t removed; ///< The number of bytes removed.
+                size_t inserted; ///< The number of bytes inserted.
+                std::shared_ptr<const Shift> previous; ///< The edit that produced the version before, nullptr for the first.
+
+                ~Shift();
+            };
+
+            std::string text; ///< The kept part of the document.
+            size_t offset = 0; ///< Where the kept part starts in the document.
+            size_t size = 0; ///< The length of the whole document.
+            size_t version = 0; ///< The number of incremental reparses that led to this text.
+            std::shared_ptr<const Shift> history; ///< The edit that produced this version, shared with the versions after it.
+        };
+
+        struct Source
+        {
+            std::shared_ptr<const SourceText> text; ///< The input the container was parsed from, or the version it was moved to.
+            size_t begin; ///< The offset of the opening bracket in the document.
+            size_t end; ///< The offset past the closing bracket in the document.
+        };
+
+        /**
+         * @brief Reference counted value shared between copies of a JObject.
+         */
+        struct Storage
+        {
+            template<typename... Args>
+            Storage(Args&&... args)
+                :value(std::forward<Args>(args)...)
+            {
+            }
+
+            value_t value; ///< The value itself.
+            bool shareable = true; ///< False once a mutable reference into the value has been handed out.
+            mutable std::atomic<size_t> hash{ 0 }; ///< Cached structural hash, 0 until computed.
+            std::unique_ptr<Source> source; ///< Where the container was parsed from, dropped when it is modified.
+        };
+
+        value_t& ownValue();
+        value_t& mutableValue();
+        value_t& leakValue();
+        list_t& buildList();
+        dict_t& buildDict();
+        static void unpack(value_t& value);
+        static void unshape(value_t& value);
+        static void decode(const lexeme_t& lexeme, bool integer);
+        template<typename Key>
+        static const JObject* findMember(const JObject& jo, const Key& key);
+        template<typename Key>
+        static const JObject& memberAt(const JObject& jo, const Key& key);
+        template<typename Key>
+        static JObject& memberAt(JObject& jo, const Key& key);
+        static bool appendPacked(packed_t& packed, const JObject& jo);
+        static JObject packedValue(const packed_t& packed, size_t index);
+        static const JObject& packedElement(const packed_t& packed, size_t index);
+        static size_t listSize(const JObject& jo);
+        static size_t hashInt(long long value);
+        static size_t hashDouble(long double value);
+        static void copyValue(JObject& to, const JObject& from, bool clone);
+        static void detachChildren(Storage& storage, std::vector<std::shared_ptr<Storage>>& pending);
+        static void detachChild(JObject& child, std::vector<std::shared_ptr<Storage>>& pending);
+        static size_t shedChildren(Storage& storage, size_t count, std::vector<std::shared_ptr<Storage>>& pending);
+        static size_t mixHash(size_t value);
+        static bool lookupHash(const JObject& jo, size_t& result);
+
+        std::shared_ptr<Storage> m_value; ///< The value of the JSON object, null for JNull.
         JValueType m_type; ///< The type of the JSON value.
+
+        friend class JParser;
+        friend class JPersistentObject;
+        friend class JPatch;
+        friend class JWriter;
+        friend class JReclaimer;
+    };
+
+    /**
+     * @brief Limits applied by JParser, so that untrusted input can be parsed safely.
+     */
+    struct JParserOptions
+    {
+        size_t maxDepth = std::numeric_limits<size_t>::max(); ///< Maximum nesting depth of lists and dicts.
+        size_t maxSize = std::numeric_limits<size_t>::max(); ///< Maximum size of the input in bytes.
+        size_t maxNodes = std::numeric_limits<size_t>::max(); ///< Maximum number of values in the document.
+        bool keepSource = false; ///< Whether containers remember their source text, so unchanged ones are written back verbatim.
+        bool shareShapes = true; ///< Whether dicts with the same keys as an earlier dict share its shape instead of each having a hash table.
+        bool predictKeys = false; ///< Whether the parser learns the keys of the dicts at each path and compares the next document with them first (needs shareShapes).
+        bool lazyNumbers = false; ///< Whether numbers are kept as written and decoded on first use; lists of them are then never packed.
+        bool validateUtf8 = false; ///< Whether the input is checked to be valid UTF-8 before it is parsed.
+    };
+
+    /**
+     * @brief Why JParser failed to parse its input.
+     */
+    enum class JErrorCode
+    {
+        None, ///< The input was parsed.
+        Empty, ///< The input is empty.
+        TooLarge, ///< The input exceeds JParserOptions::maxSize.
+        TooDeep, ///< The input exceeds JParserOptions::maxDepth.
+        TooManyNodes, ///< The input exceeds JParserOptions::maxNodes.
+        InvalidUtf8, ///< The input isn't valid UTF-8, with JParserOptions::validateUtf8.
+        UnexpectedEnd, ///< The input ends in the middle of a value.
+        UnexpectedCharacter, ///< A character that can't appear where it is.
+        InvalidString, ///< A string with an invalid escape.
+        InvalidNumber, ///< A number that doesn't follow the JSON grammar.
+        InvalidLiteral, ///< A misspelt true, false or null.
+    };
+
+    /**
+     * @brief Where and why parsing failed.
+     */
+    struct JParseError
+    {
+        JErrorCode code = JErrorCode::None; ///< Why parsing failed, JErrorCode::None if it didn't.
+        size_t offset = 0; ///< The offset in the input where parsing failed.
+
+        /**
+         * @brief Checks whether parsing failed.
+         * @return true if there is an error.
+         */
+        explicit operator bool() const
+        {
+            return code != JErrorCode::None;
+        }
+
+        /**
+         * @brief Describes the error for a person.
+         *
+         * The line and column are worked out here, by scanning the input up
+         * to the offset, so the parser itself only tracks the offset.
+         * @param data The input that failed to parse.
+         * @return What went wrong, the line and column (from 1), and the
+         * line of input with a caret under the offset.
+         */
+        std::string describe(std::string_view data) const;
+    };
+
+    /**
+     * @brief The outcome of JParser::tryParse(): the value, or the error.
+     */
+    struct JParseResult
+    {
+        JObject value; ///< The parsed value, null if parsing failed.
+        JParseError error; ///< Where and why parsing failed.
+
+        /**
+         * @brief Checks whether parsing succeeded.
+         * @return true if value holds the parsed input.
+         */
+        explicit operator bool() const
+        {
+            return !error;
+        }
+    };
+
+    /**
+     * @brief A text edit: a range of bytes replaced by new text.
+     */
+    struct JEdit
+    {
+        size_t offset; ///< Where the edit starts in the old text.
+        size_t removed; ///< The number of bytes removed.
+        std::string_view inserted; ///< The text inserted in their place.
     };
 
     /**
@@ -120,6 +673,24 @@ namespace qjson
     public:
         JParser() = default;
 
+        /**
+         * @brief Constructs a parser with the given limits.
+         * @param options The limits applied to every parse.
+         */
+        JParser(const JParserOptions& options);
+
+        /**
+         * @brief Sets the limits applied to every parse.
+         * @param options The new limits.
+         */
+        void setOptions(const JParserOptions& options);
+
+        /**
+         * @brief Gets the limits applied to every parse.
+         * @return The current limits.
+         */
+        const JParserOptions& getOptions() const;
+
         /**
          * @brief Parses JSON data from a string view.
          * @param data The JSON data to parse.
@@ -141,14 +712,138 @@ namespace qjson
          */
         static JObject fastParse(const std::string_view data);
 
+        /**
+         * @brief Checks whether data is valid UTF-8.
+         *
+         * Rejects overlong forms, surrogates, code points above U+10FFFF and
+         * truncated sequences. Uses AVX2 or SSSE3 when the CPU supports them.
+         * @param data The data to check.
+         * @return Whether the data is valid UTF-8.
+         */
+        static bool isValidUtf8(std::string_view data);
+
+        /**
+         * @brief Parses JSON data into an existing JSON object, reusing its allocations.
+         *
+         * Lists keep their capacity, dict members with matching keys are
+         * reused and strings are overwritten in place, so parsing documents
+         * of the same shape over and over allocates almost nothing. Values
+         * shared with copies of the target are replaced, never modified. If
+         * parsing fails, the target is left valid but partly overwritten.
+         * @param data The JSON data to parse.
+         * @param jo The JSON object to overwrite.
+         */
+        void parseInto(std::string_view data, JObject& jo);
+
+        /**
+         * @brief Parses JSON data without throwing on invalid input.
+         *
+         * Failing costs no more than parsing up to the error: nothing is
+         * thrown or formatted. Running out of memory still throws.
+         * @param data The JSON data to parse.
+         * @return The parsed JSON object, or the error code and the offset where parsing failed.
+         */
+        JParseResult tryParse(std::string_view data);
+
+        /**
+         * @brief Parses JSON data into an existing JSON object without throwing on invalid input.
+         *
+         * Works like parseInto(). If parsing fails, the target is left valid but partly overwritten.
+         * @param data The JSON data to parse.
+         * @param jo The JSON object to overwrite.
+         * @return The error, which converts to false if the data was parsed.
+         */
+        JParseError tryParseInto(std::string_view data, JObject& jo);
+
+        /**
+         * @brief Parses a document again after an edit, reparsing only the container around it.
+         *
+         * The previous object must come from parse() with JParserOptions::keepSource
+         * or from reparse(), and must be unmodified; otherwise the new text is
+         * parsed in full. The innermost container that encloses the edit is
+         * reparsed and spliced into a copy of the previous object, which shares
+         * everything else. Only the text of that container is kept: the
+         * containers around it are written again by JWriter instead of being
+         * copied, and unchanged subtrees keep the text they were parsed from
+         * until they are replaced. The old text is compared with the text the
+         * previous object kept, and parsed in full if they differ.
+         * @param previous The object parsed from the old text.
+         * @param oldText The text the previous object was parsed from.
+         * @param edit The edit applied to the old text.
+         * @return The object for the new text, which can be passed to reparse() again.
+         */
+        JObject reparse(const JObject& previous, std::string_view oldText, const JEdit& edit);
+
     protected:
-        JObject _parse(std::string_view data, size_t& itor);
-        void skipSpace(std::string_view data, size_t& itor, long long& error_line);
-        std::string getString(std::string_view data, size_t& itor, long long error_line);
-        JObject getNumber(std::string_view data, size_t& itor, long long error_line);
-        JObject getBool(std::string_view data, size_t& itor, long long error_line);
-        JObject getNull(std::string_view data, size_t& itor, long long error_line);
-        std::string getLogicErrorString(long long error_line);
+        /**
+         * @brief What the parser learned about the dicts at one path of earlier documents.
+         */
+        struct Prediction
+        {
+            std::shared_ptr<const shape_t> shape; ///< The shape of the last dict parsed here, if its keys are plain.
+            std::vector<Prediction> children; ///< The paths of the containers in each member (or in the elements of a list, at 0).
+        };
+
+        struct Frame
+        {
+            JObject* container; ///< The open list or dict.
+            size_t count; ///< The number of elements parsed into it so far.
+            size_t seen; ///< Where its members start in Scratch::seen, or in Scratch::keys while collecting a shape, for dicts.
+            size_t begin; ///< The offset of its opening bracket.
+            unsigned char layout; ///< For lists: 0 while empty, 1 for packed ints, 2 for packed doubles, 3 for JObjects.
+                                  ///< For dicts: 0 while collecting a shape, 3 for a dict_t.
+            Prediction* prediction; ///< What was learned about its path, nullptr if not learning.
+            const shape_t* predicted; ///< For dicts: the shape its keys have matched so far, nullptr after a mismatch.
+        };
+
+        /**
+         * @brief Working memory of a parse, kept by parseInto() so its capacity is reused.
+         */
+        struct Scratch
+        {
+            std::vector<Frame> stack; ///< The open containers, innermost last.
+            std::vector<const JObject*> seen; ///< The dict members parsed so far.
+            std::string key; ///< The dict key being parsed.
+            std::vector<std::string> keys; ///< The keys of the dicts collecting a shape; the first keyCount are in use.
+            size_t keyCount = 0; ///< The number of keys in use.
+            std::string sequence; ///< The key sequence of the dict being closed, as looked up in shapes.
+            std::unordered_map<std::string, std::shared_ptr<const shape_t>> shapes; ///< The key sequences seen, nullptr until one repeats.
+            Prediction* prediction = nullptr; ///< What was learned about the root, nullptr if not learning.
+            std::shared_ptr<const JObject::SourceText> text; ///< The kept input, if the data is already in one.
+        };
+
+        JErrorCode _parse(std::string_view data, size_t& itor, JObject& root, Scratch& scratch);
+        static void skipSpace(std::string_view data, size_t& itor);
+        JErrorCode getString(std::string_view data, size_t& itor, std::string& str);
+        JErrorCode getString(std::string_view data, size_t& itor, JObject& slot);
+        JErrorCode scanNumber(std::string_view data, size_t& itor, bool& isDouble);
+        JErrorCode readNumber(std::string_view data, size_t& itor, long long& integer, long double& real, bool& isDouble);
+        JErrorCode getNumber(std::string_view data, size_t& itor, JObject& slot);
+        JErrorCode getBool(std::string_view data, size_t& itor, JObject& slot);
+        JErrorCode getNull(std::string_view data, size_t& itor, JObject& slot);
+        static bool reuse(JObject& slot, JValueType type);
+        void closeShape(JObject& dict, const Frame& frame, Scratch& scratch);
+        Prediction* predict(Prediction* parent, size_t index);
+        static bool matchKey(std::string_view data, size_t& itor, const std::string& key);
+
+        /**
+         * @brief Reads a \\u escape, and the escaped low surrogate after it if it starts a pair.
+         * @param data The input.
+         * @param itor The offset of the 'u', moved to the last hex digit read.
+         * @return The code point, or -1 if a digit is invalid or a surrogate is unpaired.
+         */
+        static long unicodeEscape(std::string_view data, size_t& itor);
+        static void appendUtf8(std::string& str, std::uint32_t code);
+
+        static constexpr size_t maxShapes = 4096; ///< The most key sequences remembered per parse.
+        static constexpr size_t maxPredictions = 4096; ///< The most paths learned by predictKeys.
+
+        JParserOptions m_options; ///< The limits applied while parsing.
+        Scratch m_scratch; ///< The working memory of parseInto().
+        Prediction m_prediction; ///< What predictKeys learned about the root of earlier documents.
+        size_t m_predictionCount = 0; ///< The number of paths learned.
+
+        friend class JReader;
     };
 
     /**
@@ -175,6 +870,25 @@ namespace qjson
          */
         std::string formatWrite(const JObject& jo, size_t n = 1);
 
+        /**
+         * @brief Writes a JSON object in canonical form.
+         *
+         * Dict members are sorted bytewise by key, doubles use the shortest
+         * form that reads back to the same value and there is no whitespace,
+         * so equal objects always produce the same bytes.
+         * @param jo The JSON object to write.
+         * @return The canonical JSON data as a string.
+         */
+        std::string canonicalWrite(const JObject& jo);
+
+        /**
+         * @brief Writes a JSON object in canonical form and hashes the output.
+         * @param jo The JSON object to write.
+         * @param digest Receives the 64-bit FNV-1a hash of the output, computed while writing.
+         * @return The canonical JSON data as a string.
+         */
+        std::string canonicalWrite(const JObject& jo, std::uint64_t& digest);
+
         /**
          * @brief Quickly writes a JSON object to a string.
          * @param jo The JSON object to write.
@@ -196,6 +910,80 @@ namespace qjson
             static JWriter jw;
             return std::move(jw.formatWrite(jo) + '\n');
         }
+
+        /**
+         * @brief Quickly writes a JSON object in canonical form.
+         * @param jo The JSON object to write.
+         * @return The canonical JSON data as a string.
+         */
+        static std::string fastCanonicalWrite(const JObject& jo)
+        {
+            static JWriter jw;
+            return jw.canonicalWrite(jo);
+        }
+
+        /**
+         * @brief Appends a quoted, escaped string, as every writer of this library writes strings.
+         *
+         * Quotes, backslashes and control characters are escaped, using the short
+         * escapes where JSON has them; other bytes are copied as they are.
+         * @param str The string to append to.
+         * @param data The string to write.
+         */
+        static void writeString(std::string& str, std::string_view data);
+
+    protected:
+        /**
+         * @brief Appends a JSON object to a string in the form write() produces.
+         * @param str The string to append to.
+         * @param jo The JSON object to write.
+         */
+        static void writeValue(std::string& str, const JObject& jo);
+
+        /**
+         * @brief Appends elements of a packed list, each but the list's first preceded by a comma.
+         * @param str The string to append to.
+         * @param jo The packed list.
+         * @param begin The index of the first element to write.
+         * @param count The number of elements to write.
+         */
+        static void writePacked(std::string& str, const JObject& jo, size_t begin, size_t count);
+
+        /**
+         * @brief Gets the number of elements of a packed list.
+         * @param jo The packed list.
+         * @return The number of elements.
+         */
+        static size_t packedSize(const JObject& jo);
+
+        /**
+         * @brief Gets the storage of a packed list.
+         * @param jo The object.
+         * @return The storage, or nullptr if the object isn't a packed list.
+         */
+        static const packed_t* getPacked(const JObject& jo);
+
+        /**
+         * @brief Gets the storage of a dict stored as a shape.
+         * @param jo The object.
+         * @return The storage, or nullptr if the object isn't a shaped dict.
+         */
+        static const shaped_t* getShaped(const JObject& jo);
+    };
+}
+
+namespace std
+{
+    /**
+     * @brief Hashes a JSON object by its structure, so it can key unordered containers.
+     */
+    template<>
+    struct hash<qjson::JObject>
+    {
+        size_t operator()(const qjson::JObject& jo) const
+        {
+            return jo.hash();
+        }
     };
 }
 
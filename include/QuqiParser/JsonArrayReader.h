@@ -0,0 +1,101 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef JSON_ARRAY_READER_HPP
+#define JSON_ARRAY_READER_HPP
+
+#include "Json.h"
+
+#include <cstddef>
+#include <istream>
+#include <iterator>
+#include <string>
+
+namespace qjson
+{
+    /**
+     * @brief Class for reading the elements of a top-level JSON array one at a time.
+     *
+     * The stream is read through a window that only has to hold the current
+     * element, so arrays larger than memory can be processed. Each element is
+     * parsed into the same JObject, reusing its allocations.
+     */
+    class JArrayReader
+    {
+    public:
+        /**
+         * @brief Input iterator over the remaining elements.
+         */
+        class iterator
+        {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = JObject;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const JObject*;
+            using reference = const JObject&;
+
+            iterator() = default;
+            explicit iterator(JArrayReader* reader);
+
+            reference operator*() const;
+            pointer operator->() const;
+            iterator& operator++();
+            void operator++(int);
+            bool operator==(const iterator& other) const;
+
+        private:
+            JArrayReader* m_reader = nullptr; ///< The reader, nullptr at the end.
+        };
+
+        /**
+         * @brief Constructs a reader over a stream.
+         * @param infile The stream holding the array.
+         * @param options The limits applied to each element.
+         * @param blockSize The number of bytes read from the stream at a time.
+         */
+        JArrayReader(std::istream& infile, const JParserOptions& options = {}, size_t blockSize = 64 * 1024);
+
+        /**
+         * @brief Parses the next element.
+         * @param jo The JSON object to overwrite with the element.
+         * @return false when the array has ended.
+         */
+        bool next(JObject& jo);
+
+        /**
+         * @brief Reads the first remaining element and returns an iterator to it.
+         * @return The iterator.
+         */
+        iterator begin();
+        iterator end();
+
+    protected:
+        bool fill();
+        bool skipSpace();
+        size_t scanElement();
+
+        std::istream& m_infile; ///< The stream holding the array.
+        JParser m_parser; ///< Parses each element.
+        size_t m_blockSize; ///< The number of bytes read at a time.
+        std::string m_buffer; ///< The window onto the stream.
+        size_t m_pos = 0; ///< The offset of the next unread byte in the window.
+        bool m_started = false; ///< Whether the opening bracket has been read.
+        bool m_first = true; ///< Whether no element has been read yet.
+        bool m_done = false; ///< Whether the closing bracket has been read.
+        JObject m_current; ///< The element the iterator points to.
+    };
+}
+
+#endif // !JSON_ARRAY_READER_HPP
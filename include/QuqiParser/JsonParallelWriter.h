@@ -0,0 +1,108 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef JSON_PARALLEL_WRITER_HPP
+#define JSON_PARALLEL_WRITER_HPP
+
+#include "Json.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace qjson
+{
+    /**
+     * @brief Class for writing large JSON objects on several threads.
+     *
+     * Lists and dicts larger than the chunk size are split into ranges of
+     * elements, each range is written into its own buffer by a worker thread,
+     * and the buffers are joined in order. The output is byte-identical to
+     * JWriter::write().
+     *
+     * The worker threads are started by the first write that has more than
+     * one task and are kept until the writer is destroyed. Writes from several
+     * threads take turns using them.
+     */
+    class JParallelWriter : public JWriter
+    {
+    public:
+        /**
+         * @brief Constructs a parallel writer.
+         * @param threadCount The number of worker threads, 0 for one per hardware thread.
+         * @param chunkSize The approximate number of values written by one task.
+         */
+        JParallelWriter(size_t threadCount = 0, size_t chunkSize = 4096);
+        JParallelWriter(const JParallelWriter&) = delete;
+        JParallelWriter& operator=(const JParallelWriter&) = delete;
+        ~JParallelWriter();
+
+        /**
+         * @brief Writes a JSON object to a string.
+         * @param jo The JSON object to write.
+         * @return The JSON data as a string.
+         */
+        std::string write(const JObject& jo);
+
+        /**
+         * @brief Writes a JSON object to a chain of buffers without joining them.
+         * @param jo The JSON object to write.
+         * @return The buffers, whose concatenation is the JSON data.
+         */
+        std::vector<std::string> writeChunks(const JObject& jo);
+
+#if defined(__unix__) || defined(__APPLE__)
+        /**
+         * @brief Writes a JSON object to a file descriptor, handing the buffer chain to writev().
+         * @param fd The file descriptor to write to.
+         * @param jo The JSON object to write.
+         * @return The number of bytes written.
+         */
+        size_t writeTo(int fd, const JObject& jo);
+#endif
+
+        size_t getThreadCount() const;
+        size_t getChunkSize() const;
+
+    protected:
+        struct Piece
+        {
+            const JObject* node = nullptr; ///< The container the range belongs to, nullptr for text.
+            size_t begin = 0; ///< The index of the first element of the range.
+            size_t count = 0; ///< The number of elements in the range.
+            dict_t::const_iterator member; ///< The first member of the range, for dicts.
+        };
+
+        void plan(const JObject& jo, std::vector<Piece>& pieces, std::vector<std::string>& chunks);
+        void writePiece(const Piece& piece, std::string& str);
+        void run(const std::function<void()>& work);
+        void serve(std::stop_token stop, size_t generation);
+
+        size_t m_threadCount; ///< The number of threads writing, the calling one included.
+        size_t m_chunkSize; ///< The approximate number of values written by one task.
+        std::vector<std::jthread> m_workers; ///< The worker threads, started by the first write that needs them.
+        std::function<void()> m_work; ///< The work of the current write, run by every worker.
+        size_t m_generation = 0; ///< The number of writes handed to the workers.
+        size_t m_working = 0; ///< The number of workers that haven't finished the current write.
+        std::mutex m_poolMutex; ///< Guards the members above.
+        std::mutex m_writeMutex; ///< Lets one write at a time use the workers.
+        std::condition_variable_any m_wake; ///< Signalled when a write is handed to the workers.
+        std::condition_variable m_finished; ///< Signalled when the last worker finishes a write.
+    };
+}
+
+#endif // !JSON_PARALLEL_WRITER_HPP
@@ -0,0 +1,105 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef JSON_PATCH_HPP
+#define JSON_PATCH_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Json.h"
+
+namespace qjson
+{
+    /**
+     * @brief Class for applying and generating JSON Patch (RFC 6902) and
+     * JSON Merge Patch (RFC 7396) documents.
+     */
+    class JPatch
+    {
+    public:
+        /**
+         * @brief Applies a JSON Patch to a document in place.
+         *
+         * The patch is atomic: if an operation fails, the operations already
+         * applied are undone and std::logic_error is thrown.
+         * @param document The JSON object to modify.
+         * @param patch The list of patch operations.
+         */
+        static void apply(JObject& document, const JObject& patch);
+
+        /**
+         * @brief Computes a JSON Patch that turns one document into another.
+         *
+         * Subtrees shared between the two documents are skipped without
+         * being compared.
+         * @param from The source JSON object.
+         * @param to The target JSON object.
+         * @return The list of patch operations.
+         */
+        static JObject diff(const JObject& from, const JObject& to);
+
+        /**
+         * @brief Applies a JSON Merge Patch to a document in place.
+         * @param document The JSON object to modify.
+         * @param patch The merge patch.
+         */
+        static void applyMerge(JObject& document, const JObject& patch);
+
+        /**
+         * @brief Computes a JSON Merge Patch that turns one document into another.
+         *
+         * Merge patches cannot express null members of the target, which are
+         * treated as removals.
+         * @param from The source JSON object.
+         * @param to The target JSON object.
+         * @return The merge patch.
+         */
+        static JObject mergeDiff(const JObject& from, const JObject& to);
+
+    protected:
+        using pointer_t = std::vector<std::string>;
+
+        struct Undo
+        {
+            enum Kind
+            {
+                Add,
+                Remove,
+                Replace
+            };
+
+            Kind kind; ///< The operation that reverts the change.
+            pointer_t path; ///< The location of the change.
+            JObject value; ///< The value to put back for Add and Replace.
+        };
+
+        static pointer_t parsePointer(std::string_view pointer);
+        static std::string appendToken(const std::string& pointer, std::string_view token);
+        static size_t getIndex(size_t size, const std::string& token, bool allowEnd);
+        static JObject& resolve(JObject& document, const pointer_t& path, size_t length);
+        static const JObject& get(const JObject& document, const pointer_t& path);
+        static void add(JObject& document, pointer_t path, JObject value, std::vector<Undo>& undo);
+        static JObject remove(JObject& document, const pointer_t& path, std::vector<Undo>& undo);
+        static void replace(JObject& document, const pointer_t& path, JObject value, std::vector<Undo>& undo);
+        static void rollback(JObject& document, std::vector<Undo>& undo);
+        static const JObject& getMember(const JObject& operation, const char* name);
+        static JObject makeOperation(const char* op, const std::string& path, const JObject* value);
+        static void diffPacked(list_t& operations, const std::string& path, const JObject& from, const JObject& to);
+        static void setMember(JObject& dict, const std::string& key, JObject value);
+    };
+}
+
+#endif // !JSON_PATCH_HPP
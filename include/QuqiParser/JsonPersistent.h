@@ -0,0 +1,200 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef JSON_PERSISTENT_HPP
+#define JSON_PERSISTENT_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "Json.h"
+
+namespace qjson
+{
+    /**
+     * @brief Immutable JSON value whose updates return a new version.
+     *
+     * Dicts are stored as a hash array mapped trie and lists as a radix
+     * balanced tree, so an update copies only the O(log n) nodes on its path
+     * and shares everything else with the previous version. A value can be
+     * read from any number of threads at once.
+     */
+    class JPersistentObject
+    {
+    public:
+        JPersistentObject();
+        JPersistentObject(JValueType jvt);
+        JPersistentObject(long long value);
+        JPersistentObject(int value);
+        JPersistentObject(bool value);
+        JPersistentObject(long double value);
+        JPersistentObject(double value);
+        JPersistentObject(const char* data);
+        JPersistentObject(std::string_view data);
+        JPersistentObject(std::string data);
+
+        /**
+         * @brief Converts a JObject into a persistent value.
+         * @param jo The JSON object to convert.
+         * @return The persistent value.
+         */
+        static JPersistentObject fromJObject(const JObject& jo);
+
+        /**
+         * @brief Converts this value back into a JObject.
+         * @return The JSON object.
+         */
+        JObject toJObject() const;
+
+        JValueType getType() const;
+        long long getInt() const;
+        long double getDouble() const;
+        bool getBool() const;
+        const std::string& getString() const;
+
+        /**
+         * @brief Gets the number of elements of a list or members of a dict.
+         * @return The number of elements or members.
+         */
+        size_t size() const;
+
+        const JPersistentObject& operator[](size_t index) const;
+        const JPersistentObject& operator[](std::string_view key) const;
+
+        /**
+         * @brief Looks up a member of a dict.
+         * @param key The key of the member.
+         * @return The member, or nullptr if there is no such key.
+         */
+        const JPersistentObject* find(std::string_view key) const;
+        bool hasMember(std::string_view key) const;
+
+        /**
+         * @brief Returns a new version with the list element at index replaced.
+         * @param index The index of the element.
+         * @param value The new element.
+         * @return The new version.
+         */
+        JPersistentObject set(size_t index, JPersistentObject value) const;
+
+        /**
+         * @brief Returns a new version with value appended to the list.
+         * @param value The new element.
+         * @return The new version.
+         */
+        JPersistentObject push_back(JPersistentObject value) const;
+
+        /**
+         * @brief Returns a new version without the last element of the list.
+         * @return The new version.
+         */
+        JPersistentObject pop_back() const;
+
+        /**
+         * @brief Returns a new version with the dict member key inserted or replaced.
+         * @param key The key of the member.
+         * @param value The new member.
+         * @return The new version.
+         */
+        JPersistentObject set(std::string_view key, JPersistentObject value) const;
+
+        /**
+         * @brief Returns a new version without the dict member key.
+         * @param key The key of the member.
+         * @return The new version.
+         */
+        JPersistentObject erase(std::string_view key) const;
+
+        /**
+         * @brief Calls func for every element of a list, in order.
+         * @param func The function to call.
+         */
+        void forEachElement(const std::function<void(const JPersistentObject&)>& func) const;
+
+        /**
+         * @brief Calls func for every member of a dict, in unspecified order.
+         * @param func The function to call.
+         */
+        void forEachMember(const std::function<void(const std::string&, const JPersistentObject&)>& func) const;
+
+    private:
+        struct ListNode;
+        struct DictNode;
+        struct Impl;
+
+        struct ListRoot
+        {
+            std::shared_ptr<const ListNode> root; ///< Null for an empty list.
+            size_t size = 0; ///< The number of elements.
+            unsigned shift = 0; ///< Bits of the index consumed above the leaves.
+        };
+
+        struct DictRoot
+        {
+            std::shared_ptr<const DictNode> root; ///< Null for an empty dict.
+            size_t size = 0; ///< The number of members.
+        };
+
+        using storage_t = std::variant<std::monostate, int_t, bool_t, double_t,
+            std::shared_ptr<const std::string>, ListRoot, DictRoot>;
+
+        JValueType m_type; ///< The type of the JSON value.
+        storage_t m_value; ///< The value, or the root of the tree for lists and dicts.
+    };
+
+    /**
+     * @brief Holds the current version of a persistent JSON document.
+     *
+     * Readers take a snapshot with load() and may keep it as long as they
+     * like; a writer publishes new versions with store() or update() without
+     * waiting for them.
+     */
+    class JPersistentDocument
+    {
+    public:
+        JPersistentDocument();
+        JPersistentDocument(JPersistentObject root);
+
+        JPersistentDocument(const JPersistentDocument&) = delete;
+        JPersistentDocument& operator=(const JPersistentDocument&) = delete;
+
+        /**
+         * @brief Takes a snapshot of the current version.
+         * @return The current version, which stays valid after later updates.
+         */
+        std::shared_ptr<const JPersistentObject> load() const;
+
+        /**
+         * @brief Publishes a new version.
+         * @param root The new version.
+         */
+        void store(JPersistentObject root);
+
+        /**
+         * @brief Publishes func(current), retrying if another writer published first.
+         * @param func Computes the new version from the current one.
+         * @return The version that was published.
+         */
+        JPersistentObject update(const std::function<JPersistentObject(const JPersistentObject&)>& func);
+
+    private:
+        std::atomic<std::shared_ptr<const JPersistentObject>> m_current; ///< The current version.
+    };
+}
+
+#endif // !JSON_PERSISTENT_HPP
@@ -0,0 +1,123 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef JSON_READER_HPP
+#define JSON_READER_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace qjson
+{
+    enum class JTokenType : unsigned char
+    {
+        End,
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Key,
+        String,
+        Number,
+        Bool,
+        Null
+    };
+
+    /**
+     * @brief Class for reading JSON one token at a time, without building a JObject.
+     *
+     * The caller pulls tokens with next() and reads them in place: getValue()
+     * is a view into the input, and getString() only allocates when the
+     * string has escapes. The grammar is the one JParser accepts, except that
+     * numbers can't have leading zeros, and errors throw std::logic_error.
+     */
+    class JReader
+    {
+    public:
+        /**
+         * @brief Constructs a reader over JSON data, which must outlive it.
+         * @param data The JSON data to read.
+         */
+        JReader(std::string_view data);
+
+        /**
+         * @brief Reads the next token.
+         * @return The type of the token, JTokenType::End after the top-level value.
+         */
+        JTokenType next();
+
+        /**
+         * @brief Skips the value the current token starts.
+         *
+         * After BeginObject or BeginArray, the reader moves to the matching end
+         * token; after Key, it skips the member's value. Other tokens are
+         * complete values already.
+         */
+        void skip();
+
+        JTokenType getType() const;
+
+        /**
+         * @brief Gets the text of the current token.
+         * @return The token as written in the input; strings and keys without their quotes, escapes kept.
+         */
+        std::string_view getValue() const;
+
+        /**
+         * @brief Gets the current string or key with its escapes decoded.
+         * @return A view into the input, or into an internal buffer if there were escapes.
+         */
+        std::string_view getString();
+
+        std::int64_t getInt64() const;
+        double getDouble() const;
+        bool getBool() const;
+
+        /**
+         * @brief Gets the number of containers that are open.
+         * @return The depth.
+         */
+        size_t getDepth() const;
+
+        /**
+         * @brief Gets the offset in the input just past the current token.
+         * @return The offset.
+         */
+        size_t getOffset() const;
+
+    protected:
+        void skipSpace();
+        void readString();
+        void readScalar();
+        bool isObject() const;
+        void push(bool isObject);
+
+        std::string_view m_data; ///< The input.
+        size_t m_itor = 0; ///< The offset of the next unread byte.
+        JTokenType m_type = JTokenType::End; ///< The current token.
+        std::string_view m_value; ///< The text of the current token.
+        bool m_escaped = false; ///< Whether the current string has escapes.
+        bool m_started = false; ///< Whether the top-level value has started.
+        bool m_afterValue = false; ///< Whether a value (or key) was just completed.
+        bool m_afterKey = false; ///< Whether the last token was a key.
+        size_t m_depth = 0; ///< The number of open containers.
+        std::uint64_t m_kinds[4] = {}; ///< Whether each of the first 256 open containers is an object.
+        std::vector<bool> m_deepKinds; ///< The same, for containers nested deeper.
+        std::string m_decoded; ///< The current string with its escapes decoded, when it has any.
+    };
+}
+
+#endif // !JSON_READER_HPP
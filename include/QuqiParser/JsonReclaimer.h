@@ -0,0 +1,98 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef JSON_RECLAIMER_HPP
+#define JSON_RECLAIMER_HPP
+
+#include "Json.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace qjson
+{
+    /**
+     * @brief Class for freeing large JSON objects off the thread that drops them.
+     *
+     * retire() takes the value of a JObject in constant time; the nodes are
+     * freed later, either by a background thread or a bounded number at a
+     * time by collect(). A wide list or dict is emptied a part at a time, so
+     * the work done by one collect() call doesn't depend on the size of the
+     * containers. Values still shared with other JObjects are only released,
+     * and their nodes are freed by whichever copy is dropped last.
+     */
+    class JReclaimer
+    {
+    public:
+        /**
+         * @brief Constructs a reclaimer.
+         * @param background Whether a background thread frees the retired values;
+         * otherwise they are freed by collect() and drain() only.
+         */
+        JReclaimer(bool background = true);
+        JReclaimer(const JReclaimer&) = delete;
+        JReclaimer& operator=(const JReclaimer&) = delete;
+
+        /**
+         * @brief Frees everything still retired, then stops the background thread.
+         */
+        ~JReclaimer();
+
+        /**
+         * @brief Hands over a value to be freed later.
+         * @param jo The JSON object, which is left null.
+         */
+        void retire(JObject&& jo);
+
+        /**
+         * @brief Frees retired values on the calling thread, a bounded amount at a time.
+         * @param budget The maximum number of elements, lists and dicts to free;
+         * each element of a list or member of a dict counts once, and so does
+         * the container when it is freed.
+         * @return The number of elements, lists and dicts freed.
+         */
+        size_t collect(size_t budget);
+
+        /**
+         * @brief Frees everything retired so far, and waits for the background thread to finish
+         * what it is freeing.
+         */
+        void drain();
+
+        /**
+         * @brief Gets the number of lists and dicts waiting to be freed, not counting those being freed.
+         *
+         * The lists and dicts below them are only counted once their parent is freed.
+         * @return The number of lists and dicts.
+         */
+        size_t pending() const;
+
+    protected:
+        using storage_t = std::shared_ptr<JObject::Storage>;
+
+        void work(std::stop_token stop);
+
+        std::vector<storage_t> m_pending; ///< The lists and dicts waiting to be freed, some partly emptied.
+        size_t m_busy = 0; ///< The number of collect() calls freeing values outside the lock.
+        mutable std::mutex m_mutex; ///< Guards m_pending and m_busy.
+        std::condition_variable_any m_retired; ///< Signalled when values are added to m_pending.
+        std::condition_variable m_idle; ///< Signalled when a collect() call finishes.
+        std::jthread m_worker; ///< The background thread, declared last so that it stops first.
+    };
+}
+
+#endif // !JSON_RECLAIMER_HPP
@@ -0,0 +1,132 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef JSON_STREAM_WRITER_HPP
+#define JSON_STREAM_WRITER_HPP
+
+#include <charconv>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace qjson
+{
+    /**
+     * @brief Class for writing JSON directly to a buffer or sink, without building a JObject.
+     *
+     * Compact output matches JWriter::write() and formatted output matches
+     * JWriter::formatWrite(). Misuse, such as a value where a key is
+     * expected, throws std::logic_error.
+     */
+    class JStreamWriter
+    {
+    public:
+        using sink_t = std::function<void(std::string_view)>;
+
+        /**
+         * @brief Constructs a writer that collects the output in its buffer.
+         * @param format Whether to indent the output like JWriter::formatWrite().
+         */
+        JStreamWriter(bool format = false);
+
+        /**
+         * @brief Constructs a writer that hands the output to a sink in chunks.
+         * @param sink Receives the output.
+         * @param format Whether to indent the output like JWriter::formatWrite().
+         * @param flushSize The buffer size at which the output is handed to the sink.
+         */
+        JStreamWriter(sink_t sink, bool format = false, size_t flushSize = 64 * 1024);
+
+        JStreamWriter& beginObject();
+        JStreamWriter& endObject();
+        JStreamWriter& beginArray();
+        JStreamWriter& endArray();
+        JStreamWriter& key(std::string_view name);
+
+        JStreamWriter& null();
+        JStreamWriter& value(bool data);
+        JStreamWriter& value(double data);
+        JStreamWriter& value(long double data);
+        JStreamWriter& value(const char* data);
+        JStreamWriter& value(std::string_view data);
+
+        template<typename T>
+            requires std::is_integral_v<T> && (!std::is_same_v<T, bool>) && (!std::is_same_v<T, char>)
+        JStreamWriter& value(T data)
+        {
+            char buffer[24];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), data);
+            return rawValue(std::string_view(buffer, result.ptr - buffer));
+        }
+
+        /**
+         * @brief Writes a value that is already serialized JSON, unchanged.
+         * @param json The serialized value.
+         * @return This writer.
+         */
+        JStreamWriter& rawValue(std::string_view json);
+
+        /**
+         * @brief Checks whether one complete top-level value has been written.
+         * @return true if the document is complete.
+         */
+        bool isComplete() const;
+
+        /**
+         * @brief Gets the output that has not been handed to the sink yet.
+         * @return The buffered output.
+         */
+        const std::string& getBuffer() const;
+
+        /**
+         * @brief Takes the buffered output out of the writer.
+         * @return The buffered output.
+         */
+        std::string release();
+
+        /**
+         * @brief Hands the buffered output to the sink.
+         */
+        void flush();
+
+        /**
+         * @brief Discards the buffer and the state, so a new document can be written.
+         */
+        void reset();
+
+    protected:
+        struct Frame
+        {
+            bool isObject; ///< Whether the container is an object.
+            bool first; ///< Whether no member has been written yet.
+        };
+
+        void beforeValue();
+        void afterValue();
+        void separate();
+        void indent(size_t n);
+
+        std::string m_buffer; ///< The output not handed to the sink yet.
+        sink_t m_sink; ///< Receives the output, if set.
+        size_t m_flushSize = 0; ///< The buffer size at which the sink is called.
+        bool m_format = false; ///< Whether the output is indented.
+        bool m_expectValue = false; ///< Whether a key has been written without its value.
+        bool m_complete = false; ///< Whether the top-level value is complete.
+        std::vector<Frame> m_stack; ///< The open containers, innermost last.
+    };
+}
+
+#endif // !JSON_STREAM_WRITER_HPP
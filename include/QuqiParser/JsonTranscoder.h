@@ -0,0 +1,176 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef JSON_TRANSCODER_HPP
+#define JSON_TRANSCODER_HPP
+
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace qjson
+{
+    /**
+     * @brief Options for the layout written by JTranscoder.
+     */
+    struct JTranscodeOptions
+    {
+        bool pretty = false; ///< Whether to indent the output, or minify it.
+        size_t indentWidth = 4; ///< The number of indent characters per level.
+        char indentChar = ' '; ///< The character used for indentation.
+    };
+
+    /**
+     * @brief Class for minifying or re-indenting JSON text without building a JObject.
+     *
+     * The input can be fed in chunks of any size. String and number tokens
+     * are checked against the JSON grammar (escapes and surrogate pairs
+     * included) and copied byte for byte, and key order is kept, so only
+     * whitespace changes; trailing commas are dropped. Several top-level
+     * values separated by whitespace, as in JSON Lines, are written one per
+     * line. Malformed input throws std::logic_error.
+     */
+    class JTranscoder
+    {
+    public:
+        using sink_t = std::function<void(std::string_view)>;
+
+        /**
+         * @brief Constructs a transcoder that collects the output in its buffer.
+         * @param options The output layout.
+         */
+        JTranscoder(const JTranscodeOptions& options = {});
+
+        /**
+         * @brief Constructs a transcoder that hands the output to a sink in chunks.
+         * @param sink Receives the output.
+         * @param options The output layout.
+         * @param flushSize The buffer size at which the output is handed to the sink.
+         */
+        JTranscoder(sink_t sink, const JTranscodeOptions& options = {}, size_t flushSize = 64 * 1024);
+
+        /**
+         * @brief Transcodes the next chunk of the input.
+         * @param data The chunk, which may end in the middle of a token.
+         */
+        void feed(std::string_view data);
+
+        /**
+         * @brief Transcodes a whole file, reading it in blocks.
+         * @param infile The file to read.
+         */
+        void feed(std::ifstream& infile);
+
+        /**
+         * @brief Checks that the input is complete and hands the rest of the output to the sink.
+         */
+        void finish();
+
+        /**
+         * @brief Gets the output that has not been handed to the sink yet.
+         * @return The buffered output.
+         */
+        const std::string& getBuffer() const;
+
+        /**
+         * @brief Takes the buffered output out of the transcoder.
+         * @return The buffered output.
+         */
+        std::string release();
+
+        /**
+         * @brief Discards the buffer and the state, so a new input can be transcoded.
+         */
+        void reset();
+
+        /**
+         * @brief Quickly minifies JSON text.
+         * @param data The JSON text.
+         * @return The minified text.
+         */
+        static std::string minify(std::string_view data);
+
+        /**
+         * @brief Quickly re-indents JSON text.
+         * @param data The JSON text.
+         * @param indentWidth The number of indent characters per level.
+         * @param indentChar The character used for indentation.
+         * @return The indented text.
+         */
+        static std::string prettify(std::string_view data, size_t indentWidth = 4, char indentChar = ' ');
+
+    protected:
+        enum class Expect : unsigned char
+        {
+            First, ///< After an opening bracket.
+            Element, ///< After a comma.
+            Colon, ///< After a key.
+            Value, ///< After a colon.
+            Comma ///< After a member.
+        };
+
+        enum class Scalar : unsigned char
+        {
+            None, ///< Not inside a number or literal.
+            Minus, ///< After the minus sign of a number.
+            Zero, ///< After a leading zero.
+            Integer, ///< In the digits of the integer part.
+            Point, ///< After the decimal point.
+            Fraction, ///< In the digits of the fraction.
+            Exponent, ///< After the e of the exponent.
+            ExponentSign, ///< After the sign of the exponent.
+            ExponentDigits, ///< In the digits of the exponent.
+            Literal ///< In true, false or null.
+        };
+
+        struct Frame
+        {
+            bool isObject; ///< Whether the container is an object.
+            Expect expect; ///< The next token allowed.
+        };
+
+        void readHexDigit(char c);
+        void beginScalar(char c);
+        bool continueScalar(char c);
+        void endScalar();
+        void beginValue(bool isString);
+        void beginElement();
+        void open(char bracket);
+        void close(char bracket);
+        void indent(size_t n);
+        void flush();
+
+        std::string m_buffer; ///< The output not handed to the sink yet.
+        sink_t m_sink; ///< Receives the output, if set.
+        size_t m_flushSize = 0; ///< The buffer size at which the sink is called.
+        JTranscodeOptions m_options; ///< The output layout.
+        std::vector<Frame> m_stack; ///< The open containers, innermost last.
+        size_t m_count = 0; ///< The number of top-level values started.
+        bool m_inString = false; ///< Whether the input is inside a string.
+        bool m_escape = false; ///< Whether the previous string character was a backslash.
+        unsigned char m_hexLeft = 0; ///< The number of hex digits of a \\u escape still to read.
+        unsigned m_unit = 0; ///< The code unit of the \\u escape being read.
+        bool m_highSurrogate = false; ///< Whether the last \\u escape was a high surrogate, so a low one must follow.
+        bool m_spaced = true; ///< Whether whitespace was read since the last top-level value started.
+        Scalar m_scalar = Scalar::None; ///< Where the input is inside a number or literal.
+        const char* m_literal = nullptr; ///< The literal being read, for Scalar::Literal.
+        size_t m_matched = 0; ///< The number of characters of the literal read so far.
+        bool m_pendingOpen = false; ///< Whether a container was opened and nothing written into it.
+        bool m_pendingComma = false; ///< Whether a comma was read and not written yet.
+    };
+}
+
+#endif // !JSON_TRANSCODER_HPP
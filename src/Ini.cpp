@@ -14,6 +14,8 @@
 
 #include <QuqiParser/Ini.h>
 
+#include <algorithm>
+
 #define INI_NAMESPACE_START namespace qini {
 #define INI_NAMESPACE_END }
 
@@ -21,15 +23,15 @@ INI_NAMESPACE_START
 
 // Section
 
-INIObject::Section::Section(std::unordered_map<std::string, std::string>& section) :
+INIObject::Section::Section(keys_t& section) :
     m_keys(section)
 {}
 
-INIObject::Section::iterator::iterator(const std::unordered_map<std::string, std::string>::iterator& itor) :
+INIObject::Section::iterator::iterator(const keys_t::iterator& itor) :
     m_itor(itor)
 {}
 
-INIObject::Section::iterator::iterator(std::unordered_map<std::string, std::string>::iterator&& itor) :
+INIObject::Section::iterator::iterator(keys_t::iterator&& itor) :
     m_itor(std::move(itor))
 {}
 
@@ -44,12 +46,15 @@ std::string INIObject::Section::iterator::operator *()
     return std::move(m_itor->second);
 }
 
-std::string& INIObject::Section::operator [](const std::string& keyName)
+std::string& INIObject::Section::operator [](std::string_view keyName)
 {
-    return m_keys[keyName];
+    auto itor = m_keys.find(keyName);
+    if (itor == m_keys.end())
+        itor = m_keys.emplace(keyName, std::string()).first;
+    return itor->second;
 }
 
-const std::string& INIObject::Section::operator [](const std::string& keyName) const
+const std::string& INIObject::Section::operator [](std::string_view keyName) const
 {
     auto itor = m_keys.find(keyName);
     if (itor == m_keys.end()) throw std::logic_error("Invalid Keyword");
@@ -78,12 +83,12 @@ bool operator !=(const INIObject::Section::iterator& a, const INIObject::Section
 
 // Const_Section
 
-qini::INIObject::Const_Section::const_iterator::const_iterator(const std::unordered_map<std::string, std::string>::const_iterator& itor) :
+qini::INIObject::Const_Section::const_iterator::const_iterator(const keys_t::const_iterator& itor) :
     m_itor(itor)
 {
 }
 
-qini::INIObject::Const_Section::const_iterator::const_iterator(std::unordered_map<std::string, std::string>::const_iterator&& itor) :
+qini::INIObject::Const_Section::const_iterator::const_iterator(keys_t::const_iterator&& itor) :
     m_itor(std::move(itor))
 {
 }
@@ -109,12 +114,12 @@ bool operator!=(const qini::INIObject::Const_Section::const_iterator& a, const q
     return a.m_itor != b.m_itor;
 }
 
-qini::INIObject::Const_Section::Const_Section(const std::unordered_map<std::string, std::string>& section) :
+qini::INIObject::Const_Section::Const_Section(const keys_t& section) :
     m_keys(section)
 {
 }
 
-const std::string& qini::INIObject::Const_Section::operator[](const std::string& keyName) const
+const std::string& qini::INIObject::Const_Section::operator[](std::string_view keyName) const
 {
     auto itor = m_keys.find(keyName);
     if (itor == m_keys.end()) throw std::logic_error("Invalid Keyword");
@@ -133,11 +138,11 @@ qini::INIObject::Const_Section::const_iterator qini::INIObject::Const_Section::e
 
 // IniObject
 
-INIObject::iterator::iterator(const std::unordered_map<std::string, std::unordered_map<std::string, std::string>>::iterator& itor) :
+INIObject::iterator::iterator(const sections_t::iterator& itor) :
     m_itor(itor)
 {}
 
-INIObject::iterator::iterator(std::unordered_map<std::string, std::unordered_map<std::string, std::string>>::iterator&& itor) :
+INIObject::iterator::iterator(sections_t::iterator&& itor) :
     m_itor(std::move(itor))
 {}
 
@@ -162,12 +167,12 @@ bool operator !=(const INIObject::iterator& a, const INIObject::iterator& b)
     return a.m_itor != b.m_itor;
 }
 
-INIObject::const_iterator::const_iterator(const std::unordered_map<std::string, std::unordered_map<std::string, std::string>>::const_iterator& itor) :
+INIObject::const_iterator::const_iterator(const sections_t::const_iterator& itor) :
     m_itor(itor)
 {
 }
 
-INIObject::const_iterator::const_iterator(std::unordered_map<std::string, std::unordered_map<std::string, std::string>>::const_iterator&& itor) :
+INIObject::const_iterator::const_iterator(sections_t::const_iterator&& itor) :
     m_itor(std::move(itor))
 {
 }
@@ -219,19 +224,31 @@ INIObject& INIObject::operator =(INIObject&& ob) noexcept
     return *this;
 }
 
-INIObject::Section INIObject::operator [](const std::string& sectionName)
+INIObject::Section INIObject::operator [](std::string_view sectionName)
 {
     //if (m_sections.find(sectionName) == m_sections.end()) throw std::logic_error("Invalid Section Name");
-    return Section(m_sections[sectionName]);
+    auto itor = m_sections.find(sectionName);
+    if (itor == m_sections.end())
+        itor = m_sections.emplace(sectionName, keys_t()).first;
+    return Section(itor->second);
 }
 
-INIObject::Const_Section qini::INIObject::operator[](const std::string& sectionName) const
+INIObject::Const_Section qini::INIObject::operator[](std::string_view sectionName) const
 {
     auto itor = m_sections.find(sectionName);
     if (itor == m_sections.end()) throw std::logic_error("Invalid Section Name");
     return Const_Section(itor->second);
 }
 
+const std::string* INIObject::find(std::string_view sectionName, std::string_view keyName) const
+{
+    auto section = m_sections.find(sectionName);
+    if (section == m_sections.end())
+        return nullptr;
+    auto key = section->second.find(keyName);
+    return key == section->second.end() ? nullptr : &key->second;
+}
+
 INIObject::iterator INIObject::begin()
 {
     return { std::move(m_sections.begin()) };
@@ -254,52 +271,74 @@ bool operator !=(const INIObject& ia, const INIObject& ib)
 
 INIObject INIParser::parse(std::string_view data)
 {
-    INIObject localObject;
-    long long error_line = 0;
+    INIParseResult result = tryParse(data);
+    if (!result)
+        throw std::logic_error(result.error.describe(data));
+    return std::move(result.value);
+}
+
+INIParseResult INIParser::tryParse(std::string_view data)
+{
+    INIParseResult result;
+    auto i = data.begin();
+    INIErrorCode error = _parse(data, i, result.value);
+    if (error != INIErrorCode::None)
+    {
+        result.value = INIObject();
+        result.error = { error, static_cast<size_t>(i - data.begin()) };
+    }
+    return result;
+}
 
+INIErrorCode INIParser::_parse(std::string_view data, std::string_view::iterator& i, INIObject& object)
+{
     std::string localSection;
-    for (auto i = data.begin(); i != data.end(); i++)
+    for (; i != data.end(); i++)
     {
-        if (!skipSpace(i, data, error_line))
+        if (!skipSpace(i, data))
             break;
 
         if (*i == '[')
         {
             i++;
-            if (!skipSpace(i, data, error_line))
-                throw std::logic_error(get_logic_error_string(error_line));
+            if (!skipSpace(i, data))
+                return INIErrorCode::UnexpectedEnd;
 
-            localSection = getString(i, data, error_line);
+            localSection = getString(i, data);
 
-            if (!skipSpace(i, data, error_line))
-                throw std::logic_error(get_logic_error_string(error_line));
+            if (!skipSpace(i, data))
+                return INIErrorCode::UnexpectedEnd;
 
             if (*i == ']')
                 i++;
             else
-                throw std::logic_error(get_logic_error_string(error_line));
+                return INIErrorCode::UnexpectedCharacter;
         }
         else if (*i == '=')
         {
-            throw std::logic_error(get_logic_error_string(error_line));
+            return INIErrorCode::UnexpectedCharacter;
         }
         else
         {
             if (localSection.empty())
-                throw std::logic_error(get_logic_error_string(error_line));
+                return INIErrorCode::KeyOutsideSection;
 
-            std::string localKey = getString(i, data, error_line);
+            std::string localKey = getString(i, data);
 
+            if (i == data.end())
+                return INIErrorCode::UnexpectedEnd;
             if (*i == '=')
                 i++;
             else
-                throw std::logic_error(get_logic_error_string(error_line));
+                return INIErrorCode::UnexpectedCharacter;
 
-            localObject.m_sections[localSection][localKey] = getString(i, data, error_line);
+            object.m_sections[localSection][localKey] = getString(i, data);
         }
+        if (i == data.end())
+            break;
     }
 
-    return localObject;
+    return INIErrorCode::None;
 }
 
 INIObject qini::INIParser::fastParse(std::string_view data)
@@ -321,7 +360,7 @@ INIObject qini::INIParser::fastParse(std::ifstream& infile)
     return std::move(INIParser::fastParse(buffer));
 }
 
-bool INIParser::skipSpace(std::string_view::iterator& i, std::string_view data, long long& error_line)
+bool INIParser::skipSpace(std::string_view::iterator& i, std::string_view data)
 {
     while (i != data.end() && (*i == ' ' || *i == '\n' || *i == '\t' || *i == ';' || *i == '#' || *i == '\0'))
     {
@@ -330,16 +369,13 @@ bool INIParser::skipSpace(std::string_view::iterator& i, std::string_view data,
             for (; i != data.end() && *i != '\n'; i++) {}
         }
         else
-        {
-            if (*i == '\n') error_line++;
             i++;
-        }
     }
 
     return i != data.end();
 }
 
-std::string INIParser::getString(std::string_view::iterator& i, std::string_view data, long long error_line)
+std::string INIParser::getString(std::string_view::iterator& i, std::string_view data)
 {
     std::string localString;
     while (i != data.end() && (*i != ' ' && *i != '\n' && *i != '\t' && *i != '[' && *i != ']' && *i != '=' && *i != ';'))
@@ -350,9 +386,42 @@ std::string INIParser::getString(std::string_view::iterator& i, std::string_view
     return localString;
 }
 
-std::string qini::INIParser::get_logic_error_string(long long error_line)
+std::string INIParseError::describe(std::string_view data) const
 {
-    return "Invalid Input, in line " + std::to_string(error_line);
+    const char* what = "No error";
+    switch (code)
+    {
+    case INIErrorCode::UnexpectedEnd:
+        what = "Unexpected end of input";
+        break;
+    case INIErrorCode::UnexpectedCharacter:
+        what = "Unexpected character";
+        break;
+    case INIErrorCode::KeyOutsideSection:
+        what = "Key outside of any section";
+        break;
+    default:
+        break;
+    }
+
+    // Lines are counted only here, from the start of the input to the error.
+    size_t at = std::min(offset, data.size());
+    size_t lineBegin = at;
+    while (lineBegin > 0 && data[lineBegin - 1] != '\n')
+        lineBegin--;
+    size_t lineEnd = data.find('\n', at);
+    if (lineEnd == std::string_view::npos)
+        lineEnd = data.size();
+    size_t line = std::count(data.begin(), data.begin() + lineBegin, '\n') + 1;
+
+    std::string message = std::string(what) + " at line " + std::to_string(line) +
+        ", column " + std::to_string(at - lineBegin + 1) + ":\n";
+    message.append(data.substr(lineBegin, lineEnd - lineBegin));
+    message += '\n';
+    for (size_t i = lineBegin; i < at; i++)
+        message += data[i] == '\t' ? '\t' : ' ';
+    message += '^';
+    return message;
 }
 
 std::string INIWriter::write(const INIObject& ob)
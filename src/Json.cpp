@@ -14,73 +14,440 @@
 
 #include <QuqiParser/Json.h>
 
+#include <algorithm>
+#include <charconv>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
 
 #define JSON_NAMESPACE_START namespace qjson {
 #define JSON_NAMESPACE_END }
 
 JSON_NAMESPACE_START
 
-JObject::JObject()
-    :m_type(JValueType::JNull),
-    m_value(std::make_unique<value_t>())
+namespace
+{
+    size_t packedCount(const packed_t& packed)
+    {
+        return std::visit([](const auto& numbers) { return numbers.size(); }, packed.numbers);
+    }
+
+    /**
+     * @brief Reads the four hex digits of a \\u escape.
+     * @return The code unit, or -1 if a digit is missing or invalid.
+     */
+    long hexQuad(std::string_view data, size_t itor)
+    {
+        if (data.size() - itor < 4)
+            return -1;
+        long unit = 0;
+        for (size_t i = itor; i < itor + 4; i++)
+        {
+            char c = data[i];
+            unit <<= 4;
+            if (c >= '0' && c <= '9')
+                unit |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                unit |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                unit |= c - 'A' + 10;
+            else
+                return -1;
+        }
+        return unit;
+    }
+
+    /**
+     * @brief Memory handed out in order from large blocks, each freed once all of its allocations are.
+     *
+     * Nodes can be released from any thread, so the arena is locked.
+     */
+    class NodeArena
+    {
+    public:
+        void* allocate(size_t size, size_t align)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            size_t offset = (m_used + align - 1) & ~(align - 1);
+            if (m_current == nullptr || offset + size > m_current->size)
+            {
+                // Blocks grow so that small trees waste little and large ones need few blocks.
+                if (!m_blocks.empty() && m_blockSize < maxBlockSize)
+                    m_blockSize *= 2;
+                m_blockSize = std::max(m_blockSize, size);
+                auto memory = std::make_unique<std::byte[]>(m_blockSize);
+                std::byte* begin = memory.get();
+                m_current = &m_blocks.emplace(begin, Block{ std::move(memory), m_blockSize, 0 }).first->second;
+                offset = 0;
+            }
+            m_used = offset + size;
+            m_current->live++;
+            return m_current->memory.get() + offset;
+        }
+
+        void deallocate(void* pointer) noexcept
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto block = std::prev(m_blocks.upper_bound(static_cast<std::byte*>(pointer)));
+            if (--block->second.live > 0)
+                return;
+            // An edited document gives back the blocks it no longer uses.
+            if (&block->second == m_current)
+                m_current = nullptr;
+            m_blocks.erase(block);
+        }
+
+    private:
+        struct Block
+        {
+            std::unique_ptr<std::byte[]> memory; ///< The memory of the block.
+            size_t size; ///< The size of the block.
+            size_t live; ///< The number of allocations in the block not yet freed.
+        };
+
+        static constexpr size_t maxBlockSize = 1 << 20;
+
+        std::mutex m_mutex;
+        std::map<std::byte*, Block> m_blocks; ///< The blocks in use, by address.
+        Block* m_current = nullptr; ///< The block being filled, nullptr if there is none.
+        size_t m_blockSize = 4096;
+        size_t m_used = 0;
+    };
+
+    /**
+     * @brief Allocator of the nodes of a compacted tree; each node keeps the arena alive.
+     */
+    template<typename T>
+    struct ArenaAllocator
+    {
+        using value_type = T;
+
+        ArenaAllocator(std::shared_ptr<NodeArena> arena)
+            :arena(std::move(arena))
+        {
+        }
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other)
+            :arena(other.arena)
+        {
+        }
+
+        T* allocate(size_t count)
+        {
+            static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+            return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* pointer, size_t) noexcept
+        {
+            arena->deallocate(pointer);
+        }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U>& other) const
+        {
+            return arena == other.arena;
+        }
+
+        std::shared_ptr<NodeArena> arena;
+    };
+
+    /**
+     * @brief Output buffer that hashes the bytes (FNV-1a, 64 bits) as they are appended.
+     */
+    class DigestSink
+    {
+    public:
+        DigestSink(std::string& out)
+            :m_out(out)
+        {
+        }
+
+        void append(std::string_view data)
+        {
+            m_out.append(data);
+            hash(data);
+        }
+
+        void appendString(std::string_view str)
+        {
+            size_t begin = m_out.size();
+            JWriter::writeString(m_out, str);
+            hash(std::string_view(m_out).substr(begin));
+        }
+
+        void append(char c)
+        {
+            m_out += c;
+            m_digest = (m_digest ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+        }
+
+        std::uint64_t digest() const
+        {
+            return m_digest;
+        }
+
+    private:
+        void hash(std::string_view data)
+        {
+            for (unsigned char c : data)
+                m_digest = (m_digest ^ c) * 0x100000001b3ULL;
+        }
+
+        std::string& m_out;
+        std::uint64_t m_digest = 0xcbf29ce484222325ULL;
+    };
+
+    void writeCanonicalInt(DigestSink& sink, long long value)
+    {
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        sink.append(std::string_view(buffer, result.ptr - buffer));
+    }
+
+    void writeCanonicalDouble(DigestSink& sink, double value)
+    {
+        char buffer[64];
+        if (!std::isfinite(value))
+            throw std::logic_error("Invalid number");
+        if (value == 0)
+            value = 0;
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        std::string_view text(buffer, result.ptr - buffer);
+        sink.append(text);
+        // Keep the value a double when it is read back.
+        if (text.find_first_of(".e") == std::string_view::npos)
+            sink.append(".0");
+    }
+
+    void writeCanonicalScalar(DigestSink& sink, const JObject& jo)
+    {
+        switch (jo.getType())
+        {
+        case JValueType::JNull:
+            sink.append("null");
+            break;
+        case JValueType::JInt:
+            writeCanonicalInt(sink, jo.getInt());
+            break;
+        case JValueType::JDouble:
+            writeCanonicalDouble(sink, static_cast<double>(jo.getDouble()));
+            break;
+        case JValueType::JBool:
+            sink.append(jo.getBool() ? "true" : "false");
+            break;
+        case JValueType::JString:
+            sink.appendString(jo.getString());
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+JKey::JKey(std::string_view key)
+    :m_key(key),
+    m_hash(key_hash_t{}(key))
 {
-    *m_value = null_t();
 }
 
-JObject::JObject(const JObject& jo)
-    :m_type(jo.m_type),
-    m_value(std::make_unique<value_t>())
+const std::string& JKey::str() const
 {
-    switch (jo.m_type)
+    return m_key;
+}
+
+size_t JKey::hash() const
+{
+    return m_hash;
+}
+
+bool operator==(const JKey& key, std::string_view other)
+{
+    return key.m_key == other;
+}
+
+packed_t::Elements::Elements(size_t size)
+    :size(size),
+    slots(new std::atomic<JObject*>[size]())
+{
+}
+
+packed_t::Elements::~Elements()
+{
+    for (size_t i = 0; i < size; i++)
+        delete slots[i].load(std::memory_order_relaxed);
+}
+
+packed_t::packed_t(std::vector<std::int64_t> ints)
+    :numbers(std::move(ints))
+{
+}
+
+packed_t::packed_t(std::vector<double> doubles)
+    :numbers(std::move(doubles))
+{
+}
+
+packed_t::packed_t(const packed_t& other)
+    :numbers(other.numbers)
+{
+}
+
+packed_t::packed_t(packed_t&& other) noexcept
+    :numbers(std::move(other.numbers))
+{
+}
+
+packed_t::~packed_t()
+{
+    release();
+}
+
+packed_t& packed_t::operator=(const packed_t& other)
+{
+    if (this != &other)
     {
-    case JValueType::JString:
-        *m_value = *std::get_if<string_t>(jo.m_value.get());
-        break;
-    case JValueType::JList:
-        *m_value = *std::get_if<list_t>(jo.m_value.get());
-        break;
-    case JValueType::JDict:
-        *m_value = *std::get_if<dict_t>(jo.m_value.get());
-        break;
-    default:
-        *m_value = *jo.m_value;
-        break;
+        release();
+        numbers = other.numbers;
+    }
+    return *this;
+}
+
+packed_t& packed_t::operator=(packed_t&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        numbers = std::move(other.numbers);
+    }
+    return *this;
+}
+
+void packed_t::release()
+{
+    delete unpacked.exchange(nullptr, std::memory_order_relaxed);
+    delete elements.exchange(nullptr, std::memory_order_relaxed);
+}
+
+shaped_t::shaped_t(std::shared_ptr<const shape_t> shape, size_t size)
+    :shape(std::move(shape)),
+    values(size)
+{
+}
+
+shaped_t::shaped_t(const shaped_t& other)
+    :shape(other.shape),
+    values(other.values)
+{
+}
+
+shaped_t::shaped_t(shaped_t&& other) noexcept
+    :shape(std::move(other.shape)),
+    values(std::move(other.values))
+{
+}
+
+shaped_t::~shaped_t()
+{
+    delete unshaped.load(std::memory_order_relaxed);
+}
+
+shaped_t& shaped_t::operator=(const shaped_t& other)
+{
+    if (this != &other)
+    {
+        shape = other.shape;
+        values = other.values;
+        delete unshaped.exchange(nullptr, std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+shaped_t& shaped_t::operator=(shaped_t&& other) noexcept
+{
+    if (this != &other)
+    {
+        shape = std::move(other.shape);
+        values = std::move(other.values);
+        delete unshaped.exchange(nullptr, std::memory_order_relaxed);
     }
+    return *this;
+}
+
+lexeme_t::lexeme_t(std::string_view text)
+    :text(text)
+{
+}
+
+lexeme_t::lexeme_t(const lexeme_t& other)
+    :text(other.text)
+{
+}
+
+lexeme_t::lexeme_t(lexeme_t&& other) noexcept
+    :text(std::move(other.text))
+{
+}
+
+lexeme_t& lexeme_t::operator=(const lexeme_t& other)
+{
+    text = other.text;
+    state.store(0, std::memory_order_relaxed);
+    return *this;
+}
+
+lexeme_t& lexeme_t::operator=(lexeme_t&& other) noexcept
+{
+    text = std::move(other.text);
+    state.store(0, std::memory_order_relaxed);
+    return *this;
+}
+
+JObject::JObject()
+    :m_type(JValueType::JNull)
+{
+}
+
+JObject::JObject(const JObject& jo)
+    :m_type(JValueType::JNull)
+{
+    copyValue(*this, jo, false);
 }
 
 JObject::JObject(JObject&& jo) noexcept
-    :m_type(jo.m_type)
+    :m_type(jo.m_type),
+    m_value(std::move(jo.m_value))
 {
-    m_value = std::move(jo.m_value);
+    jo.m_type = JValueType::JNull;
 }
 
 JObject::JObject(JValueType jvt)
-    :m_type(jvt),
-    m_value(std::make_unique<value_t>())
+    :m_type(jvt)
 {
     switch (jvt)
     {
-    case qjson::JValueType::JNull:
-        *m_value = null_t();
-        break;
     case qjson::JValueType::JInt:
-        *m_value = int_t();
+        m_value = std::make_shared<Storage>(std::in_place_type<int_t>);
         break;
     case qjson::JValueType::JDouble:
-        *m_value = double_t();
+        m_value = std::make_shared<Storage>(std::in_place_type<double_t>);
         break;
     case qjson::JValueType::JBool:
-        *m_value = bool_t();
+        m_value = std::make_shared<Storage>(std::in_place_type<bool_t>);
         break;
     case qjson::JValueType::JString:
-        *m_value = string_t();
+        m_value = std::make_shared<Storage>(std::in_place_type<string_t>);
         break;
     case qjson::JValueType::JList:
-        *m_value = list_t();
+        m_value = std::make_shared<Storage>(std::in_place_type<list_t>);
         break;
     case qjson::JValueType::JDict:
-        *m_value = dict_t();
+        m_value = std::make_shared<Storage>(std::in_place_type<dict_t>);
         break;
     default:
         break;
@@ -89,111 +456,183 @@ JObject::JObject(JValueType jvt)
 
 JObject::JObject(long long value)
     :m_type(JValueType::JInt),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<int_t>, value))
 {
-    *m_value = value;
 }
 
 JObject::JObject(long value)
     :m_type(JValueType::JInt),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<int_t>, value))
 {
-    *m_value = static_cast<long long>(value);
 }
 
 JObject::JObject(int value)
     :m_type(JValueType::JInt),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<int_t>, value))
 {
-    *m_value = static_cast<long long>(value);
 }
 
 JObject::JObject(short value)
     :m_type(JValueType::JInt),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<int_t>, value))
 {
-    *m_value = static_cast<long long>(value);
 }
 
 JObject::JObject(bool value)
     :m_type(JValueType::JBool),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<bool_t>, value))
 {
-    *m_value = value;
 }
 
 JObject::JObject(long double value)
     :m_type(JValueType::JDouble),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<double_t>, value))
 {
-    *m_value = value;
 }
 
 JObject::JObject(double value)
     :m_type(JValueType::JDouble),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<double_t>, value))
 {
-    *m_value = static_cast<long double>(value);
 }
 
 JObject::JObject(float value)
     :m_type(JValueType::JDouble),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<double_t>, value))
 {
-    *m_value = static_cast<long double>(value);
 }
 
 JObject::JObject(const char* data)
     :m_type(JValueType::JString),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<string_t>, data))
 {
-    *m_value = std::string(data);
 }
 
 JObject::JObject(const std::string& data)
     :m_type(JValueType::JString),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<string_t>, data))
 {
-    *m_value = data;
 }
 
 qjson::JObject::JObject(std::string_view data)
     :m_type(JValueType::JString),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<string_t>, data))
 {
-    *m_value = std::string(data);
 }
 
 JObject::JObject(std::string&& data)
     :m_type(JValueType::JString),
-    m_value(std::make_unique<value_t>())
+    m_value(std::make_shared<Storage>(std::in_place_type<string_t>, std::move(data)))
+{
+}
+
+JObject::~JObject()
+{
+    if (!m_value || m_value.use_count() != 1 ||
+        (m_type != JValueType::JList && m_type != JValueType::JDict))
+        return;
+
+    // Detach the container values owned only by the children before freeing
+    // a value, so that a deep tree is torn down in a loop instead of by
+    // recursion. Values still shared with other objects are just released.
+    std::vector<std::shared_ptr<Storage>> pending;
+    pending.push_back(std::move(m_value));
+    while (!pending.empty())
+    {
+        std::shared_ptr<Storage> storage = std::move(pending.back());
+        pending.pop_back();
+        detachChildren(*storage, pending);
+    }
+}
+
+void JObject::detachChildren(Storage& storage, std::vector<std::shared_ptr<Storage>>& pending)
+{
+    if (list_t* list = std::get_if<list_t>(&storage.value))
+    {
+        for (auto& child : *list)
+            detachChild(child, pending);
+    }
+    else if (dict_t* dict = std::get_if<dict_t>(&storage.value))
+    {
+        for (auto& [key, child] : *dict)
+            detachChild(child, pending);
+    }
+    else if (shaped_t* shaped = std::get_if<shaped_t>(&storage.value))
+    {
+        // The dict_t built by getDict() const shares the values, so it is
+        // dropped first; otherwise no child would be owned only by values.
+        if (dict_t* unshaped = shaped->unshaped.exchange(nullptr, std::memory_order_acquire))
+        {
+            for (auto& [key, child] : *unshaped)
+                detachChild(child, pending);
+            delete unshaped;
+        }
+        for (auto& child : shaped->values)
+            detachChild(child, pending);
+    }
+}
+
+void JObject::detachChild(JObject& child, std::vector<std::shared_ptr<Storage>>& pending)
 {
-    *m_value = std::move(data);
+    if (child.m_value && child.m_value.use_count() == 1 &&
+        (child.m_type == JValueType::JList || child.m_type == JValueType::JDict))
+        pending.push_back(std::move(child.m_value));
 }
 
-JObject::~JObject() = default;
+size_t JObject::shedChildren(Storage& storage, size_t count, std::vector<std::shared_ptr<Storage>>& pending)
+{
+    // Elements are removed from the back one at a time, each at the same cost
+    // whatever the size of the container, with their lists and dicts detached
+    // as in detachChildren(). The caches built for const access go first.
+    size_t shed = 0;
+    auto shedList = [&](list_t& list)
+        {
+            for (; shed < count && !list.empty(); shed++)
+            {
+                detachChild(list.back(), pending);
+                list.pop_back();
+            }
+        };
+    auto shedDict = [&](dict_t& dict)
+        {
+            for (; shed < count && !dict.empty(); shed++)
+            {
+                detachChild(dict.begin()->second, pending);
+                dict.erase(dict.begin());
+            }
+        };
+    if (list_t* list = std::get_if<list_t>(&storage.value))
+        shedList(*list);
+    else if (dict_t* dict = std::get_if<dict_t>(&storage.value))
+        shedDict(*dict);
+    else if (shaped_t* shaped = std::get_if<shaped_t>(&storage.value))
+    {
+        if (dict_t* unshaped = shaped->unshaped.load(std::memory_order_acquire))
+            shedDict(*unshaped);
+        shedList(shaped->values);
+    }
+    else if (packed_t* packed = std::get_if<packed_t>(&storage.value))
+    {
+        if (list_t* unpacked = packed->unpacked.load(std::memory_order_acquire))
+            shedList(*unpacked);
+        if (packed_t::Elements* elements = packed->elements.load(std::memory_order_acquire))
+        {
+            for (; shed < count && elements->size > 0; shed++)
+                delete elements->slots[--elements->size].load(std::memory_order_relaxed);
+        }
+    }
+    return shed;
+}
 
 JObject& JObject::operator=(const JObject& jo)
 {
     if (this == &jo)
         return *this;
 
-    m_type = jo.m_type;
-    switch (jo.m_type)
-    {
-    case JValueType::JString:
-        *m_value = *std::get_if<string_t>(jo.m_value.get());
-        break;
-    case JValueType::JList:
-        *m_value = *std::get_if<list_t>(jo.m_value.get());
-        break;
-    case JValueType::JDict:
-        *m_value = *std::get_if<dict_t>(jo.m_value.get());
-        break;
-    default:
-        *m_value = *jo.m_value;
-        break;
-    }
+    // Copy first: jo may live inside the value being replaced.
+    JObject local(jo);
+    m_type = local.m_type;
+    m_value = std::move(local.m_value);
     return *this;
 }
 
@@ -202,74 +641,152 @@ JObject& JObject::operator=(JObject&& jo) noexcept
     if (this == &jo)
         return *this;
 
-    m_type = jo.m_type;
+    // jo may live inside the value being replaced, so it must not be touched
+    // after m_value has been reassigned.
+    JValueType type = jo.m_type;
+    jo.m_type = JValueType::JNull;
     m_value = std::move(jo.m_value);
+    m_type = type;
     return *this;
 }
 
 bool operator==(const JObject& joa, const JObject& jo)
 {
-    if (joa.m_type != jo.m_type)
-        return false;
-    switch (jo.m_type)
-    {
-    case JValueType::JNull:
-        return true;
-    case JValueType::JInt:
-        if (joa.getInt() == jo.getInt())
-            return true;
-        return false;
-    case JValueType::JDouble:
-        if (joa.getDouble() == jo.getDouble())
-            return true;
-        return false;
-    case JValueType::JBool:
-        if (joa.getBool() == jo.getBool())
-            return true;
-        return false;
-    case JValueType::JString:
-        if (joa.getString() == jo.getString())
-            return true;
-        return false;
-    case JValueType::JList:
+    // Nested values are compared through an explicit stack instead of recursion.
+    std::vector<std::pair<const JObject*, const JObject*>> pending;
+    pending.emplace_back(&joa, &jo);
+    while (!pending.empty())
     {
-        const list_t& local = joa.getList();
-        const list_t& jolist = jo.getList();
-        if (local.empty() ^ jolist.empty())
-            return false;
-        if (local.size() != jolist.size())
+        auto [left, right] = pending.back();
+        pending.pop_back();
+
+        if (left->m_type != right->m_type)
             return false;
-        for (size_t i = 0; i < local.size(); i++)
+        if (left->m_value == right->m_value)
+            continue;
+        if (left->m_value && right->m_value)
         {
-            if (!(local[i] == jolist[i]))
-            {
+            size_t leftHash = left->m_value->hash.load(std::memory_order_relaxed);
+            size_t rightHash = right->m_value->hash.load(std::memory_order_relaxed);
+            if (leftHash != 0 && rightHash != 0 && leftHash != rightHash)
                 return false;
-            }
         }
-        return true;
-    }
-    case JValueType::JDict:
-    {
-        const dict_t& local = joa.getDict();
-        const dict_t& joDict = jo.getDict();
-        if (local.empty() && joDict.empty())
-            return true;
-        if (local.empty() != joDict.empty())
-            return false;
-        if (local.size() != joDict.size())
-            return false;
-        for (auto i = local.begin(); i != local.end(); i++)
+        switch (left->m_type)
         {
-            if (joDict.find(i->first) == joDict.end())
+        case JValueType::JNull:
+            break;
+        case JValueType::JInt:
+            if (left->getInt() != right->getInt())
                 return false;
-            else if (!(i->second == joDict.find(i->first)->second))
+            break;
+        case JValueType::JDouble:
+            if (left->getDouble() != right->getDouble())
                 return false;
-        }
-        return true;
-    }
-    default:
-        return false;
+            break;
+        case JValueType::JBool:
+            if (left->getBool() != right->getBool())
+                return false;
+            break;
+        case JValueType::JString:
+            if (left->getString() != right->getString())
+                return false;
+            break;
+        case JValueType::JList:
+        {
+            const packed_t* leftPacked = std::get_if<packed_t>(&left->m_value->value);
+            const packed_t* rightPacked = std::get_if<packed_t>(&right->m_value->value);
+            if (leftPacked != nullptr && rightPacked != nullptr)
+            {
+                // Empty packed lists of different kinds are still equal.
+                if (leftPacked->numbers != rightPacked->numbers &&
+                    (leftPacked->numbers.index() == rightPacked->numbers.index() ||
+                     packedCount(*leftPacked) != 0 || packedCount(*rightPacked) != 0))
+                    return false;
+                break;
+            }
+            if (leftPacked != nullptr || rightPacked != nullptr)
+            {
+                // The numbers are compared with the JObjects in place.
+                const packed_t& packed = leftPacked != nullptr ? *leftPacked : *rightPacked;
+                const list_t& list = *std::get_if<list_t>(&(leftPacked != nullptr ? right : left)->m_value->value);
+                bool equal = std::visit([&list](const auto& numbers)
+                    {
+                        if (numbers.size() != list.size())
+                            return false;
+                        for (size_t i = 0; i < numbers.size(); i++)
+                        {
+                            if constexpr (std::is_same_v<std::decay_t<decltype(numbers)>, std::vector<double>>)
+                            {
+                                if (list[i].m_type != JValueType::JDouble ||
+                                    list[i].getDouble() != static_cast<long double>(numbers[i]))
+                                    return false;
+                            }
+                            else if (list[i].m_type != JValueType::JInt || list[i].getInt() != numbers[i])
+                                return false;
+                        }
+                        return true;
+                    }, packed.numbers);
+                if (!equal)
+                    return false;
+                break;
+            }
+            const list_t& local = left->getList();
+            const list_t& jolist = right->getList();
+            if (local.size() != jolist.size())
+                return false;
+            for (size_t i = 0; i < local.size(); i++)
+                pending.emplace_back(&local[i], &jolist[i]);
+            break;
+        }
+        case JValueType::JDict:
+        {
+            const shaped_t* leftShaped = std::get_if<shaped_t>(&left->m_value->value);
+            const shaped_t* rightShaped = std::get_if<shaped_t>(&right->m_value->value);
+            if (leftShaped == nullptr && rightShaped != nullptr)
+            {
+                std::swap(left, right);
+                std::swap(leftShaped, rightShaped);
+            }
+            if (leftShaped != nullptr)
+            {
+                // Dicts of the same shape compare slot by slot, others key by key.
+                const list_t& values = leftShaped->values;
+                if (rightShaped != nullptr && rightShaped->shape == leftShaped->shape)
+                {
+                    for (size_t i = 0; i < values.size(); i++)
+                        pending.emplace_back(&values[i], &rightShaped->values[i]);
+                    break;
+                }
+                size_t size = rightShaped != nullptr ? rightShaped->values.size() : right->getDict().size();
+                if (values.size() != size)
+                    return false;
+                for (size_t i = 0; i < values.size(); i++)
+                {
+                    const JObject* found = JObject::findMember(*right, leftShaped->shape->keys[i]);
+                    if (found == nullptr)
+                        return false;
+                    pending.emplace_back(&values[i], found);
+                }
+                break;
+            }
+            const dict_t& local = left->getDict();
+            const dict_t& joDict = right->getDict();
+            if (local.size() != joDict.size())
+                return false;
+            for (auto i = local.begin(); i != local.end(); i++)
+            {
+                auto found = joDict.find(i->first);
+                if (found == joDict.end())
+                    return false;
+                pending.emplace_back(&i->second, &found->second);
+            }
+            break;
+        }
+        default:
+            return false;
+        }
     }
+    return true;
 }
 
 bool operator==(const JObject& jo, JValueType type)
@@ -285,7 +802,13 @@ const JObject& JObject::operator[](size_t itor) const
         throw std::logic_error("The type isn't JList.");
     if (m_type == JValueType::JNull)
         throw std::logic_error("The type is JNull.");
-    list_t* local = std::get_if<list_t>(m_value.get());
+    if (const packed_t* packed = std::get_if<packed_t>(&m_value->value))
+    {
+        if (itor >= packedCount(*packed))
+            throw std::logic_error("The size is smaller than itor.");
+        return packedElement(*packed, itor);
+    }
+    const list_t* local = std::get_if<list_t>(&m_value->value);
     if (itor >= local->size())
         throw std::logic_error("The size is smaller than itor.");
     return (*local)[itor];
@@ -298,11 +821,9 @@ JObject& JObject::operator[](size_t itor)
     if (m_type == JValueType::JNull)
     {
         m_type = JValueType::JList;
-        *m_value = list_t();
-        std::get_if<list_t>(m_value.get())->resize(itor + 1);
-        return (*std::get_if<list_t>(m_value.get()))[itor];
+        m_value = std::make_shared<Storage>(std::in_place_type<list_t>);
     }
-    list_t* local = std::get_if<list_t>(m_value.get());
+    list_t* local = std::get_if<list_t>(&leakValue());
     if (itor >= local->size())
         local->resize(itor + 1);
     return (*local)[itor];
@@ -320,59 +841,137 @@ JObject& JObject::operator[](int itor)
 
 const JObject& JObject::operator[](const char* str) const
 {
-    if (m_type != JValueType::JNull && m_type != JValueType::JDict)
-        throw std::logic_error("The type isn't JDict.");
-    if (m_type == JValueType::JNull)
-    {
-        throw std::logic_error("The type is JNull.");
-    }
-    return (*std::get_if<dict_t>(m_value.get())).at(str);
+    return memberAt(*this, std::string_view(str));
 }
 
 JObject& JObject::operator[](const char* str)
 {
-    if (m_type != JValueType::JNull && m_type != JValueType::JDict)
-        throw std::logic_error("The type isn't JDict.");
+    return memberAt(*this, std::string_view(str));
+}
+
+const JObject& JObject::operator[](std::string_view str) const
+{
+    return memberAt(*this, str);
+}
+
+JObject& JObject::operator[](std::string_view str)
+{
+    return memberAt(*this, str);
+}
+
+const JObject& JObject::operator[](const JKey& key) const
+{
+    return memberAt(*this, key);
+}
+
+JObject& JObject::operator[](const JKey& key)
+{
+    return memberAt(*this, key);
+}
+
+void JObject::push_back(const JObject& jo)
+{
+    if (m_type != JValueType::JNull && m_type != JValueType::JList)
+        throw std::logic_error("The type isn't JList.");
     if (m_type == JValueType::JNull)
     {
-        m_type = JValueType::JDict;
-        *m_value = dict_t();
-        return (*std::get_if<dict_t>(m_value.get())).at(str);
+        m_type = JValueType::JList;
+        m_value = std::make_shared<Storage>(std::in_place_type<list_t>);
     }
-    return (*std::get_if<dict_t>(m_value.get())).at(str);
+    if (std::holds_alternative<packed_t>(m_value->value) && appendPacked(*std::get_if<packed_t>(&ownValue()), jo))
+        return;
+    std::get_if<list_t>(&mutableValue())->push_back(jo);
 }
 
-void JObject::push_back(const JObject& jo)
+void JObject::push_back(JObject&& jo)
 {
     if (m_type != JValueType::JNull && m_type != JValueType::JList)
         throw std::logic_error("The type isn't JList.");
     if (m_type == JValueType::JNull)
     {
         m_type = JValueType::JList;
-        *m_value = list_t();
-        std::get_if<list_t>(m_value.get())->push_back(jo);
+        m_value = std::make_shared<Storage>(std::in_place_type<list_t>);
     }
-    std::get_if<list_t>(m_value.get())->push_back(jo);
+    if (std::holds_alternative<packed_t>(m_value->value) && appendPacked(*std::get_if<packed_t>(&ownValue()), jo))
+        return;
+    std::get_if<list_t>(&mutableValue())->push_back(std::move(jo));
 }
 
-void JObject::push_back(JObject&& jo)
+JObject JObject::makeList(std::initializer_list<JObject> elements)
+{
+    JObject result(JValueType::JList);
+    std::get_if<list_t>(&result.m_value->value)->assign(elements);
+    return result;
+}
+
+JObject JObject::makeDict(std::initializer_list<std::pair<std::string_view, JObject>> members)
+{
+    JObject result(JValueType::JDict);
+    dict_t& dict = *std::get_if<dict_t>(&result.m_value->value);
+    dict.reserve(members.size());
+    for (const auto& [key, value] : members)
+    {
+        auto member = dict.find(key);
+        if (member == dict.end())
+            dict.emplace(key, value);
+        else
+            member->second = value;
+    }
+    return result;
+}
+
+void JObject::reserve(size_t size)
+{
+    if (m_type == JValueType::JList)
+    {
+        value_t& value = ownValue();
+        if (packed_t* packed = std::get_if<packed_t>(&value))
+            std::visit([size](auto& numbers) { numbers.reserve(size); }, packed->numbers);
+        else
+            std::get_if<list_t>(&value)->reserve(size);
+    }
+    else if (m_type == JValueType::JDict)
+        std::get_if<dict_t>(&mutableValue())->reserve(size);
+    else
+        throw std::logic_error("The type isn't JList or JDict.");
+}
+
+list_t& JObject::buildList()
 {
     if (m_type != JValueType::JNull && m_type != JValueType::JList)
         throw std::logic_error("The type isn't JList.");
     if (m_type == JValueType::JNull)
     {
         m_type = JValueType::JList;
-        *m_value = list_t();
-        std::get_if<list_t>(m_value.get())->push_back(std::move(jo));
+        m_value = std::make_shared<Storage>(std::in_place_type<list_t>);
+    }
+    return *std::get_if<list_t>(&leakValue());
+}
+
+dict_t& JObject::buildDict()
+{
+    if (m_type != JValueType::JNull && m_type != JValueType::JDict)
+        throw std::logic_error("The type isn't JDict.");
+    if (m_type == JValueType::JNull)
+    {
+        m_type = JValueType::JDict;
+        m_value = std::make_shared<Storage>(std::in_place_type<dict_t>);
     }
-    std::get_if<list_t>(m_value.get())->push_back(std::move(jo));
+    return *std::get_if<dict_t>(&leakValue());
 }
 
 void JObject::pop_back()
 {
     if (m_type == JValueType::JList)
     {
-        list_t* local = std::get_if<list_t>(m_value.get());
+        if (std::holds_alternative<packed_t>(m_value->value))
+        {
+            if (packedCount(*std::get_if<packed_t>(&m_value->value)) == 0)
+                throw std::logic_error("The JList is empty.");
+            std::visit([](auto& numbers) { numbers.pop_back(); }, std::get_if<packed_t>(&ownValue())->numbers);
+            return;
+        }
+        list_t* local = std::get_if<list_t>(&mutableValue());
         if (local->empty())
             throw std::logic_error("The JList is empty.");
         local->pop_back();
@@ -381,14 +980,18 @@ void JObject::pop_back()
     throw std::logic_error("The type isn't JList.");
 }
 
-bool JObject::hasMember(const std::string& str) const
+bool JObject::hasMember(std::string_view str) const
 {
     if (m_type != JValueType::JDict)
         throw std::logic_error("The type isn't JDict.");
-    const dict_t* local = std::get_if<dict_t>(m_value.get());
-    if (local->find(str) != local->cend())
-        return true;
-    return false;
+    return findMember(*this, str) != nullptr;
+}
+
+bool JObject::hasMember(const JKey& key) const
+{
+    if (m_type != JValueType::JDict)
+        throw std::logic_error("The type isn't JDict.");
+    return findMember(*this, key) != nullptr;
 }
 
 JValueType JObject::getType() const
@@ -400,336 +1003,1876 @@ const list_t& JObject::getList() const
 {
     if (m_type != JValueType::JList)
         throw std::logic_error("The type isn't JList.");
-    return *std::get_if<list_t>(m_value.get());
+    const packed_t* packed = std::get_if<packed_t>(&m_value->value);
+    if (packed == nullptr)
+        return *std::get_if<list_t>(&m_value->value);
+
+    // A packed list builds its JObjects on the first request; concurrent
+    // readers race to publish their copy and the losers discard theirs.
+    list_t* list = packed->unpacked.load(std::memory_order_acquire);
+    if (list != nullptr)
+        return *list;
+    auto built = std::make_unique<list_t>();
+    std::visit([&built](const auto& numbers)
+        {
+            built->reserve(numbers.size());
+            for (auto number : numbers)
+                built->emplace_back(number);
+        }, packed->numbers);
+    if (packed->unpacked.compare_exchange_strong(list, built.get(), std::memory_order_acq_rel))
+        return *built.release();
+    return *list;
 }
 
 list_t& JObject::getList()
 {
     if (m_type != JValueType::JList)
         throw std::logic_error("The type isn't JList.");
-    return *std::get_if<list_t>(m_value.get());
+    return *std::get_if<list_t>(&leakValue());
 }
 
 const dict_t& JObject::getDict() const
 {
     if (m_type != JValueType::JDict)
         throw std::logic_error("The type isn't JDict.");
-    return *std::get_if<dict_t>(m_value.get());
+    const shaped_t* shaped = std::get_if<shaped_t>(&m_value->value);
+    if (shaped == nullptr)
+        return *std::get_if<dict_t>(&m_value->value);
+
+    // Built and published like the JObjects of a packed list.
+    dict_t* dict = shaped->unshaped.load(std::memory_order_acquire);
+    if (dict != nullptr)
+        return *dict;
+    auto built = std::make_unique<dict_t>();
+    built->reserve(shaped->values.size());
+    for (size_t i = 0; i < shaped->values.size(); i++)
+        built->emplace(shaped->shape->keys[i], shaped->values[i]);
+    if (shaped->unshaped.compare_exchange_strong(dict, built.get(), std::memory_order_acq_rel))
+        return *built.release();
+    return *dict;
 }
 
 dict_t& JObject::getDict()
 {
     if (m_type != JValueType::JDict)
         throw std::logic_error("The type isn't JDict.");
-    return *std::get_if<dict_t>(m_value.get());
+    return *std::get_if<dict_t>(&leakValue());
 }
 
 const long long& JObject::getInt() const
 {
     if (m_type != JValueType::JInt)
         throw std::logic_error("This JObject isn't int");
-    return *std::get_if<int_t>(m_value.get());
+    if (const lexeme_t* lexeme = std::get_if<lexeme_t>(&m_value->value))
+    {
+        decode(*lexeme, true);
+        return lexeme->decoded.integer;
+    }
+    return *std::get_if<int_t>(&m_value->value);
 }
 
 long long& JObject::getInt()
 {
     if (m_type != JValueType::JInt)
         throw std::logic_error("This JObject isn't int");
-    return *std::get_if<int_t>(m_value.get());
+    return *std::get_if<int_t>(&leakValue());
 }
 
 const long double& JObject::getDouble() const
 {
     if (m_type != JValueType::JDouble)
         throw std::logic_error("This JObject isn't double");
-    return *std::get_if<double_t>(m_value.get());
+    if (const lexeme_t* lexeme = std::get_if<lexeme_t>(&m_value->value))
+    {
+        decode(*lexeme, false);
+        return lexeme->decoded.real;
+    }
+    return *std::get_if<double_t>(&m_value->value);
 }
 
 long double& JObject::getDouble()
 {
     if (m_type != JValueType::JDouble)
         throw std::logic_error("This JObject isn't double");
-    return *std::get_if<double_t>(m_value.get());
+    return *std::get_if<double_t>(&leakValue());
+}
+
+std::uint64_t JObject::getUInt() const
+{
+    if (m_type == JValueType::JInt || m_type == JValueType::JDouble)
+    {
+        if (const lexeme_t* lexeme = std::get_if<lexeme_t>(&m_value->value))
+        {
+            std::uint64_t value;
+            const char* end = lexeme->text.data() + lexeme->text.size();
+            auto [ptr, ec] = std::from_chars(lexeme->text.data(), end, value);
+            if (ec == std::errc() && ptr == end)
+                return value;
+        }
+        else if (m_type == JValueType::JInt && getInt() >= 0)
+            return static_cast<std::uint64_t>(getInt());
+    }
+    throw std::logic_error("This JObject isn't an unsigned 64-bit int");
 }
 
 const bool& JObject::getBool() const
 {
     if (m_type != JValueType::JBool)
         throw std::logic_error("This JObject isn't bool");
-    return *std::get_if<bool_t>(m_value.get());
+    return *std::get_if<bool_t>(&m_value->value);
 }
 
 bool& JObject::getBool()
 {
     if (m_type != JValueType::JBool)
         throw std::logic_error("This JObject isn't bool");
-    return *std::get_if<bool_t>(m_value.get());
+    return *std::get_if<bool_t>(&leakValue());
 }
 
 const std::string& JObject::getString() const
 {
     if (m_type != JValueType::JString)
         throw std::logic_error("This JObject isn't string");
-    return *std::get_if<string_t>(m_value.get());
+    return *std::get_if<string_t>(&m_value->value);
 }
 
 std::string& JObject::getString()
 {
     if (m_type != JValueType::JString)
         throw std::logic_error("This JObject isn't string");
-    return *std::get_if<string_t>(m_value.get());
+    return *std::get_if<string_t>(&leakValue());
 }
 
-JObject JParser::parse(std::string_view data)
+std::optional<long long> JObject::tryGetInt() const
 {
-    size_t itor = 0;
-    return std::move(_parse(data, itor));
+    if (m_type != JValueType::JInt)
+        return std::nullopt;
+    return getInt();
 }
 
-JObject JParser::fastParse(std::ifstream& infile)
+std::optional<long double> JObject::tryGetDouble() const
 {
-    infile.seekg(0, std::ios_base::end);
-    size_t size = infile.tellg();
-    infile.seekg(0, std::ios_base::beg);
-    std::string buffer;
-    buffer.resize(size);
-    infile.read(buffer.data(), size);
-    infile.close();
+    if (m_type != JValueType::JDouble)
+        return std::nullopt;
+    return getDouble();
+}
 
-    return std::move(JParser::fastParse(buffer));
+std::optional<bool> JObject::tryGetBool() const
+{
+    if (m_type != JValueType::JBool)
+        return std::nullopt;
+    return *std::get_if<bool_t>(&m_value->value);
 }
 
-JObject JParser::fastParse(const std::string_view data)
+const std::string* JObject::tryGetString() const
 {
-    static JParser jp;
-    size_t itor = 0;
-    return std::move(jp._parse(data, itor));
+    if (m_type != JValueType::JString)
+        return nullptr;
+    return std::get_if<string_t>(&m_value->value);
 }
 
-JObject JParser::_parse(std::string_view data, size_t& itor)
+const JObject* JObject::find(std::string_view key) const
 {
-    long long error_line = 0;
+    if (m_type != JValueType::JDict)
+        return nullptr;
+    return findMember(*this, key);
+}
 
-    if (data.empty())
-        throw std::logic_error(getLogicErrorString(error_line));
-    skipSpace(data, itor, error_line);
-    if (data.size() <= itor)
-        throw std::logic_error(getLogicErrorString(error_line));
+const JObject* JObject::find(const JKey& key) const
+{
+    if (m_type != JValueType::JDict)
+        return nullptr;
+    return findMember(*this, key);
+}
+
+const JObject* JObject::find(size_t index) const
+{
+    if (m_type != JValueType::JList)
+        return nullptr;
+    if (const packed_t* packed = std::get_if<packed_t>(&m_value->value))
+        return index < packedCount(*packed) ? &packedElement(*packed, index) : nullptr;
+    const list_t& list = *std::get_if<list_t>(&m_value->value);
+    return index < list.size() ? &list[index] : nullptr;
+}
 
-    if (data[itor] == '{')
+size_t JObject::hash() const
+{
+    // Containers are hashed bottom-up through an explicit stack. Every
+    // shareable value caches its hash; values that have handed out mutable
+    // references may change behind our back and are hashed afresh.
+    size_t result = 0;
+    if (lookupHash(*this, result))
+        return result;
+
+    struct Frame
     {
-        JObject localJO(JValueType::JDict);
-        itor++;
-        while (itor < data.size() && data[itor] != '}')
-        {
-            skipSpace(data, itor, error_line);
-            if (data[itor] == '}')
-                return localJO;
-            std::string key(getString(data, itor, error_line));
-            skipSpace(data, itor, error_line);
-            if (data[itor] == ':')
-                itor++;
+        const JObject* node;
+        size_t index;
+        dict_t::const_iterator member;
+        size_t acc;
+    };
+
+    std::vector<Frame> stack;
+    auto open = [&stack](const JObject& node)
+        {
+            Frame frame{ &node, 0, {}, 0 };
+            if (node.m_type == JValueType::JDict && std::holds_alternative<dict_t>(node.m_value->value))
+                frame.member = std::get_if<dict_t>(&node.m_value->value)->begin();
+            stack.push_back(frame);
+        };
+    open(*this);
+
+    while (true)
+    {
+        Frame& frame = stack.back();
+        const JObject* child = nullptr;
+        if (const packed_t* packed = std::get_if<packed_t>(&frame.node->m_value->value))
+        {
+            // Hashed like a list of JObjects holding the same numbers.
+            std::visit([&frame](const auto& numbers)
+                {
+                    for (auto number : numbers)
+                    {
+                        if constexpr (std::is_same_v<decltype(number), double>)
+                            frame.acc = mixHash(frame.acc * 31 + hashDouble(number));
+                        else
+                            frame.acc = mixHash(frame.acc * 31 + hashInt(number));
+                    }
+                }, packed->numbers);
+            result = mixHash(frame.acc ^ (packedCount(*packed) + 0x6c697374));
+        }
+        else if (frame.node->m_type == JValueType::JList)
+        {
+            const list_t& list = *std::get_if<list_t>(&frame.node->m_value->value);
+            while (frame.index < list.size() && lookupHash(list[frame.index], result))
+            {
+                frame.acc = mixHash(frame.acc * 31 + result);
+                frame.index++;
+            }
+            if (frame.index < list.size())
+                child = &list[frame.index];
             else
-                throw std::logic_error(getLogicErrorString(error_line));
-            skipSpace(data, itor, error_line);
-            localJO[key.c_str()] = _parse(data, itor);
-            skipSpace(data, itor, error_line);
-            if (data[itor] != ',' && data[itor] != '}')
-                throw std::logic_error(getLogicErrorString(error_line));
-            else if (data[itor] == '}')
+                result = mixHash(frame.acc ^ (list.size() + 0x6c697374));
+        }
+        else if (const shaped_t* shaped = std::get_if<shaped_t>(&frame.node->m_value->value))
+        {
+            const list_t& values = shaped->values;
+            while (frame.index < values.size() && lookupHash(values[frame.index], result))
             {
-                itor++;
-                return localJO;
+                frame.acc += mixHash(std::hash<std::string_view>{}(shaped->shape->keys[frame.index]) ^ mixHash(result));
+                frame.index++;
             }
-            itor++;
-            skipSpace(data, itor, error_line);
+            if (frame.index < values.size())
+                child = &values[frame.index];
+            else
+                result = mixHash(frame.acc ^ (values.size() + 0x64696374));
         }
-        if (data[itor] == '}')
-            return localJO;
         else
-            throw std::logic_error(getLogicErrorString(error_line));
-    }
-    else if (data[itor] == '[')
-    {
-        JObject localJO(JValueType::JList);
-        itor++;
-        while (itor < data.size() && data[itor] != ']')
         {
-            skipSpace(data, itor, error_line);
-            if (data[itor] == ']')
-                return localJO;
-            localJO.push_back(_parse(data, itor));
-            skipSpace(data, itor, error_line);
-            if (data[itor] != ',' && data[itor] != ']')
-                throw std::logic_error(getLogicErrorString(error_line));
-            else if (data[itor] == ']')
+            const dict_t& dict = *std::get_if<dict_t>(&frame.node->m_value->value);
+            while (frame.member != dict.end() && lookupHash(frame.member->second, result))
             {
-                itor++;
-                return localJO;
+                // Members are summed, so the hash doesn't depend on their order.
+                frame.acc += mixHash(std::hash<std::string_view>{}(frame.member->first) ^ mixHash(result));
+                ++frame.member;
             }
-            itor++;
-            skipSpace(data, itor, error_line);
+            if (frame.member != dict.end())
+                child = &frame.member->second;
+            else
+                result = mixHash(frame.acc ^ (dict.size() + 0x64696374));
+        }
+
+        if (child != nullptr)
+        {
+            open(*child);
+            continue;
+        }
+
+        if (result == 0)
+            result = 1;
+        if (frame.node->m_value->shareable)
+            frame.node->m_value->hash.store(result, std::memory_order_relaxed);
+        stack.pop_back();
+        if (stack.empty())
+            return result;
+
+        Frame& parent = stack.back();
+        if (parent.node->m_type == JValueType::JList)
+        {
+            parent.acc = mixHash(parent.acc * 31 + result);
+            parent.index++;
+        }
+        else if (const shaped_t* shaped = std::get_if<shaped_t>(&parent.node->m_value->value))
+        {
+            parent.acc += mixHash(std::hash<std::string_view>{}(shaped->shape->keys[parent.index]) ^ mixHash(result));
+            parent.index++;
+        }
+        else
+        {
+            parent.acc += mixHash(std::hash<std::string_view>{}(parent.member->first) ^ mixHash(result));
+            ++parent.member;
+        }
+    }
+}
+
+size_t JObject::mixHash(size_t value)
+{
+    std::uint64_t x = value;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return static_cast<size_t>(x);
+}
+
+bool JObject::lookupHash(const JObject& jo, size_t& result)
+{
+    switch (jo.m_type)
+    {
+    case JValueType::JNull:
+        result = 0x6e756c6c;
+        return true;
+    case JValueType::JList:
+    case JValueType::JDict:
+        result = jo.m_value->hash.load(std::memory_order_relaxed);
+        return result != 0;
+    default:
+        break;
+    }
+
+    result = jo.m_value->hash.load(std::memory_order_relaxed);
+    if (result != 0)
+        return true;
+    switch (jo.m_type)
+    {
+    case JValueType::JInt:
+        result = hashInt(jo.getInt());
+        break;
+    case JValueType::JDouble:
+        result = hashDouble(jo.getDouble());
+        break;
+    case JValueType::JBool:
+        result = mixHash(jo.getBool() + 3);
+        break;
+    default:
+        result = mixHash(std::hash<std::string_view>{}(jo.getString()) + 4);
+        break;
+    }
+    if (result == 0)
+        result = 1;
+    if (jo.m_value->shareable)
+        jo.m_value->hash.store(result, std::memory_order_relaxed);
+    return true;
+}
+
+size_t JObject::hashInt(long long value)
+{
+    size_t result = mixHash(std::hash<long long>{}(value) + 1);
+    return result == 0 ? 1 : result;
+}
+
+size_t JObject::hashDouble(long double value)
+{
+    // 0.0 and -0.0 compare equal, so they must hash equal.
+    size_t result = mixHash(std::hash<long double>{}(value == 0 ? 0 : value) + 2);
+    return result == 0 ? 1 : result;
+}
+
+bool JObject::isPacked() const
+{
+    return m_type == JValueType::JList && std::holds_alternative<packed_t>(m_value->value);
+}
+
+std::span<const std::int64_t> JObject::getInts() const
+{
+    const packed_t* packed = m_type == JValueType::JList ? std::get_if<packed_t>(&m_value->value) : nullptr;
+    if (packed == nullptr || packed->numbers.index() != 0)
+        throw std::logic_error("The list isn't packed ints.");
+    return *std::get_if<0>(&packed->numbers);
+}
+
+std::span<const double> JObject::getDoubles() const
+{
+    const packed_t* packed = m_type == JValueType::JList ? std::get_if<packed_t>(&m_value->value) : nullptr;
+    if (packed == nullptr || packed->numbers.index() != 1)
+        throw std::logic_error("The list isn't packed doubles.");
+    return *std::get_if<1>(&packed->numbers);
+}
+
+std::string_view JObject::getLexeme() const
+{
+    if (m_type != JValueType::JInt && m_type != JValueType::JDouble)
+        return {};
+    const lexeme_t* lexeme = std::get_if<lexeme_t>(&m_value->value);
+    return lexeme != nullptr ? std::string_view(lexeme->text) : std::string_view();
+}
+
+void JObject::decode(const lexeme_t& lexeme, bool integer)
+{
+    // The first reader decodes; concurrent readers wait for it.
+    unsigned char state = lexeme.state.load(std::memory_order_acquire);
+    if (state == 2)
+        return;
+    state = 0;
+    if (!lexeme.state.compare_exchange_strong(state, 1, std::memory_order_acquire))
+    {
+        while (lexeme.state.load(std::memory_order_acquire) != 2)
+            std::this_thread::yield();
+        return;
+    }
+
+    const char* first = lexeme.text.data();
+    const char* last = first + lexeme.text.size();
+    if (integer)
+        std::from_chars(first, last, lexeme.decoded.integer);
+    else
+    {
+        lexeme.decoded.real = 0;
+        if (std::from_chars(first, last, lexeme.decoded.real).ec == std::errc::result_out_of_range)
+        {
+            // Too small rounds to zero and too large to infinity.
+            bool tiny = lexeme.text.find("e-") != std::string::npos || lexeme.text.find("E-") != std::string::npos ||
+                lexeme.text.starts_with("0") || lexeme.text.starts_with("-0");
+            long double magnitude = tiny ? 0.0L : std::numeric_limits<long double>::infinity();
+            lexeme.decoded.real = lexeme.text.starts_with("-") ? -magnitude : magnitude;
+        }
+    }
+    lexeme.state.store(2, std::memory_order_release);
+}
+
+bool JObject::isShaped() const
+{
+    return m_type == JValueType::JDict && std::holds_alternative<shaped_t>(m_value->value);
+}
+
+template<typename Key>
+const JObject* JObject::findMember(const JObject& jo, const Key& key)
+{
+    if (const shaped_t* shaped = std::get_if<shaped_t>(&jo.m_value->value))
+    {
+        auto slot = shaped->shape->slots.find(key);
+        return slot == shaped->shape->slots.end() ? nullptr : &shaped->values[slot->second];
+    }
+    const dict_t& dict = *std::get_if<dict_t>(&jo.m_value->value);
+    auto member = dict.find(key);
+    return member == dict.end() ? nullptr : &member->second;
+}
+
+template<typename Key>
+const JObject& JObject::memberAt(const JObject& jo, const Key& key)
+{
+    if (jo.m_type != JValueType::JNull && jo.m_type != JValueType::JDict)
+        throw std::logic_error("The type isn't JDict.");
+    if (jo.m_type == JValueType::JNull)
+        throw std::logic_error("The type is JNull.");
+    const JObject* member = findMember(jo, key);
+    if (member == nullptr)
+        throw std::out_of_range("The key doesn't exist.");
+    return *member;
+}
+
+template<typename Key>
+JObject& JObject::memberAt(JObject& jo, const Key& key)
+{
+    dict_t& dict = jo.buildDict();
+    auto member = dict.find(key);
+    if (member == dict.end())
+    {
+        if constexpr (std::is_same_v<Key, JKey>)
+            member = dict.emplace(key.str(), JObject()).first;
+        else
+            member = dict.emplace(key, JObject()).first;
+    }
+    return member->second;
+}
+
+JObject::SourceText::Shift::~Shift()
+{
+    // Unlinks the history one edit at a time, so a long one doesn't recurse.
+    std::shared_ptr<const Shift> next = std::move(previous);
+    while (next && next.use_count() == 1)
+        next = std::move(const_cast<Shift&>(*next).previous);
+}
+
+std::string_view JObject::getSource() const
+{
+    if (!m_value || !m_value->source)
+        return {};
+    // The containers around a reparsed edit span more than their text keeps.
+    const Source& source = *m_value->source;
+    const SourceText& text = *source.text;
+    if (source.begin < text.offset || source.end > text.offset + text.text.size())
+        return {};
+    return std::string_view(text.text).substr(source.begin - text.offset, source.end - source.begin);
+}
+
+value_t& JObject::ownValue()
+{
+    if (m_value.use_count() > 1)
+    {
+        JObject local;
+        copyValue(local, *this, true);
+        m_value = std::move(local.m_value);
+    }
+    else
+    {
+        m_value->hash.store(0, std::memory_order_relaxed);
+        m_value->source.reset();
+        if (packed_t* packed = std::get_if<packed_t>(&m_value->value))
+            packed->release();
+        else if (shaped_t* shaped = std::get_if<shaped_t>(&m_value->value))
+            delete shaped->unshaped.exchange(nullptr, std::memory_order_relaxed);
+    }
+    return m_value->value;
+}
+
+value_t& JObject::mutableValue()
+{
+    value_t& value = ownValue();
+    unpack(value);
+    unshape(value);
+    if (const lexeme_t* lexeme = std::get_if<lexeme_t>(&value))
+    {
+        if (m_type == JValueType::JInt)
+        {
+            decode(*lexeme, true);
+            value.emplace<int_t>(lexeme->decoded.integer);
+        }
+        else
+        {
+            decode(*lexeme, false);
+            value.emplace<double_t>(lexeme->decoded.real);
+        }
+    }
+    return value;
+}
+
+void JObject::unpack(value_t& value)
+{
+    packed_t* packed = std::get_if<packed_t>(&value);
+    if (packed == nullptr)
+        return;
+    list_t list;
+    std::visit([&list](const auto& numbers)
+        {
+            list.reserve(numbers.size());
+            for (auto number : numbers)
+                list.emplace_back(number);
+        }, packed->numbers);
+    value = std::move(list);
+}
+
+void JObject::unshape(value_t& value)
+{
+    shaped_t* shaped = std::get_if<shaped_t>(&value);
+    if (shaped == nullptr)
+        return;
+    dict_t dict;
+    dict.reserve(shaped->values.size());
+    for (size_t i = 0; i < shaped->values.size(); i++)
+        dict.emplace(shaped->shape->keys[i], std::move(shaped->values[i]));
+    value = std::move(dict);
+}
+
+bool JObject::appendPacked(packed_t& packed, const JObject& jo)
+{
+    // Only values the packed list holds exactly stay packed; an empty list
+    // takes the kind of its first element.
+    bool empty = packedCount(packed) == 0;
+    if (jo.m_type == JValueType::JInt && (empty || packed.numbers.index() == 0))
+    {
+        if (packed.numbers.index() != 0)
+            packed.numbers = std::vector<std::int64_t>();
+        std::get_if<0>(&packed.numbers)->push_back(jo.getInt());
+        return true;
+    }
+    if (jo.m_type != JValueType::JDouble || !(empty || packed.numbers.index() == 1))
+        return false;
+    long double value = jo.getDouble();
+    if (static_cast<long double>(static_cast<double>(value)) != value)
+        return false;
+    if (packed.numbers.index() != 1)
+        packed.numbers = std::vector<double>();
+    std::get_if<1>(&packed.numbers)->push_back(static_cast<double>(value));
+    return true;
+}
+
+size_t JObject::listSize(const JObject& jo)
+{
+    if (const packed_t* packed = std::get_if<packed_t>(&jo.m_value->value))
+        return packedCount(*packed);
+    return std::get_if<list_t>(&jo.m_value->value)->size();
+}
+
+JObject JObject::packedValue(const packed_t& packed, size_t index)
+{
+    return std::visit([index](const auto& numbers) { return JObject(numbers[index]); }, packed.numbers);
+}
+
+const JObject& JObject::packedElement(const packed_t& packed, size_t index)
+{
+    if (const list_t* list = packed.unpacked.load(std::memory_order_acquire))
+        return (*list)[index];
+
+    // The slots and the elements are published like the JObjects of getList()
+    // const: concurrent readers race and the losers discard theirs.
+    packed_t::Elements* elements = packed.elements.load(std::memory_order_acquire);
+    if (elements == nullptr)
+    {
+        auto built = std::make_unique<packed_t::Elements>(packedCount(packed));
+        if (packed.elements.compare_exchange_strong(elements, built.get(), std::memory_order_acq_rel))
+            elements = built.release();
+    }
+    std::atomic<JObject*>& slot = elements->slots[index];
+    JObject* element = slot.load(std::memory_order_acquire);
+    if (element != nullptr)
+        return *element;
+    auto built = std::make_unique<JObject>(packedValue(packed, index));
+    if (slot.compare_exchange_strong(element, built.get(), std::memory_order_acq_rel))
+        return *built.release();
+    return *element;
+}
+
+value_t& JObject::leakValue()
+{
+    value_t& value = mutableValue();
+    m_value->shareable = false;
+    return value;
+}
+
+void JObject::copyValue(JObject& to, const JObject& from, bool clone)
+{
+    // Shareable values are shared. Values that have handed out mutable
+    // references are cloned one level at a time through an explicit stack
+    // instead of recursion, sharing whatever can be shared below them.
+    std::vector<std::pair<JObject*, const JObject*>> pending;
+    pending.emplace_back(&to, &from);
+    while (!pending.empty())
+    {
+        auto [target, source] = pending.back();
+        pending.pop_back();
+
+        target->m_type = source->m_type;
+        if (!source->m_value || (!clone && source->m_value->shareable))
+        {
+            target->m_value = source->m_value;
+            continue;
+        }
+        clone = false;
+
+        switch (source->m_type)
+        {
+        case JValueType::JList:
+        {
+            if (std::holds_alternative<packed_t>(source->m_value->value))
+            {
+                target->m_value = std::make_shared<Storage>(source->m_value->value);
+                break;
+            }
+            const list_t& sourceList = *std::get_if<list_t>(&source->m_value->value);
+            target->m_value = std::make_shared<Storage>(std::in_place_type<list_t>, sourceList.size());
+            list_t& targetList = *std::get_if<list_t>(&target->m_value->value);
+            for (size_t i = 0; i < sourceList.size(); i++)
+                pending.emplace_back(&targetList[i], &sourceList[i]);
+            break;
+        }
+        case JValueType::JDict:
+        {
+            if (const shaped_t* sourceShaped = std::get_if<shaped_t>(&source->m_value->value))
+            {
+                target->m_value = std::make_shared<Storage>(std::in_place_type<shaped_t>,
+                    sourceShaped->shape, sourceShaped->values.size());
+                list_t& targetValues = std::get_if<shaped_t>(&target->m_value->value)->values;
+                for (size_t i = 0; i < targetValues.size(); i++)
+                    pending.emplace_back(&targetValues[i], &sourceShaped->values[i]);
+                break;
+            }
+            const dict_t& sourceDict = *std::get_if<dict_t>(&source->m_value->value);
+            target->m_value = std::make_shared<Storage>(std::in_place_type<dict_t>);
+            dict_t& targetDict = *std::get_if<dict_t>(&target->m_value->value);
+            targetDict.reserve(sourceDict.size());
+            for (const auto& [key, value] : sourceDict)
+                pending.emplace_back(&targetDict[key], &value);
+            break;
+        }
+        default:
+            target->m_value = std::make_shared<Storage>(source->m_value->value);
+            break;
+        }
+    }
+}
+
+JMemoryUsage JObject::memoryUsage() const
+{
+    // A shared_ptr control block holds a vtable pointer and two counters.
+    constexpr size_t control = 2 * sizeof(void*);
+    // Hash table nodes hold the next pointer and the cached hash with the member.
+    constexpr size_t link = sizeof(void*) + sizeof(size_t);
+    const size_t inlineCapacity = std::string().capacity();
+    auto stringBytes = [inlineCapacity](const std::string& str)
+        {
+            return str.capacity() > inlineCapacity ? str.capacity() + 1 : 0;
+        };
+
+    JMemoryUsage usage;
+    std::unordered_set<const void*> seen;
+    std::vector<const JObject*> pending{ this };
+    auto visitList = [&pending](const list_t& list)
+        {
+            for (const JObject& element : list)
+                pending.push_back(&element);
+            return list.capacity() * sizeof(JObject);
+        };
+    auto visitDict = [&pending, &usage, &stringBytes](const dict_t& dict)
+        {
+            for (const auto& [key, value] : dict)
+            {
+                usage.strings += stringBytes(key);
+                pending.push_back(&value);
+            }
+            return dict.bucket_count() * sizeof(void*) + dict.size() * (sizeof(dict_t::value_type) + link);
+        };
+
+    while (!pending.empty())
+    {
+        const JObject* jo = pending.back();
+        pending.pop_back();
+        if (!jo->m_value || !seen.insert(jo->m_value.get()).second)
+            continue;
+
+        const Storage& storage = *jo->m_value;
+        usage.nodes += sizeof(Storage) + control;
+        if (storage.source)
+        {
+            usage.sources += sizeof(Source);
+            const SourceText& text = *storage.source->text;
+            if (seen.insert(&text).second)
+            {
+                usage.sources += sizeof(SourceText) + control + stringBytes(text.text);
+                for (const SourceText::Shift* shift = text.history.get(); shift && seen.insert(shift).second;
+                    shift = shift->previous.get())
+                    usage.sources += sizeof(SourceText::Shift) + control;
+            }
+        }
+
+        const value_t& value = storage.value;
+        if (const string_t* str = std::get_if<string_t>(&value))
+            usage.strings += stringBytes(*str);
+        else if (const lexeme_t* lexeme = std::get_if<lexeme_t>(&value))
+            usage.strings += stringBytes(lexeme->text);
+        else if (const list_t* list = std::get_if<list_t>(&value))
+            usage.lists += visitList(*list);
+        else if (const packed_t* packed = std::get_if<packed_t>(&value))
+        {
+            usage.lists += std::visit([](const auto& numbers) { return numbers.capacity() * sizeof(numbers[0]); },
+                packed->numbers);
+            if (const list_t* unpacked = packed->unpacked.load(std::memory_order_acquire))
+                usage.lists += sizeof(list_t) + visitList(*unpacked);
+            if (const packed_t::Elements* elements = packed->elements.load(std::memory_order_acquire))
+            {
+                usage.lists += sizeof(packed_t::Elements) + elements->size * sizeof(std::atomic<JObject*>);
+                for (size_t i = 0; i < elements->size; i++)
+                {
+                    if (const JObject* element = elements->slots[i].load(std::memory_order_acquire))
+                    {
+                        usage.lists += sizeof(JObject);
+                        pending.push_back(element);
+                    }
+                }
+            }
+        }
+        else if (const shaped_t* shaped = std::get_if<shaped_t>(&value))
+        {
+            usage.dicts += visitList(shaped->values);
+            if (const dict_t* unshaped = shaped->unshaped.load(std::memory_order_acquire))
+                usage.dicts += sizeof(dict_t) + visitDict(*unshaped);
+            const shape_t* shape = shaped->shape.get();
+            if (shape != nullptr && seen.insert(shape).second)
+            {
+                usage.shapes += sizeof(shape_t) + control + shape->keys.capacity() * sizeof(std::string) +
+                    shape->slots.bucket_count() * sizeof(void*) +
+                    shape->slots.size() * (sizeof(decltype(shape->slots)::value_type) + link);
+                for (const std::string& key : shape->keys)
+                    usage.shapes += stringBytes(key);
+            }
+        }
+        else if (const dict_t* dict = std::get_if<dict_t>(&value))
+            usage.dicts += visitDict(*dict);
+    }
+    return usage;
+}
+
+void JObject::compact()
+{
+    // The new tree is built top-down through an explicit stack, as in copyValue(),
+    // so that every container is created at its final size before its elements.
+    ArenaAllocator<Storage> allocator(std::make_shared<NodeArena>());
+    std::unordered_map<const Storage*, std::shared_ptr<Storage>> built;
+    std::unordered_map<const shape_t*, std::shared_ptr<const shape_t>> reshaped;
+    std::unordered_map<std::string, std::shared_ptr<const shape_t>> shapes;
+    std::vector<const std::string*> keys;
+    std::string sequence;
+    auto intern = [&]()
+        {
+            sequence.clear();
+            for (const std::string* key : keys)
+            {
+                size_t size = key->size();
+                sequence.append(reinterpret_cast<const char*>(&size), sizeof(size));
+                sequence += *key;
+            }
+            std::shared_ptr<const shape_t>& interned = shapes[sequence];
+            if (!interned)
+            {
+                auto shape = std::allocate_shared<shape_t>(allocator);
+                shape->keys.reserve(keys.size());
+                for (const std::string* key : keys)
+                    shape->keys.push_back(*key);
+                shape->slots.reserve(keys.size());
+                for (size_t i = 0; i < keys.size(); i++)
+                    shape->slots.emplace(shape->keys[i], i);
+                shape->plainKeys = std::none_of(shape->keys.begin(), shape->keys.end(),
+                    [](const std::string& key) { return key.find_first_of("\"\\") != std::string::npos; });
+                interned = std::move(shape);
+            }
+            return interned;
+        };
+
+    JObject root;
+    std::vector<std::pair<JObject*, const JObject*>> pending;
+    pending.emplace_back(&root, this);
+    while (!pending.empty())
+    {
+        auto [target, source] = pending.back();
+        pending.pop_back();
+
+        target->m_type = source->m_type;
+        if (!source->m_value)
+            continue;
+        std::shared_ptr<Storage>& copy = built[source->m_value.get()];
+        if (copy)
+        {
+            target->m_value = copy;
+            continue;
+        }
+
+        const value_t& value = source->m_value->value;
+        if (const list_t* list = std::get_if<list_t>(&value))
+        {
+            // Lexemes aren't packed, so that their text is kept.
+            packed_t packed;
+            bool packable = !list->empty();
+            for (size_t i = 0; i < list->size() && packable; i++)
+            {
+                const JObject& element = (*list)[i];
+                packable = !(element.m_value && std::holds_alternative<lexeme_t>(element.m_value->value)) &&
+                    appendPacked(packed, element);
+            }
+            if (packable)
+            {
+                std::visit([](auto& numbers) { numbers.shrink_to_fit(); }, packed.numbers);
+                copy = std::allocate_shared<Storage>(allocator, std::move(packed));
+            }
+            else
+            {
+                copy = std::allocate_shared<Storage>(allocator, std::in_place_type<list_t>, list->size());
+                list_t& targetList = *std::get_if<list_t>(&copy->value);
+                for (size_t i = 0; i < list->size(); i++)
+                    pending.emplace_back(&targetList[i], &(*list)[i]);
+            }
+        }
+        else if (const shaped_t* shaped = std::get_if<shaped_t>(&value))
+        {
+            std::shared_ptr<const shape_t>& shape = reshaped[shaped->shape.get()];
+            if (!shape)
+            {
+                keys.clear();
+                for (const std::string& key : shaped->shape->keys)
+                    keys.push_back(&key);
+                shape = intern();
+            }
+            copy = std::allocate_shared<Storage>(allocator, std::in_place_type<shaped_t>, shape, shaped->values.size());
+            list_t& targetValues = std::get_if<shaped_t>(&copy->value)->values;
+            for (size_t i = 0; i < targetValues.size(); i++)
+                pending.emplace_back(&targetValues[i], &shaped->values[i]);
+        }
+        else if (const dict_t* dict = std::get_if<dict_t>(&value); dict != nullptr && !dict->empty())
+        {
+            std::vector<const dict_t::value_type*> members;
+            members.reserve(dict->size());
+            for (const auto& member : *dict)
+                members.push_back(&member);
+            std::sort(members.begin(), members.end(),
+                [](const dict_t::value_type* a, const dict_t::value_type* b) { return a->first < b->first; });
+            keys.clear();
+            for (const dict_t::value_type* member : members)
+                keys.push_back(&member->first);
+            copy = std::allocate_shared<Storage>(allocator, std::in_place_type<shaped_t>, intern(), members.size());
+            list_t& targetValues = std::get_if<shaped_t>(&copy->value)->values;
+            for (size_t i = 0; i < members.size(); i++)
+                pending.emplace_back(&targetValues[i], &members[i]->second);
+        }
+        else
+            copy = std::allocate_shared<Storage>(allocator, value);
+
+        copy->hash.store(source->m_value->hash.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        if (source->m_value->source)
+            copy->source = std::make_unique<Source>(*source->m_value->source);
+        target->m_value = copy;
+    }
+    m_value = std::move(root.m_value);
+}
+
+JParser::JParser(const JParserOptions& options)
+    :m_options(options)
+{
+}
+
+void JParser::setOptions(const JParserOptions& options)
+{
+    m_options = options;
+}
+
+const JParserOptions& JParser::getOptions() const
+{
+    return m_options;
+}
+
+JObject JParser::parse(std::string_view data)
+{
+    JParseResult result = tryParse(data);
+    if (!result)
+        throw std::logic_error(result.error.describe(data));
+    return std::move(result.value);
+}
+
+JObject JParser::fastParse(std::ifstream& infile)
+{
+    infile.seekg(0, std::ios_base::end);
+    size_t size = infile.tellg();
+    infile.seekg(0, std::ios_base::beg);
+    std::string buffer;
+    buffer.resize(size);
+    infile.read(buffer.data(), size);
+    infile.close();
+
+    return std::move(JParser::fastParse(buffer));
+}
+
+JObject JParser::fastParse(const std::string_view data)
+{
+    static JParser jp;
+    return jp.parse(data);
+}
+
+void JParser::parseInto(std::string_view data, JObject& jo)
+{
+    if (JParseError error = tryParseInto(data, jo))
+        throw std::logic_error(error.describe(data));
+}
+
+JParseResult JParser::tryParse(std::string_view data)
+{
+    JParseResult result;
+    Scratch scratch;
+    if (m_options.shareShapes && m_options.predictKeys)
+        scratch.prediction = &m_prediction;
+    size_t itor = 0;
+    JErrorCode error = _parse(data, itor, result.value, scratch);
+    if (error != JErrorCode::None)
+    {
+        result.value = JObject();
+        result.error = { error, itor };
+    }
+    return result;
+}
+
+JParseError JParser::tryParseInto(std::string_view data, JObject& jo)
+{
+    size_t itor = 0;
+    m_scratch.stack.clear();
+    m_scratch.seen.clear();
+    m_scratch.keyCount = 0;
+    m_scratch.prediction = m_options.shareShapes && m_options.predictKeys ? &m_prediction : nullptr;
+    JErrorCode error = _parse(data, itor, jo, m_scratch);
+    if (error != JErrorCode::None)
+        return { error, itor };
+    return {};
+}
+
+JErrorCode JParser::_parse(std::string_view data, size_t& itor, JObject& root, Scratch& scratch)
+{
+    if (data.empty())
+        return JErrorCode::Empty;
+    if (data.size() > m_options.maxSize)
+        return JErrorCode::TooLarge;
+    if (m_options.validateUtf8 && !isValidUtf8(data))
+        return JErrorCode::InvalidUtf8;
+
+    // Containers that are still open, innermost last. Each one is the slot
+    // of its parent, which does not grow until the child is closed, so the
+    // pointers stay valid. Slots that already hold an unshared value of the
+    // right type are parsed into in place.
+    std::vector<Frame>& stack = scratch.stack;
+    JObject* slot = &root;
+    size_t nodes = 0;
+    // With predictKeys, the path of *slot, as a member of a learned path.
+    Prediction* slotParent = nullptr;
+    size_t slotIndex = 0;
+    // Puts the keys a dict matched before its prediction failed where they would have been parsed to.
+    auto unpredict = [&scratch](Frame& frame)
+        {
+            for (size_t i = 0; i < frame.count; i++)
+            {
+                if (scratch.keyCount == scratch.keys.size())
+                    scratch.keys.emplace_back();
+                scratch.keys[scratch.keyCount++] = frame.predicted->keys[i];
+            }
+            frame.predicted = nullptr;
+        };
+    // With keepSource, the input is copied once and every container records
+    // its span in the copy when it is closed.
+    std::shared_ptr<const JObject::SourceText> text = scratch.text;
+    if (!text && m_options.keepSource)
+    {
+        auto kept = std::make_shared<JObject::SourceText>();
+        kept->text = data;
+        kept->size = data.size();
+        text = std::move(kept);
+    }
+    // A trailing comma isn't written back, so the container that has one and
+    // all the containers around it keep no source; they are the first ones on the stack.
+    size_t tainted = 0;
+
+    while (true)
+    {
+        // Parse one value into *slot.
+        skipSpace(data, itor);
+        if (data.size() <= itor)
+            return JErrorCode::UnexpectedEnd;
+        if (++nodes > m_options.maxNodes)
+            return JErrorCode::TooManyNodes;
+
+        bool opened = false;
+        JErrorCode error = JErrorCode::None;
+        if (data[itor] == '{' || data[itor] == '[')
+        {
+            if (stack.size() >= m_options.maxDepth)
+                return JErrorCode::TooDeep;
+            JValueType type = data[itor] == '{' ? JValueType::JDict : JValueType::JList;
+            if (!reuse(*slot, type))
+                *slot = JObject(type);
+            Prediction* prediction = stack.empty() ? scratch.prediction : predict(slotParent, slotIndex);
+            if (type == JValueType::JList)
+                stack.push_back({ slot, 0, scratch.seen.size(), itor, 0, prediction, nullptr });
+            else
+            {
+                // New dicts and reused shaped ones collect their keys for a shape.
+                value_t& value = slot->m_value->value;
+                bool collect = m_options.shareShapes &&
+                    (std::holds_alternative<shaped_t>(value) || std::get_if<dict_t>(&value)->empty());
+                if (collect && !std::holds_alternative<shaped_t>(value))
+                    value.emplace<shaped_t>();
+                else if (!collect && !std::holds_alternative<dict_t>(value))
+                    value.emplace<dict_t>();
+                if (collect)
+                    stack.push_back({ slot, 0, scratch.keyCount, itor, 0, prediction,
+                        prediction != nullptr ? prediction->shape.get() : nullptr });
+                else
+                    stack.push_back({ slot, 0, scratch.seen.size(), itor, 3, nullptr, nullptr });
+            }
+            itor++;
+            opened = true;
+        }
+        else if (data[itor] == '\"')
+            error = getString(data, itor, *slot);
+        else if (data[itor] == 'n')
+            error = getNull(data, itor, *slot);
+        else if (data[itor] == 't' || data[itor] == 'f')
+            error = getBool(data, itor, *slot);
+        else if ((data[itor] >= '0' && data[itor] <= '9') || data[itor] == '-')
+            error = getNumber(data, itor, *slot);
+        else
+            return JErrorCode::UnexpectedCharacter;
+        if (error != JErrorCode::None)
+            return error;
+
+        // Close finished containers until one expects another element.
+        slot = nullptr;
+        while (!stack.empty() && slot == nullptr)
+        {
+            Frame& frame = stack.back();
+            JObject& container = *frame.container;
+            bool isDict = container.getType() == JValueType::JDict;
+            char close = isDict ? '}' : ']';
+
+            skipSpace(data, itor);
+            if (data.size() <= itor)
+                return JErrorCode::UnexpectedEnd;
+            bool comma = false;
+            if (!opened)
+            {
+                if (data[itor] == ',')
+                {
+                    itor++;
+                    skipSpace(data, itor);
+                    if (data.size() <= itor)
+                        return JErrorCode::UnexpectedEnd;
+                    comma = true;
+                }
+                else if (data[itor] != close)
+                    return JErrorCode::UnexpectedCharacter;
+            }
+            opened = false;
+
+            if (data[itor] == close)
+            {
+                itor++;
+                if (isDict && frame.layout == 0 && frame.predicted != nullptr &&
+                    frame.count == frame.predicted->keys.size())
+                {
+                    // Every key was the predicted one.
+                    shaped_t& shaped = *std::get_if<shaped_t>(&container.m_value->value);
+                    if (frame.count < shaped.values.size())
+                        shaped.values.erase(shaped.values.begin() + frame.count, shaped.values.end());
+                    if (shaped.shape.get() != frame.predicted)
+                        shaped.shape = frame.prediction->shape;
+                }
+                else if (isDict && frame.layout == 0)
+                {
+                    if (frame.predicted != nullptr)
+                        unpredict(frame);
+                    closeShape(container, frame, scratch);
+                }
+                else if (isDict)
+                {
+                    // Drops the members of a reused dict that the input no longer has.
+                    dict_t& dict = *std::get_if<dict_t>(&container.m_value->value);
+                    auto first = scratch.seen.begin() + frame.seen;
+                    std::sort(first, scratch.seen.end());
+                    if (static_cast<size_t>(std::unique(first, scratch.seen.end()) - first) != dict.size())
+                    {
+                        for (auto member = dict.begin(); member != dict.end();)
+                        {
+                            if (std::binary_search(first, scratch.seen.end(), &member->second))
+                                ++member;
+                            else
+                                member = dict.erase(member);
+                        }
+                    }
+                    scratch.seen.resize(frame.seen);
+                }
+                else
+                {
+                    value_t& value = container.m_value->value;
+                    if (list_t* list = std::get_if<list_t>(&value))
+                    {
+                        if (frame.count < list->size())
+                            list->erase(list->begin() + frame.count, list->end());
+                    }
+                    else if (frame.count == 0)
+                        value.emplace<list_t>();
+                }
+                if (comma)
+                    tainted = stack.size();
+                if (text && stack.size() > tainted)
+                    container.m_value->source.reset(new JObject::Source{ text, text->offset + frame.begin, text->offset + itor });
+                stack.pop_back();
+                tainted = std::min(tainted, stack.size());
+                continue;
+            }
+
+            slotParent = frame.prediction;
+            slotIndex = isDict ? frame.count : 0;
+            if (isDict && frame.layout == 0)
+            {
+                // A learned key is compared with the input as is, without decoding it.
+                if (frame.predicted != nullptr && !(frame.count < frame.predicted->keys.size() &&
+                    matchKey(data, itor, frame.predicted->keys[frame.count])))
+                    unpredict(frame);
+                if (frame.predicted == nullptr)
+                {
+                    if (scratch.keyCount == scratch.keys.size())
+                        scratch.keys.emplace_back();
+                    error = getString(data, itor, scratch.keys[scratch.keyCount++]);
+                    if (error != JErrorCode::None)
+                        return error;
+                }
+                skipSpace(data, itor);
+                if (itor >= data.size())
+                    return JErrorCode::UnexpectedEnd;
+                if (data[itor] != ':')
+                    return JErrorCode::UnexpectedCharacter;
+                itor++;
+                list_t& values = std::get_if<shaped_t>(&container.m_value->value)->values;
+                if (frame.count == values.size())
+                    values.emplace_back();
+                slot = &values[frame.count];
+            }
+            else if (isDict)
+            {
+                error = getString(data, itor, scratch.key);
+                if (error != JErrorCode::None)
+                    return error;
+                skipSpace(data, itor);
+                if (itor >= data.size())
+                    return JErrorCode::UnexpectedEnd;
+                if (data[itor] != ':')
+                    return JErrorCode::UnexpectedCharacter;
+                itor++;
+                dict_t& dict = *std::get_if<dict_t>(&container.m_value->value);
+                auto member = dict.find(scratch.key);
+                if (member == dict.end())
+                    member = dict.emplace(scratch.key, JObject()).first;
+                slot = &member->second;
+                scratch.seen.push_back(slot);
+            }
+            else
+            {
+                // Numbers of one kind are parsed straight into packed storage
+                // until another value, or a double a double can't hold exactly, shows up.
+                value_t& value = container.m_value->value;
+                char c = data[itor];
+                if (frame.layout != 3 && !m_options.lazyNumbers && ((c >= '0' && c <= '9') || c == '-'))
+                {
+                    if (++nodes > m_options.maxNodes)
+                        return JErrorCode::TooManyNodes;
+                    long long integer;
+                    long double real;
+                    bool isDouble;
+                    error = readNumber(data, itor, integer, real, isDouble);
+                    if (error != JErrorCode::None)
+                        return error;
+                    if (frame.layout == 0)
+                    {
+                        frame.layout = isDouble ? 2 : 1;
+                        packed_t* packed = std::get_if<packed_t>(&value);
+                        if (packed != nullptr && packed->numbers.index() == static_cast<size_t>(isDouble))
+                            std::visit([](auto& numbers) { numbers.clear(); }, packed->numbers);
+                        else if (isDouble)
+                            value = packed_t(std::vector<double>());
+                        else
+                            value = packed_t(std::vector<std::int64_t>());
+                    }
+
+                    packed_t* packed = std::get_if<packed_t>(&value);
+                    if (frame.layout == 1 && !isDouble)
+                        std::get_if<0>(&packed->numbers)->push_back(integer);
+                    else if (frame.layout == 2 && isDouble && static_cast<long double>(static_cast<double>(real)) == real)
+                        std::get_if<1>(&packed->numbers)->push_back(static_cast<double>(real));
+                    else
+                    {
+                        JObject::unpack(value);
+                        frame.layout = 3;
+                        if (isDouble)
+                            std::get_if<list_t>(&value)->emplace_back(real);
+                        else
+                            std::get_if<list_t>(&value)->emplace_back(integer);
+                    }
+                    frame.count++;
+                    continue;
+                }
+                if (frame.layout == 0 && std::holds_alternative<packed_t>(value))
+                    value.emplace<list_t>();
+                else if (frame.layout != 3)
+                    JObject::unpack(value);
+                frame.layout = 3;
+                list_t& list = *std::get_if<list_t>(&value);
+                if (frame.count == list.size())
+                    list.emplace_back();
+                slot = &list[frame.count];
+            }
+            frame.count++;
+        }
+
+        if (slot == nullptr)
+            return JErrorCode::None;
+    }
+}
+
+JObject JParser::reparse(const JObject& previous, std::string_view oldText, const JEdit& edit)
+{
+    using Source = JObject::Source;
+    using SourceText = JObject::SourceText;
+
+    if (edit.offset > oldText.size() || edit.removed > oldText.size() - edit.offset)
+        throw std::logic_error("The edit is out of range.");
+
+    // Builds the new text of a range of the old text that encloses the edit.
+    auto splice = [&oldText, &edit](size_t begin, size_t end)
+        {
+            auto text = std::make_shared<SourceText>();
+            text->text.reserve(end - begin - edit.removed + edit.inserted.size());
+            text->text.append(oldText.substr(begin, edit.offset - begin));
+            text->text.append(edit.inserted);
+            text->text.append(oldText.substr(edit.offset + edit.removed, end - edit.offset - edit.removed));
+            text->offset = begin;
+            text->size = oldText.size() - edit.removed + edit.inserted.size();
+            return text;
+        };
+
+    auto parseAll = [this, &oldText, &splice]()
+        {
+            std::shared_ptr<SourceText> text = splice(0, oldText.size());
+            JObject root;
+            Scratch scratch;
+            scratch.text = text;
+            size_t itor = 0;
+            JErrorCode error = _parse(text->text, itor, root, scratch);
+            if (error != JErrorCode::None)
+                throw std::logic_error(JParseError{ error, itor }.describe(text->text));
+            return root;
+        };
+
+    const Source* rootSource = previous.m_value ? previous.m_value->source.get() : nullptr;
+    if (rootSource == nullptr || rootSource->text->size != oldText.size())
+        return parseAll();
+
+    // Unchanged subtrees may still point into the text of an earlier version;
+    // their offsets are moved through the edits made since then.
+    const SourceText& current = *rootSource->text;
+    std::vector<const SourceText::Shift*> shifts;
+    auto locate = [&current, &shifts](const Source& source, size_t& begin, size_t& end)
+        {
+            shifts.clear();
+            const SourceText::Shift* shift = current.history.get();
+            for (size_t i = source.text->version; i < current.version; i++, shift = shift->previous.get())
+                shifts.push_back(shift);
+            begin = source.begin;
+            end = source.end - 1;
+            for (auto itor = shifts.rbegin(); itor != shifts.rend(); ++itor)
+            {
+                const SourceText::Shift& shift = **itor;
+                if (begin >= shift.offset + shift.removed)
+                    begin = begin - shift.removed + shift.inserted;
+                if (end >= shift.offset + shift.removed)
+                    end = end - shift.removed + shift.inserted;
+            }
+            end++;
+        };
+
+    // Compares the old text with the text the previous object kept; containers
+    // around earlier edits keep none, so the ones inside them are compared.
+    std::vector<const JObject*> pending{ &previous };
+    while (!pending.empty())
+    {
+        const JObject& node = *pending.back();
+        pending.pop_back();
+        if (!node.m_value || !node.m_value->source)
+            continue;
+        size_t begin, end;
+        locate(*node.m_value->source, begin, end);
+        std::string_view kept = node.getSource();
+        if (!kept.empty())
+        {
+            if (end > oldText.size() || oldText.substr(begin, end - begin) != kept)
+                return parseAll();
+            continue;
+        }
+        const value_t& value = node.m_value->value;
+        if (const list_t* list = std::get_if<list_t>(&value))
+        {
+            for (const JObject& child : *list)
+                pending.push_back(&child);
+        }
+        else if (const shaped_t* shaped = std::get_if<shaped_t>(&value))
+        {
+            for (const JObject& child : shaped->values)
+                pending.push_back(&child);
+        }
+        else if (const dict_t* dict = std::get_if<dict_t>(&value))
+        {
+            for (const auto& [key, child] : *dict)
+                pending.push_back(&child);
+        }
+    }
+
+    auto encloses = [&edit](size_t begin, size_t end)
+        {
+            return begin < edit.offset && edit.offset + edit.removed < end;
+        };
+
+    struct Step
+    {
+        const JObject* node;
+        size_t begin;
+        size_t end;
+        size_t index;
+        const std::string* key;
+    };
+
+    std::vector<Step> path;
+    size_t begin, end;
+    locate(*rootSource, begin, end);
+    if (!encloses(begin, end))
+        return parseAll();
+    path.push_back({ &previous, begin, end, 0, nullptr });
+
+    // Descends to the innermost container whose brackets enclose the edit.
+    while (true)
+    {
+        const JObject& node = *path.back().node;
+        bool found = false;
+        if (node.isPacked())
+            break;
+        if (node.getType() == JValueType::JList)
+        {
+            // Containers appear in text order, so the list is searched by bisection.
+            const list_t& list = node.getList();
+            size_t low = 0, high = list.size();
+            while (low < high && !found)
+            {
+                size_t middle = low + (high - low) / 2;
+                size_t i = middle;
+                while (i < high && !(list[i].m_value && list[i].m_value->source))
+                    i++;
+                if (i == high)
+                {
+                    high = middle;
+                    continue;
+                }
+                locate(*list[i].m_value->source, begin, end);
+                if (end <= edit.offset)
+                    low = i + 1;
+                else if (begin >= edit.offset + edit.removed)
+                    high = middle;
+                else if (encloses(begin, end))
+                {
+                    path.push_back({ &list[i], begin, end, i, nullptr });
+                    found = true;
+                }
+                else
+                    break;
+            }
+        }
+        else if (const shaped_t* shaped = std::get_if<shaped_t>(&node.m_value->value))
+        {
+            for (size_t i = 0; i < shaped->values.size() && !found; i++)
+            {
+                const JObject& value = shaped->values[i];
+                if (!value.m_value || !value.m_value->source)
+                    continue;
+                locate(*value.m_value->source, begin, end);
+                if (encloses(begin, end))
+                {
+                    path.push_back({ &value, begin, end, 0, &shaped->shape->keys[i] });
+                    found = true;
+                }
+            }
+        }
+        else
+        {
+            for (const auto& [key, value] : node.getDict())
+            {
+                if (!value.m_value || !value.m_value->source)
+                    continue;
+                locate(*value.m_value->source, begin, end);
+                if (encloses(begin, end))
+                {
+                    path.push_back({ &value, begin, end, 0, &key });
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found)
+            break;
+    }
+
+    // Tries the innermost container first; an edit that changes the structure
+    // around it makes its range fail to parse as one value, so the next
+    // enclosing container is tried. Only the text of the reparsed container is kept.
+    for (size_t depth = path.size(); depth-- > 0;)
+    {
+        std::shared_ptr<SourceText> text = splice(path[depth].begin, path[depth].end);
+        text->version = current.version + 1;
+        text->history = std::make_shared<SourceText::Shift>(
+            SourceText::Shift{ edit.offset, edit.removed, edit.inserted.size(), current.history });
+
+        JObject value;
+        Scratch scratch;
+        scratch.text = text;
+        size_t itor = 0;
+        if (_parse(text->text, itor, value, scratch) != JErrorCode::None || itor != text->text.size())
+            continue;
+
+        // Copies the path, which is cloned one level at a time, and moves its spans to the new
+        // version; they enclose more than the kept text, so the path is written again.
+        // A reparsed value without a span had a trailing comma, so the path keeps none either.
+        bool spanned = value.m_value && value.m_value->source;
+        JObject result = previous;
+        JObject* slot = &result;
+        for (size_t i = 0; i < depth; i++)
+        {
+            value_t& container = slot->mutableValue();
+            if (spanned)
+                slot->m_value->source.reset(new Source{ text, path[i].begin,
+                    path[i].end - edit.removed + edit.inserted.size() });
+            else
+                slot->m_value->source.reset();
+            if (path[i + 1].key != nullptr)
+                slot = &std::get_if<dict_t>(&container)->find(*path[i + 1].key)->second;
+            else
+                slot = &(*std::get_if<list_t>(&container))[path[i + 1].index];
+        }
+        *slot = std::move(value);
+        return result;
+    }
+
+    return parseAll();
+}
+
+
+bool JParser::reuse(JObject& slot, JValueType type)
+{
+    if (slot.m_type != type || !slot.m_value || slot.m_value.use_count() != 1)
+        return false;
+    // Drops the cached hash and source span; the storage is unshared, so
+    // nothing is cloned, and a packed list stays packed for the new elements.
+    slot.ownValue();
+    return true;
+}
+
+void JParser::closeShape(JObject& dict, const Frame& frame, Scratch& scratch)
+{
+    shaped_t& shaped = *std::get_if<shaped_t>(&dict.m_value->value);
+    if (frame.count < shaped.values.size())
+        shaped.values.erase(shaped.values.begin() + frame.count, shaped.values.end());
+    const std::string* keys = scratch.keys.data() + frame.seen;
+    size_t count = frame.count;
+    scratch.keyCount = frame.seen;
+
+    // Learned shapes are only kept if their keys can be matched raw.
+    auto learn = [&frame](const std::shared_ptr<const shape_t>& shape)
+        {
+            if (frame.prediction != nullptr && frame.prediction->shape != shape)
+                frame.prediction->shape = shape && shape->plainKeys ? shape : nullptr;
+        };
+
+    // A reused dict usually gets the keys it had last time.
+    if (shaped.shape && shaped.shape->keys.size() == count &&
+        std::equal(keys, keys + count, shaped.shape->keys.begin()))
+    {
+        learn(shaped.shape);
+        return;
+    }
+
+    // Nothing parsed after the root of a one-off parse could share its keys.
+    bool last = scratch.stack.size() == 1 && &scratch != &m_scratch && frame.prediction == nullptr;
+    std::string& sequence = scratch.sequence;
+    sequence.clear();
+    for (size_t i = 0; i < count && !last; i++)
+    {
+        size_t size = keys[i].size();
+        sequence.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        sequence += keys[i];
+    }
+    auto found = last ? scratch.shapes.end() : scratch.shapes.find(sequence);
+    if (found != scratch.shapes.end() && found->second)
+    {
+        shaped.shape = found->second;
+        learn(shaped.shape);
+        return;
+    }
+    bool repeated = found != scratch.shapes.end();
+    if (!repeated && !last && scratch.shapes.size() < maxShapes)
+        found = scratch.shapes.emplace(sequence, nullptr).first;
+    if (found != scratch.shapes.end() && (repeated || frame.prediction != nullptr))
+    {
+        // The keys repeat (or are learned for the next document): they
+        // become a shape, unless a key is duplicated.
+        auto shape = std::make_shared<shape_t>();
+        shape->keys.assign(keys, keys + count);
+        shape->slots.reserve(count);
+        bool unique = true;
+        for (size_t i = 0; i < count && unique; i++)
+            unique = shape->slots.emplace(shape->keys[i], i).second;
+        shape->plainKeys = std::none_of(keys, keys + count,
+            [](const std::string& key) { return key.find_first_of("\"\\") != std::string::npos; });
+        if (unique)
+        {
+            found->second = shape;
+            shaped.shape = std::move(shape);
+            learn(shaped.shape);
+            return;
+        }
+    }
+    learn(nullptr);
+
+    // Keys seen for the first time make an ordinary dict; the last of duplicated keys wins.
+    dict_t members;
+    members.reserve(count);
+    for (size_t i = 0; i < count; i++)
+        members.insert_or_assign(keys[i], std::move(shaped.values[i]));
+    dict.m_value->value = std::move(members);
+}
+
+JParser::Prediction* JParser::predict(Prediction* parent, size_t index)
+{
+    if (parent == nullptr)
+        return nullptr;
+    if (index >= parent->children.size())
+    {
+        size_t added = index + 1 - parent->children.size();
+        if (m_predictionCount + added > maxPredictions)
+            return nullptr;
+        m_predictionCount += added;
+        parent->children.resize(index + 1);
+    }
+    return &parent->children[index];
+}
+
+bool JParser::matchKey(std::string_view data, size_t& itor, const std::string& key)
+{
+    size_t end = itor + key.size() + 1;
+    if (end >= data.size() || data[itor] != '\"' || data[end] != '\"' ||
+        std::memcmp(data.data() + itor + 1, key.data(), key.size()) != 0)
+        return false;
+    itor = end + 1;
+    return true;
+}
+
+void JParser::skipSpace(std::string_view data, size_t& itor)
+{
+    // Lines aren't counted here; JParseError::describe() works them out from the offset.
+    const size_t size = data.size();
+    while (itor < size && (data[itor] == ' ' || data[itor] == '\n' || data[itor] == '\t' || data[itor] == '\r'))
+        itor++;
+}
+
+JErrorCode JParser::getString(std::string_view data, size_t& itor, std::string& str)
+{
+    if (data[itor] != '\"')
+        return JErrorCode::UnexpectedCharacter;
+    str.clear();
+    itor++;
+    const size_t size = data.size();
+    while (true)
+    {
+        // Copies the text up to the next quote or backslash in one piece.
+        size_t end = itor;
+        while (end < size && data[end] != '\"' && data[end] != '\\')
+            end++;
+        str.append(data.data() + itor, end - itor);
+        itor = end;
+        if (itor < size && data[itor] == '\"')
+            break;
+        if (itor + 1 >= size)
+            return JErrorCode::UnexpectedEnd;
+        itor++;
+        switch (data[itor])
+        {
+        case 'n':
+            str += '\n';
+            break;
+        case 'b':
+            str += '\b';
+            break;
+        case 'f':
+            str += '\f';
+            break;
+        case 'r':
+            str += '\r';
+            break;
+        case 't':
+            str += '\t';
+            break;
+        case '\\':
+        case '\"':
+        case '/':
+            str += data[itor];
+            break;
+        case 'u':
+        {
+            long code = unicodeEscape(data, itor);
+            if (code < 0)
+                return JErrorCode::InvalidString;
+            appendUtf8(str, static_cast<std::uint32_t>(code));
+            break;
         }
-        if (data[itor] == ']')
-            return localJO;
-        else
-            throw std::logic_error(getLogicErrorString(error_line));
+        default:
+            return JErrorCode::InvalidString;
+        }
+        itor++;
     }
-    else if (data[itor] == '\"')
+    itor++;
+    return JErrorCode::None;
+}
+
+long JParser::unicodeEscape(std::string_view data, size_t& itor)
+{
+    long unit = hexQuad(data, itor + 1);
+    if (unit < 0 || (unit >= 0xDC00 && unit < 0xE000))
+        return -1;
+    itor += 4;
+    if (unit < 0xD800 || unit >= 0xDC00)
+        return unit;
+    // A high surrogate must be followed by an escaped low one.
+    long low = itor + 2 < data.size() && data[itor + 1] == '\\' && data[itor + 2] == 'u' ? hexQuad(data, itor + 3) : -1;
+    if (low < 0xDC00 || low >= 0xE000)
+        return -1;
+    itor += 6;
+    return 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+}
+
+void JParser::appendUtf8(std::string& str, std::uint32_t code)
+{
+    char bytes[4];
+    size_t length;
+    if (code < 0x80)
     {
-        return std::move(getString(data, itor, error_line));
+        bytes[0] = static_cast<char>(code);
+        length = 1;
     }
-    else if (data[itor] == 'n')
+    else if (code < 0x800)
     {
-        return std::move(getNull(data, itor, error_line));
+        bytes[0] = static_cast<char>(0xC0 | (code >> 6));
+        bytes[1] = static_cast<char>(0x80 | (code & 0x3F));
+        length = 2;
     }
-    else if (data[itor] == 't' || data[itor] == 'f')
+    else if (code < 0x10000)
     {
-        return std::move(getBool(data, itor, error_line));
+        bytes[0] = static_cast<char>(0xE0 | (code >> 12));
+        bytes[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        bytes[2] = static_cast<char>(0x80 | (code & 0x3F));
+        length = 3;
     }
-    else if ((data[itor] >= '0' && data[itor] <= '9') || data[itor] == '-')
+    else
     {
-        return std::move(getNumber(data, itor, error_line));
+        bytes[0] = static_cast<char>(0xF0 | (code >> 18));
+        bytes[1] = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        bytes[2] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        bytes[3] = static_cast<char>(0x80 | (code & 0x3F));
+        length = 4;
     }
-    else
-        throw std::logic_error(getLogicErrorString(error_line));
+    str.append(bytes, length);
 }
 
-void JParser::skipSpace(std::string_view data, size_t& itor, long long& error_line)
+JErrorCode JParser::getString(std::string_view data, size_t& itor, JObject& slot)
 {
-    auto size = data.size();
-    while (itor < size && (data[itor] == ' ' || data[itor] == '\t' || data[itor] == '\n'))
-    {
-        if (data[itor] == '\n')
-        {
-            error_line++;
-        }
-        itor++;
-    }
+    if (reuse(slot, JValueType::JString))
+        return getString(data, itor, *std::get_if<string_t>(&slot.m_value->value));
+    std::string str;
+    JErrorCode error = getString(data, itor, str);
+    slot = std::move(str);
+    return error;
 }
 
-std::string JParser::getString(std::string_view data, size_t& itor, long long error_line)
+JErrorCode JParser::scanNumber(std::string_view data, size_t& itor, bool& isDouble)
 {
-    if (data[itor] == '\"')
-    {
-        std::string str;
-        itor++;
-        while (itor < data.size() && data[itor] != '\"')
+    auto digits = [&data, &itor]()
         {
-            if (data[itor] == '\\')
-            {
+            size_t start = itor;
+            while (itor < data.size() && data[itor] >= '0' && data[itor] <= '9')
                 itor++;
-                switch (data[itor])
-                {
-                case 'n':
-                    str += '\n';
-                    break;
-                case 'b':
-                    str += "\b";
-                    break;
-                case 'f':
-                    str += "\f";
-                    break;
-                case 'r':
-                    str += "\r";
-                    break;
-                case 't':
-                    str += "\t";
-                    break;
-                case '\\':
-                    str += "\\";
-                    break;
-                case '\"':
-                    str += "\"";
-                    break;
-                case '/':
-                    str += "/";
-                    break;
-                default:
-                    throw std::logic_error(getLogicErrorString(error_line));
-                    break;
-                }
-            }
-            else
-            {
-                str += data[itor];
-            }
-            itor++;
-        }
-        if (itor >= data.size())
-            throw std::logic_error(getLogicErrorString(error_line));
-        itor++;
-        return std::move(str);
-    }
-    else
-        throw std::logic_error(getLogicErrorString(error_line));
-}
+            return itor != start;
+        };
 
-JObject JParser::getNumber(std::string_view data, size_t& itor, long long error_line)
-{
-    bool isDouble = false;
-    bool firstNum = false;
-    bool isNegative = false;
+    isDouble = false;
     if (data[itor] == '-')
+        itor++;
+    if (!digits())
+        return JErrorCode::InvalidNumber;
+    if (itor < data.size() && data[itor] == '.')
     {
-        isNegative = true;
         itor++;
+        if (!digits())
+            return JErrorCode::InvalidNumber;
+        isDouble = true;
+    }
+    if (itor < data.size() && (data[itor] == 'e' || data[itor] == 'E'))
+    {
+        itor++;
+        if (itor < data.size() && (data[itor] == '+' || data[itor] == '-'))
+            itor++;
+        if (!digits())
+            return JErrorCode::InvalidNumber;
+        isDouble = true;
     }
-    size_t count = 0;
+    return JErrorCode::None;
+}
+
+JErrorCode JParser::readNumber(std::string_view data, size_t& itor, long long& integer, long double& real, bool& isDouble)
+{
     size_t start = itor;
+    JErrorCode error = scanNumber(data, itor, isDouble);
+    if (error != JErrorCode::None)
+        return error;
+    const char* first = data.data() + start;
+    const char* last = data.data() + itor;
+    // Integers too large for a long long are read as doubles.
+    if (!isDouble && std::from_chars(first, last, integer).ec == std::errc())
+        return JErrorCode::None;
+
+    lexeme_t lexeme(std::string_view(first, last - first));
+    JObject::decode(lexeme, false);
+    real = lexeme.decoded.real;
+    isDouble = true;
+    return JErrorCode::None;
+}
 
-    while (itor < data.size() &&
-           ((data[itor] >= '0' && data[itor] <= '9') || data[itor] == '.'))
+JErrorCode JParser::getNumber(std::string_view data, size_t& itor, JObject& slot)
+{
+    if (m_options.lazyNumbers)
     {
-        if (!firstNum && data[itor] >= '0' && data[itor] <= '9')
-        {
-            firstNum = true;
-        }
-        else if (isDouble)
-        {
-            count++;
-        }
-        else if (data[itor] == '.')
-        {
-            if (!firstNum)
-                throw std::logic_error(getLogicErrorString(error_line));
+        // Only the type is worked out now; long integers are checked against the range of a long long.
+        size_t start = itor;
+        bool isDouble;
+        JErrorCode error = scanNumber(data, itor, isDouble);
+        if (error != JErrorCode::None)
+            return error;
+        std::string_view text = data.substr(start, itor - start);
+        long long integer;
+        if (!isDouble && text.size() >= 19 &&
+            std::from_chars(text.data(), text.data() + text.size(), integer).ec != std::errc())
             isDouble = true;
-            itor++;
-            continue;
+        JValueType type = isDouble ? JValueType::JDouble : JValueType::JInt;
+        if (reuse(slot, type))
+        {
+            lexeme_t* lexeme = std::get_if<lexeme_t>(&slot.m_value->value);
+            if (lexeme == nullptr)
+                slot.m_value->value.emplace<lexeme_t>(text);
+            else
+            {
+                lexeme->text.assign(text);
+                lexeme->state.store(0, std::memory_order_relaxed);
+            }
+            return JErrorCode::None;
         }
-        itor++;
+        JObject number;
+        number.m_type = type;
+        number.m_value = std::make_shared<JObject::Storage>(std::in_place_type<lexeme_t>, text);
+        slot = std::move(number);
+        return JErrorCode::None;
     }
 
+    long long integer;
+    long double real;
+    bool isDouble;
+    JErrorCode error = readNumber(data, itor, integer, real, isDouble);
+    if (error != JErrorCode::None)
+        return error;
     if (isDouble)
     {
-        long double number = data[itor - 1] - '0';
-        size_t single = 10;
-        for (long long i = itor - 2; i >= static_cast<long long>(start); --i, single *= 10)
-        {
-            if (data[i] == '.')
-                continue;
-            number += single * (data[i] - '0');
-        }
-        if (isNegative)
-            number *= -1;
-        return number / std::pow(10, count);
+        if (reuse(slot, JValueType::JDouble))
+            slot.m_value->value.emplace<double_t>(real);
+        else
+            slot = real;
     }
     else
     {
-        long long number = data[itor - 1] - '0';
-        size_t single = 10;
-        for (long long i = itor - 2; i >= static_cast<long long>(start); --i, single *= 10)
-        {
-            number += single * (data[i] - '0');
-        }
-        if (isNegative)
-            number *= -1;
-        return number;
+        if (reuse(slot, JValueType::JInt))
+            slot.m_value->value.emplace<int_t>(integer);
+        else
+            slot = integer;
     }
+    return JErrorCode::None;
 }
 
-JObject JParser::getBool(std::string_view data, size_t& itor, long long error_line)
+JErrorCode JParser::getBool(std::string_view data, size_t& itor, JObject& slot)
 {
+    bool value;
     if (data.size() >= itor + 4 &&
         data[itor] == 't' &&
         data[itor + 1] == 'r' &&
@@ -737,7 +2880,7 @@ JObject JParser::getBool(std::string_view data, size_t& itor, long long error_li
         data[itor + 3] == 'e')
     {
         itor += 4;
-        return true;
+        value = true;
     }
     else if (data.size() >= itor + 5 &&
              data[itor] == 'f' &&
@@ -747,12 +2890,19 @@ JObject JParser::getBool(std::string_view data, size_t& itor, long long error_li
              data[itor + 4] == 'e')
     {
         itor += 5;
-        return false;
+        value = false;
     }
-    throw std::logic_error(getLogicErrorString(error_line));
+    else
+        return JErrorCode::InvalidLiteral;
+
+    if (reuse(slot, JValueType::JBool))
+        *std::get_if<bool_t>(&slot.m_value->value) = value;
+    else
+        slot = value;
+    return JErrorCode::None;
 }
 
-JObject JParser::getNull(std::string_view data, size_t& itor, long long error_line)
+JErrorCode JParser::getNull(std::string_view data, size_t& itor, JObject& slot)
 {
     if (data.size() >= itor + 4 &&
         data[itor] == 'n' &&
@@ -761,133 +2911,416 @@ JObject JParser::getNull(std::string_view data, size_t& itor, long long error_li
         data[itor + 3] == 'l')
     {
         itor += 4;
-        return JObject();
+        slot = JObject();
+        return JErrorCode::None;
     }
-    throw std::logic_error(getLogicErrorString(error_line));
+    return JErrorCode::InvalidLiteral;
 }
 
-std::string JParser::getLogicErrorString(long long error_line)
+std::string JParseError::describe(std::string_view data) const
 {
-    return "Invalid Input, in line " + std::to_string(error_line);
+    const char* what = nullptr;
+    switch (code)
+    {
+    case JErrorCode::None:
+        return "No error.";
+    case JErrorCode::Empty:
+        return "The input is empty.";
+    case JErrorCode::TooLarge:
+        return "The input exceeds the maximum size.";
+    case JErrorCode::InvalidUtf8:
+        return "The input isn't valid UTF-8.";
+    case JErrorCode::TooDeep:
+        what = "The input exceeds the maximum depth";
+        break;
+    case JErrorCode::TooManyNodes:
+        what = "The input exceeds the maximum number of nodes";
+        break;
+    case JErrorCode::UnexpectedEnd:
+        what = "Unexpected end of input";
+        break;
+    case JErrorCode::UnexpectedCharacter:
+        what = "Unexpected character";
+        break;
+    case JErrorCode::InvalidString:
+        what = "Invalid escape in string";
+        break;
+    case JErrorCode::InvalidNumber:
+        what = "Invalid number";
+        break;
+    case JErrorCode::InvalidLiteral:
+        what = "Invalid literal";
+        break;
+    }
+
+    // The line is cut to a window around the error, so minified input stays readable.
+    constexpr size_t context = 40;
+    size_t at = std::min(offset, data.size());
+    size_t lineBegin = data.rfind('\n', at == 0 ? 0 : at - 1);
+    lineBegin = lineBegin == std::string_view::npos || lineBegin >= at ? 0 : lineBegin + 1;
+    size_t lineEnd = data.find('\n', at);
+    if (lineEnd == std::string_view::npos)
+        lineEnd = data.size();
+    if (lineEnd > lineBegin && data[lineEnd - 1] == '\r')
+        lineEnd--;
+    size_t line = std::count(data.begin(), data.begin() + lineBegin, '\n') + 1;
+    size_t begin = at - lineBegin > context ? at - context : lineBegin;
+    size_t end = lineEnd - std::min(at, lineEnd) > context ? at + context : lineEnd;
+
+    std::string message = std::string(what) + " at line " + std::to_string(line) +
+        ", column " + std::to_string(at - lineBegin + 1) + ":\n";
+    std::string caret;
+    if (begin > lineBegin)
+    {
+        message += "...";
+        caret += "   ";
+    }
+    message.append(data.substr(begin, end - begin));
+    if (end < lineEnd)
+        message += "...";
+    // Tabs are copied so that the caret lines up with the text above it.
+    for (size_t i = begin; i < at && i < end; i++)
+        caret += data[i] == '\t' ? '\t' : ' ';
+    message += '\n' + caret + '^';
+    return message;
 }
 
 std::string JWriter::write(const JObject& jo)
 {
     std::string str;
+    writeValue(str, jo);
+    return str;
+}
 
-    switch (jo.getType())
+void JWriter::writeValue(std::string& str, const JObject& jo)
+{
+    struct Frame
     {
-    case JValueType::JNull:
-        str += "null";
-        break;
-    case JValueType::JInt:
-        str += std::to_string(jo.getInt());
-        break;
-    case JValueType::JDouble:
-        str += std::to_string(jo.getDouble());
-        break;
-    case JValueType::JBool:
-        if (jo.getBool())
-            str += "true";
-        else
-            str += "false";
-        break;
-    case JValueType::JString:
+        const JObject* node;
+        size_t index;
+        dict_t::const_iterator member;
+    };
+
+    std::vector<Frame> stack;
+    auto open = [&str, &stack](const JObject& value)
+        {
+            switch (value.getType())
+            {
+            case JValueType::JNull:
+                str += "null";
+                break;
+            case JValueType::JInt:
+                if (std::string_view lexeme = value.getLexeme(); !lexeme.empty())
+                    str += lexeme;
+                else
+                    str += std::to_string(value.getInt());
+                break;
+            case JValueType::JDouble:
+                if (std::string_view lexeme = value.getLexeme(); !lexeme.empty())
+                    str += lexeme;
+                else
+                    str += std::to_string(value.getDouble());
+                break;
+            case JValueType::JBool:
+                str += value.getBool() ? "true" : "false";
+                break;
+            case JValueType::JString:
+                writeString(str, value.getString());
+                break;
+            case JValueType::JList:
+            case JValueType::JDict:
+            {
+                // Containers unchanged since parsing are copied from the source.
+                std::string_view source = value.getSource();
+                if (!source.empty())
+                    str += source;
+                else if (value.isPacked())
+                {
+                    str += '[';
+                    writePacked(str, value, 0, packedSize(value));
+                    str += ']';
+                }
+                else if (value.getType() == JValueType::JList)
+                {
+                    str += '[';
+                    stack.push_back({ &value, 0, {} });
+                }
+                else if (value.isShaped())
+                {
+                    str += '{';
+                    stack.push_back({ &value, 0, {} });
+                }
+                else
+                {
+                    str += '{';
+                    stack.push_back({ &value, 0, value.getDict().begin() });
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        };
+
+    open(jo);
+    while (!stack.empty())
     {
-        std::string localString(jo.getString());
-        if (localString.empty())
+        Frame& frame = stack.back();
+        if (frame.node->getType() == JValueType::JList)
         {
-            str += "\"\"";
+            const list_t& list = frame.node->getList();
+            if (frame.index == list.size())
+            {
+                str += ']';
+                stack.pop_back();
+                continue;
+            }
+            if (frame.index++ != 0)
+                str += ',';
+            open(list[frame.index - 1]);
         }
-        else
+        else if (const shaped_t* shaped = getShaped(*frame.node))
         {
+            // Shaped dicts are written in the order of their keys.
+            if (frame.index == shaped->values.size())
+            {
+                str += '}';
+                stack.pop_back();
+                continue;
+            }
+            if (frame.index++ != 0)
+                str += ',';
             str += '\"';
-            for (auto i = localString.begin(); i != localString.end(); ++i)
+            str += shaped->shape->keys[frame.index - 1];
+            str += "\":";
+            open(shaped->values[frame.index - 1]);
+        }
+        else
+        {
+            if (frame.member == frame.node->getDict().end())
             {
-                switch (*i)
-                {
-                case 0:
-                    throw std::logic_error("Invalid string");
-                case '\n':
-                    str += "\\n";
-                    break;
-                case '\b':
-                    str += "\\b";
-                    break;
-                case '\f':
-                    str += "\\f";
-                    break;
-                case '\r':
-                    str += "\\r";
-                    break;
-                case '\t':
-                    str += "\\t";
-                    break;
-                case '\\':
-                    str += "\\\\";
-                    break;
-                case '\"':
-                    str += "\\\"";
-                    break;
-                default:
-                    str += *i;
-                    break;
-                }
+                str += '}';
+                stack.pop_back();
+                continue;
             }
+            if (frame.index++ != 0)
+                str += ',';
+            const dict_t::value_type& member = *frame.member++;
             str += '\"';
+            str += member.first;
+            str += "\":";
+            open(member.second);
         }
-        break;
     }
-    case JValueType::JList:
+}
+
+void JWriter::writePacked(std::string& str, const JObject& jo, size_t begin, size_t count)
+{
+    // Numbers are written the same way as JObjects holding them.
+    std::visit([&str, begin, count](const auto& numbers)
+        {
+            for (size_t i = begin; i < begin + count; i++)
+            {
+                if (i != 0)
+                    str += ',';
+                if constexpr (std::is_same_v<std::decay_t<decltype(numbers)>, std::vector<double>>)
+                    str += std::to_string(static_cast<long double>(numbers[i]));
+                else
+                    str += std::to_string(static_cast<long long>(numbers[i]));
+            }
+        }, std::get_if<packed_t>(&jo.m_value->value)->numbers);
+}
+
+const packed_t* JWriter::getPacked(const JObject& jo)
+{
+    return jo.getType() == JValueType::JList ? std::get_if<packed_t>(&jo.m_value->value) : nullptr;
+}
+
+size_t JWriter::packedSize(const JObject& jo)
+{
+    return packedCount(*std::get_if<packed_t>(&jo.m_value->value));
+}
+
+const shaped_t* JWriter::getShaped(const JObject& jo)
+{
+    if (jo.getType() != JValueType::JDict)
+        return nullptr;
+    return std::get_if<shaped_t>(&jo.m_value->value);
+}
+
+void JWriter::writeString(std::string& str, std::string_view data)
+{
+    // Copies the runs between the characters to escape at once.
+    static const char hex[] = "0123456789abcdef";
+    str += '\"';
+    size_t start = 0;
+    for (size_t i = 0; i < data.size(); i++)
     {
-        const list_t& list = jo.getList();
-        if (list.empty())
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c >= 0x20 && c != '\"' && c != '\\')
+            continue;
+
+        str.append(data.substr(start, i - start));
+        start = i + 1;
+        switch (c)
+        {
+        case '\"':
+            str += "\\\"";
+            break;
+        case '\\':
+            str += "\\\\";
+            break;
+        case '\b':
+            str += "\\b";
+            break;
+        case '\f':
+            str += "\\f";
+            break;
+        case '\n':
+            str += "\\n";
+            break;
+        case '\r':
+            str += "\\r";
+            break;
+        case '\t':
+            str += "\\t";
+            break;
+        default:
         {
-            str += "[]";
+            char escaped[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+            str.append(escaped, sizeof(escaped));
+            break;
         }
-        else
+        }
+    }
+    str.append(data.substr(start));
+    str += '\"';
+}
+
+std::string JWriter::canonicalWrite(const JObject& jo)
+{
+    std::uint64_t digest;
+    return canonicalWrite(jo, digest);
+}
+
+std::string JWriter::canonicalWrite(const JObject& jo, std::uint64_t& digest)
+{
+    struct Frame
+    {
+        const JObject* node;
+        size_t index;
+        std::vector<std::pair<const std::string*, const JObject*>> members; ///< For dict_t: the members in key order.
+        const std::vector<size_t>* order; ///< For shaped dicts: the slots in key order.
+    };
+
+    std::string str;
+    DigestSink sink(str);
+    std::vector<Frame> stack;
+    // Shaped dicts are read in place, and the key order of each shape is worked out once.
+    std::unordered_map<const shape_t*, std::vector<size_t>> orders;
+    auto writeValue = [&sink, &stack, &orders](const JObject& value)
         {
-            str += '[';
-            for (auto itor = list.begin(); itor != list.end(); itor++)
+            if (const packed_t* packed = getPacked(value))
+            {
+                // Packed numbers are written straight from their array.
+                sink.append('[');
+                std::visit([&sink](const auto& numbers)
+                    {
+                        for (size_t i = 0; i < numbers.size(); i++)
+                        {
+                            if (i != 0)
+                                sink.append(',');
+                            if constexpr (std::is_same_v<std::decay_t<decltype(numbers)>, std::vector<double>>)
+                                writeCanonicalDouble(sink, numbers[i]);
+                            else
+                                writeCanonicalInt(sink, numbers[i]);
+                        }
+                    }, packed->numbers);
+                sink.append(']');
+            }
+            else if (value.getType() == JValueType::JList)
+            {
+                sink.append('[');
+                stack.push_back({ &value, 0, {}, nullptr });
+            }
+            else if (const shaped_t* shaped = getShaped(value))
             {
-                str += write(*itor);
-                if (itor + 1 != list.end())
+                sink.append('{');
+                const std::vector<std::string>& keys = shaped->shape->keys;
+                std::vector<size_t>& order = orders[shaped->shape.get()];
+                if (order.size() != keys.size())
                 {
-                    str += ',';
+                    order.resize(keys.size());
+                    for (size_t i = 0; i < order.size(); i++)
+                        order[i] = i;
+                    std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
                 }
+                stack.push_back({ &value, 0, {}, &order });
             }
-            str += ']';
-        }
-        break;
-    }
-    case JValueType::JDict:
+            else if (value.getType() == JValueType::JDict)
+            {
+                sink.append('{');
+                Frame frame{ &value, 0, {}, nullptr };
+                const dict_t& dict = value.getDict();
+                frame.members.reserve(dict.size());
+                for (const auto& [key, member] : dict)
+                    frame.members.emplace_back(&key, &member);
+                std::sort(frame.members.begin(), frame.members.end(),
+                    [](const auto& a, const auto& b) { return *a.first < *b.first; });
+                stack.push_back(std::move(frame));
+            }
+            else
+                writeCanonicalScalar(sink, value);
+        };
+
+    writeValue(jo);
+    while (!stack.empty())
     {
-        const dict_t& dict = jo.getDict();
-        if (dict.empty())
+        Frame& frame = stack.back();
+        if (frame.node->getType() == JValueType::JList)
         {
-            str += "{}";
+            const list_t& list = frame.node->getList();
+            if (frame.index == list.size())
+            {
+                sink.append(']');
+                stack.pop_back();
+                continue;
+            }
+            if (frame.index != 0)
+                sink.append(',');
+            writeValue(list[frame.index++]);
         }
         else
         {
-            str += '{';
-            for (auto itor = dict.begin(), itor2 = dict.begin(); itor != dict.end(); itor++)
+            const shaped_t* shaped = frame.order != nullptr ? getShaped(*frame.node) : nullptr;
+            size_t size = shaped != nullptr ? shaped->values.size() : frame.members.size();
+            if (frame.index == size)
             {
-                str += '\"' + itor->first + "\":" + write(itor->second);
-                itor2 = itor;
-                if (++itor2 != dict.end())
-                {
-                    str += ',';
-                }
+                sink.append('}');
+                stack.pop_back();
+                continue;
+            }
+            if (frame.index != 0)
+                sink.append(',');
+            size_t index = frame.index++;
+            if (shaped != nullptr)
+            {
+                size_t slot = (*frame.order)[index];
+                sink.appendString(shaped->shape->keys[slot]);
+                sink.append(':');
+                writeValue(shaped->values[slot]);
+            }
+            else
+            {
+                sink.appendString(*frame.members[index].first);
+                sink.append(':');
+                writeValue(*frame.members[index].second);
             }
-            str += '}';
         }
-        break;
-    }
-    default:
-        break;
     }
 
-    return std::move(str);
+    digest = sink.digest();
+    return str;
 }
 
 std::string JWriter::formatWrite(const JObject& jo, size_t n)
@@ -900,10 +3333,13 @@ std::string JWriter::formatWrite(const JObject& jo, size_t n)
         str += "null";
         break;
     case JValueType::JInt:
-        str += std::to_string(jo.getInt());
-        break;
     case JValueType::JDouble:
-        str += std::to_string(jo.getDouble());
+        if (std::string_view lexeme = jo.getLexeme(); !lexeme.empty())
+            str += lexeme;
+        else if (jo.getType() == JValueType::JInt)
+            str += std::to_string(jo.getInt());
+        else
+            str += std::to_string(jo.getDouble());
         break;
     case JValueType::JBool:
         if (jo.getBool())
@@ -914,56 +3350,25 @@ std::string JWriter::formatWrite(const JObject& jo, size_t n)
         str += "false";
         break;
     case JValueType::JString:
-    {
-        std::string localString(jo.getString());
-        str += '\"';
-        for (auto i = localString.begin(); i != localString.end(); ++i)
-        {
-            switch (*i)
-            {
-            case 0:
-                throw std::logic_error("Invalid string");
-            case '\n':
-                str += "\\n";
-                break;
-            case '\b':
-                str += "\\b";
-                break;
-            case '\f':
-                str += "\\f";
-                break;
-            case '\r':
-                str += "\\r";
-                break;
-            case '\t':
-                str += "\\t";
-                break;
-            case '\\':
-                str += "\\\\";
-                break;
-            case '\"':
-                str += "\\\"";
-                break;
-            default:
-                str += *i;
-                break;
-            }
-        }
-        str += '\"';
+        writeString(str, jo.getString());
         break;
-    }
     case JValueType::JList:
     {
-        const list_t& list = jo.getList();
+        // The elements of a packed list are made one at a time and not kept.
+        const packed_t* packed = getPacked(jo);
+        size_t size = packed != nullptr ? packedSize(jo) : jo.getList().size();
         str += "[\n";
-        for (auto itor = list.begin(); itor != list.end(); itor++)
+        for (size_t index = 0; index < size; index++)
         {
             for (size_t i = 0; i < n; i++)
             {
                 str += "    ";
             }
-            str += formatWrite(*itor, n + 1);
-            if (itor + 1 != list.end())
+            if (packed != nullptr)
+                str += formatWrite(JObject::packedValue(*packed, index), n + 1);
+            else
+                str += formatWrite(jo.getList()[index], n + 1);
+            if (index + 1 != size)
             {
                 str += ",\n";
             }
@@ -978,20 +3383,31 @@ std::string JWriter::formatWrite(const JObject& jo, size_t n)
     }
     case JValueType::JDict:
     {
-        const dict_t& dict = jo.getDict();
+        // Shaped dicts are read in place, so writing doesn't build their dict_t.
+        auto writeMember = [this, &str, n](const std::string& key, const JObject& value, bool last)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    str += "    ";
+                }
+                str += '\"' + key + "\": " + formatWrite(value, n + 1);
+                if (!last)
+                {
+                    str += ",\n";
+                }
+            };
         str += "{\n";
-        for (auto itor = dict.begin(), itor2 = dict.begin(); itor != dict.end(); itor++)
+        if (const shaped_t* shaped = getShaped(jo))
         {
-            for (size_t i = 0; i < n; i++)
-            {
-                str += "    ";
-            }
-            str += '\"' + itor->first + "\": " + formatWrite(itor->second, n + 1);
-            itor2 = itor;
-            if (++itor2 != dict.end())
-            {
-                str += ",\n";
-            }
+            for (size_t index = 0; index < shaped->values.size(); index++)
+                writeMember(shaped->shape->keys[index], shaped->values[index], index + 1 == shaped->values.size());
+        }
+        else
+        {
+            const dict_t& dict = jo.getDict();
+            size_t index = 0;
+            for (const auto& [key, value] : dict)
+                writeMember(key, value, ++index == dict.size());
         }
         str += '\n';
         for (size_t i = 0; i < n - 1; i++)
@@ -0,0 +1,209 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <QuqiParser/JsonArrayReader.h>
+
+#include <stdexcept>
+
+#define JSON_NAMESPACE_START namespace qjson {
+#define JSON_NAMESPACE_END }
+
+JSON_NAMESPACE_START
+
+JArrayReader::iterator::iterator(JArrayReader* reader)
+    :m_reader(reader)
+{
+}
+
+JArrayReader::iterator::reference JArrayReader::iterator::operator*() const
+{
+    return m_reader->m_current;
+}
+
+JArrayReader::iterator::pointer JArrayReader::iterator::operator->() const
+{
+    return &m_reader->m_current;
+}
+
+JArrayReader::iterator& JArrayReader::iterator::operator++()
+{
+    if (!m_reader->next(m_reader->m_current))
+        m_reader = nullptr;
+    return *this;
+}
+
+void JArrayReader::iterator::operator++(int)
+{
+    ++*this;
+}
+
+bool JArrayReader::iterator::operator==(const iterator& other) const
+{
+    return m_reader == other.m_reader;
+}
+
+JArrayReader::JArrayReader(std::istream& infile, const JParserOptions& options, size_t blockSize)
+    :m_infile(infile),
+    m_parser(options),
+    m_blockSize(blockSize == 0 ? 1 : blockSize)
+{
+}
+
+bool JArrayReader::next(JObject& jo)
+{
+    if (m_done)
+        return false;
+
+    if (!m_started)
+    {
+        if (!skipSpace() || m_buffer[m_pos] != '[')
+            throw std::logic_error("The input isn't a JSON array.");
+        m_pos++;
+        m_started = true;
+    }
+
+    if (!skipSpace())
+        throw std::logic_error("Unexpected end of input.");
+    if (!m_first && m_buffer[m_pos] == ',')
+    {
+        m_pos++;
+        if (!skipSpace())
+            throw std::logic_error("Unexpected end of input.");
+    }
+    else if (!m_first && m_buffer[m_pos] != ']')
+        throw std::logic_error("Expected ',' or ']' after an array element.");
+
+    // A closing bracket right after the opening one or after a comma ends the array.
+    if (m_buffer[m_pos] == ']')
+    {
+        m_pos++;
+        m_done = true;
+        return false;
+    }
+
+    size_t end = scanElement();
+    m_parser.parseInto(std::string_view(m_buffer).substr(m_pos, end - m_pos), jo);
+    m_pos = end;
+    m_first = false;
+    return true;
+}
+
+JArrayReader::iterator JArrayReader::begin()
+{
+    return next(m_current) ? iterator(this) : iterator();
+}
+
+JArrayReader::iterator JArrayReader::end()
+{
+    return iterator();
+}
+
+bool JArrayReader::fill()
+{
+    // The read part of the window is dropped once it is at least half of it,
+    // so each byte is moved a bounded number of times.
+    if (m_pos > 0 && m_pos >= m_buffer.size() - m_pos)
+    {
+        m_buffer.erase(0, m_pos);
+        m_pos = 0;
+    }
+    size_t size = m_buffer.size();
+    m_buffer.resize(size + m_blockSize);
+    m_infile.read(m_buffer.data() + size, m_blockSize);
+    m_buffer.resize(size + static_cast<size_t>(m_infile.gcount()));
+    return m_buffer.size() > size;
+}
+
+bool JArrayReader::skipSpace()
+{
+    while (true)
+    {
+        while (m_pos < m_buffer.size() &&
+               (m_buffer[m_pos] == ' ' || m_buffer[m_pos] == '\t' || m_buffer[m_pos] == '\n' || m_buffer[m_pos] == '\r'))
+            m_pos++;
+        if (m_pos < m_buffer.size())
+            return true;
+        m_buffer.clear();
+        m_pos = 0;
+        if (!fill())
+            return false;
+    }
+}
+
+size_t JArrayReader::scanElement()
+{
+    // Finds where the element starting at m_pos ends, reading more of the
+    // stream as needed. Containers end at their matching bracket; other
+    // values end at the next delimiter outside a string.
+    size_t depth = 0;
+    bool inString = false;
+    bool escape = false;
+    for (size_t i = m_pos; ; i++)
+    {
+        if (i == m_buffer.size())
+        {
+            // Reading more may move the window.
+            size_t scanned = i - m_pos;
+            if (!fill())
+                throw std::logic_error("Unexpected end of input.");
+            i = m_pos + scanned;
+        }
+
+        char c = m_buffer[i];
+        if (inString)
+        {
+            if (escape)
+                escape = false;
+            else if (c == '\\')
+                escape = true;
+            else if (c == '\"')
+            {
+                inString = false;
+                if (depth == 0)
+                    return i + 1;
+            }
+            continue;
+        }
+
+        switch (c)
+        {
+        case '\"':
+            inString = true;
+            break;
+        case '[':
+        case '{':
+            depth++;
+            break;
+        case ']':
+        case '}':
+            if (depth == 0)
+                return i;
+            if (--depth == 0)
+                return i + 1;
+            break;
+        case ',':
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            if (depth == 0)
+                return i;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+JSON_NAMESPACE_END
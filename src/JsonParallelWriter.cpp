@@ -0,0 +1,378 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <QuqiParser/JsonParallelWriter.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#define JSON_NAMESPACE_START namespace qjson {
+#define JSON_NAMESPACE_END }
+
+JSON_NAMESPACE_START
+
+JParallelWriter::JParallelWriter(size_t threadCount, size_t chunkSize)
+    :m_threadCount(threadCount),
+    m_chunkSize(std::max<size_t>(chunkSize, 1))
+{
+    if (m_threadCount == 0)
+        m_threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+JParallelWriter::~JParallelWriter()
+{
+    // Stop and join the workers while the members they wait on still exist.
+    m_workers.clear();
+}
+
+std::string JParallelWriter::write(const JObject& jo)
+{
+    std::vector<std::string> chunks = writeChunks(jo);
+    size_t size = 0;
+    for (const std::string& chunk : chunks)
+        size += chunk.size();
+
+    std::string str;
+    str.reserve(size);
+    for (const std::string& chunk : chunks)
+        str += chunk;
+    return str;
+}
+
+std::vector<std::string> JParallelWriter::writeChunks(const JObject& jo)
+{
+    std::vector<Piece> pieces;
+    std::vector<std::string> chunks;
+    plan(jo, pieces, chunks);
+
+    std::vector<size_t> tasks;
+    for (size_t i = 0; i < pieces.size(); i++)
+    {
+        if (pieces[i].node != nullptr)
+            tasks.push_back(i);
+    }
+
+    std::atomic<size_t> next = 0;
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto work = [&]()
+        {
+            for (size_t task = next++; task < tasks.size(); task = next++)
+            {
+                try
+                {
+                    writePiece(pieces[tasks[task]], chunks[tasks[task]]);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                    next = tasks.size();
+                    return;
+                }
+            }
+        };
+
+    // The calling thread works too, so a single task never wakes a worker.
+    if (m_threadCount > 1 && tasks.size() > 1)
+        run(work);
+    else
+        work();
+
+    if (error)
+        std::rethrow_exception(error);
+    return chunks;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+size_t JParallelWriter::writeTo(int fd, const JObject& jo)
+{
+#ifdef IOV_MAX
+    constexpr size_t maxBuffers = IOV_MAX;
+#else
+    constexpr size_t maxBuffers = 1024;
+#endif
+
+    std::vector<std::string> chunks = writeChunks(jo);
+    std::vector<iovec> buffers;
+    buffers.reserve(chunks.size());
+    for (std::string& chunk : chunks)
+    {
+        if (!chunk.empty())
+            buffers.push_back({ chunk.data(), chunk.size() });
+    }
+
+    size_t total = 0;
+    size_t index = 0;
+    while (index < buffers.size())
+    {
+        ssize_t written = ::writev(fd, buffers.data() + index,
+            static_cast<int>(std::min(buffers.size() - index, maxBuffers)));
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::logic_error("Failed to write the output.");
+        }
+
+        total += static_cast<size_t>(written);
+        size_t left = static_cast<size_t>(written);
+        while (index < buffers.size() && left >= buffers[index].iov_len)
+        {
+            left -= buffers[index].iov_len;
+            index++;
+        }
+        if (left != 0)
+        {
+            buffers[index].iov_base = static_cast<char*>(buffers[index].iov_base) + left;
+            buffers[index].iov_len -= left;
+        }
+    }
+    return total;
+}
+#endif
+
+void JParallelWriter::run(const std::function<void()>& work)
+{
+    std::lock_guard<std::mutex> writing(m_writeMutex);
+    std::unique_lock<std::mutex> lock(m_poolMutex);
+    for (size_t i = m_workers.size() + 1; i < m_threadCount; i++)
+        m_workers.emplace_back([this, generation = m_generation](std::stop_token stop) { serve(stop, generation); });
+
+    // Every worker runs the work, which returns at once when no task is left,
+    // and the write waits for all of them before its tasks go out of scope.
+    m_work = work;
+    m_working = m_workers.size();
+    m_generation++;
+    lock.unlock();
+    m_wake.notify_all();
+    work();
+
+    lock.lock();
+    m_finished.wait(lock, [this] { return m_working == 0; });
+    m_work = nullptr;
+}
+
+void JParallelWriter::serve(std::stop_token stop, size_t generation)
+{
+    std::unique_lock<std::mutex> lock(m_poolMutex);
+    while (m_wake.wait(lock, stop, [this, &generation] { return m_generation != generation; }))
+    {
+        generation = m_generation;
+        lock.unlock();
+        m_work();
+        lock.lock();
+        if (--m_working == 0)
+            m_finished.notify_one();
+    }
+}
+
+size_t JParallelWriter::getThreadCount() const
+{
+    return m_threadCount;
+}
+
+size_t JParallelWriter::getChunkSize() const
+{
+    return m_chunkSize;
+}
+
+void JParallelWriter::plan(const JObject& jo, std::vector<Piece>& pieces, std::vector<std::string>& chunks)
+{
+    auto text = [&pieces, &chunks](std::string_view data)
+        {
+            if (pieces.empty() || pieces.back().node != nullptr)
+            {
+                pieces.emplace_back();
+                chunks.emplace_back();
+            }
+            chunks.back() += data;
+        };
+    auto range = [&pieces, &chunks](const Piece& piece)
+        {
+            if (piece.count == 0)
+                return;
+            pieces.push_back(piece);
+            chunks.emplace_back();
+        };
+    // Estimates the number of values written for an object, counting one level deep.
+    auto weight = [](const JObject& value) -> size_t
+        {
+            if (value.isPacked())
+                return packedSize(value) + 1;
+            if (const shaped_t* shaped = getShaped(value))
+                return shaped->values.size() + 1;
+            if (value.getType() == JValueType::JList)
+                return value.getList().size() + 1;
+            if (value.getType() == JValueType::JDict)
+                return value.getDict().size() + 1;
+            return 1;
+        };
+
+    if (weight(jo) <= m_chunkSize || !jo.getSource().empty())
+    {
+        // Small enough, or copied from the source, in one task: a range over the whole value.
+        range({ &jo, 0, static_cast<size_t>(-1), {} });
+        return;
+    }
+
+    size_t begin = 0;
+    size_t load = 0;
+    if (jo.isPacked())
+    {
+        // Packed numbers are split into ranges of equal size.
+        size_t size = packedSize(jo);
+        text("[");
+        for (; begin < size; begin += m_chunkSize)
+            range({ &jo, begin, std::min(m_chunkSize, size - begin), {} });
+        text("]");
+        return;
+    }
+    const shaped_t* shaped = getShaped(jo);
+    if (jo.getType() == JValueType::JList || shaped != nullptr)
+    {
+        // Shaped dicts are split like lists, in the order of their keys.
+        const list_t& list = shaped != nullptr ? shaped->values : jo.getList();
+        text(shaped != nullptr ? "{" : "[");
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            size_t cost = weight(list[i]);
+            if (cost > m_chunkSize)
+            {
+                range({ &jo, begin, i - begin, {} });
+                if (i != 0)
+                    text(",");
+                if (shaped != nullptr)
+                {
+                    text("\"");
+                    text(shaped->shape->keys[i]);
+                    text("\":");
+                }
+                plan(list[i], pieces, chunks);
+                begin = i + 1;
+                load = 0;
+                continue;
+            }
+
+            load += cost;
+            if (load >= m_chunkSize)
+            {
+                range({ &jo, begin, i + 1 - begin, {} });
+                begin = i + 1;
+                load = 0;
+            }
+        }
+        range({ &jo, begin, list.size() - begin, {} });
+        text(shaped != nullptr ? "}" : "]");
+        return;
+    }
+
+    const dict_t& dict = jo.getDict();
+    auto first = dict.begin();
+    size_t i = 0;
+    text("{");
+    for (auto itor = dict.begin(); itor != dict.end(); ++itor, i++)
+    {
+        size_t cost = weight(itor->second);
+        if (cost > m_chunkSize)
+        {
+            range({ &jo, begin, i - begin, first });
+            if (i != 0)
+                text(",");
+            text("\"");
+            text(itor->first);
+            text("\":");
+            plan(itor->second, pieces, chunks);
+            begin = i + 1;
+            first = std::next(itor);
+            load = 0;
+            continue;
+        }
+
+        load += cost;
+        if (load >= m_chunkSize)
+        {
+            range({ &jo, begin, i + 1 - begin, first });
+            begin = i + 1;
+            first = std::next(itor);
+            load = 0;
+        }
+    }
+    range({ &jo, begin, i - begin, first });
+    text("}");
+}
+
+void JParallelWriter::writePiece(const Piece& piece, std::string& str)
+{
+    if (piece.count == static_cast<size_t>(-1))
+    {
+        writeValue(str, *piece.node);
+        return;
+    }
+
+    if (piece.node->isPacked())
+    {
+        writePacked(str, *piece.node, piece.begin, piece.count);
+        return;
+    }
+    if (const shaped_t* shaped = getShaped(*piece.node))
+    {
+        for (size_t i = piece.begin; i < piece.begin + piece.count; i++)
+        {
+            if (i != 0)
+                str += ',';
+            str += '\"';
+            str += shaped->shape->keys[i];
+            str += "\":";
+            writeValue(str, shaped->values[i]);
+        }
+        return;
+    }
+    if (piece.node->getType() == JValueType::JList)
+    {
+        const list_t& list = piece.node->getList();
+        for (size_t i = piece.begin; i < piece.begin + piece.count; i++)
+        {
+            if (i != 0)
+                str += ',';
+            writeValue(str, list[i]);
+        }
+        return;
+    }
+
+    auto itor = piece.member;
+    for (size_t i = piece.begin; i < piece.begin + piece.count; i++, ++itor)
+    {
+        if (i != 0)
+            str += ',';
+        str += '\"';
+        str += itor->first;
+        str += "\":";
+        writeValue(str, itor->second);
+    }
+}
+
+JSON_NAMESPACE_END
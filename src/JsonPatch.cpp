@@ -0,0 +1,538 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <QuqiParser/JsonPatch.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#define JSON_NAMESPACE_START namespace qjson {
+#define JSON_NAMESPACE_END }
+
+JSON_NAMESPACE_START
+
+void JPatch::apply(JObject& document, const JObject& patch)
+{
+    if (patch.getType() != JValueType::JList)
+        throw std::logic_error("The patch isn't JList.");
+
+    // Every change is recorded with its inverse, so a failing operation
+    // rolls the document back without having copied it up front.
+    std::vector<Undo> undo;
+    try
+    {
+        for (const auto& operation : patch.getList())
+        {
+            if (operation.getType() != JValueType::JDict)
+                throw std::logic_error("The patch operation isn't JDict.");
+            const std::string& op = getMember(operation, "op").getString();
+            pointer_t path = parsePointer(getMember(operation, "path").getString());
+
+            if (op == "add")
+                add(document, std::move(path), getMember(operation, "value"), undo);
+            else if (op == "remove")
+                remove(document, path, undo);
+            else if (op == "replace")
+                replace(document, path, getMember(operation, "value"), undo);
+            else if (op == "move")
+            {
+                pointer_t from = parsePointer(getMember(operation, "from").getString());
+                if (from == path)
+                    continue;
+                if (from.size() < path.size() && std::equal(from.begin(), from.end(), path.begin()))
+                    throw std::logic_error("Cannot move a value into one of its children.");
+                JObject value = remove(document, from, undo);
+                add(document, std::move(path), std::move(value), undo);
+            }
+            else if (op == "copy")
+            {
+                pointer_t from = parsePointer(getMember(operation, "from").getString());
+                add(document, std::move(path), get(document, from), undo);
+            }
+            else if (op == "test")
+            {
+                if (!(get(document, path) == getMember(operation, "value")))
+                    throw std::logic_error("The patch test failed.");
+            }
+            else
+                throw std::logic_error("Invalid patch operation: " + op);
+        }
+    }
+    catch (...)
+    {
+        rollback(document, undo);
+        throw;
+    }
+}
+
+JObject JPatch::diff(const JObject& from, const JObject& to)
+{
+    struct Pending
+    {
+        std::string path;
+        const JObject* from;
+        const JObject* to;
+    };
+
+    auto same = [](const JObject& a, const JObject& b)
+        {
+            return (a.m_type == b.m_type && a.m_value == b.m_value) || a == b;
+        };
+
+    JObject result(JValueType::JList);
+    list_t& operations = *std::get_if<list_t>(&result.mutableValue());
+    std::vector<Pending> pending;
+    pending.push_back({ "", &from, &to });
+    while (!pending.empty())
+    {
+        Pending current = std::move(pending.back());
+        pending.pop_back();
+        const JObject& a = *current.from;
+        const JObject& b = *current.to;
+
+        // Shared subtrees are identical, whatever their size.
+        if (a.m_type == b.m_type && a.m_value == b.m_value)
+            continue;
+
+        if (a.m_type != b.m_type || (a.m_type != JValueType::JList && a.m_type != JValueType::JDict))
+        {
+            if (!(a == b))
+                operations.push_back(makeOperation("replace", current.path, &b));
+            continue;
+        }
+
+        if (a.m_type == JValueType::JDict)
+        {
+            const dict_t& aDict = a.getDict();
+            const dict_t& bDict = b.getDict();
+            for (const auto& [key, value] : aDict)
+            {
+                auto found = bDict.find(key);
+                if (found == bDict.end())
+                    operations.push_back(makeOperation("remove", appendToken(current.path, key), nullptr));
+                else
+                    pending.push_back({ appendToken(current.path, key), &value, &found->second });
+            }
+            for (const auto& [key, value] : bDict)
+            {
+                if (aDict.find(key) == aDict.end())
+                    operations.push_back(makeOperation("add", appendToken(current.path, key), &value));
+            }
+            continue;
+        }
+
+        if (std::holds_alternative<packed_t>(a.m_value->value) || std::holds_alternative<packed_t>(b.m_value->value))
+        {
+            diffPacked(operations, current.path, a, b);
+            continue;
+        }
+
+        // Lists: skip the common prefix and suffix, pair up the elements in
+        // between, and remove or append the rest. Paired elements come before
+        // every removed or added index, so the operations don't shift them.
+        const list_t& aList = a.getList();
+        const list_t& bList = b.getList();
+        size_t prefix = 0;
+        while (prefix < aList.size() && prefix < bList.size() && same(aList[prefix], bList[prefix]))
+            prefix++;
+        size_t suffix = 0;
+        while (suffix < aList.size() - prefix && suffix < bList.size() - prefix &&
+            same(aList[aList.size() - 1 - suffix], bList[bList.size() - 1 - suffix]))
+            suffix++;
+
+        size_t aCount = aList.size() - prefix - suffix;
+        size_t bCount = bList.size() - prefix - suffix;
+        size_t paired = std::min(aCount, bCount);
+        for (size_t i = 0; i < paired; i++)
+            pending.push_back({ appendToken(current.path, std::to_string(prefix + i)), &aList[prefix + i], &bList[prefix + i] });
+        for (size_t i = paired; i < aCount; i++)
+            operations.push_back(makeOperation("remove", appendToken(current.path, std::to_string(prefix + paired)), nullptr));
+        for (size_t i = paired; i < bCount; i++)
+            operations.push_back(makeOperation("add", appendToken(current.path, std::to_string(prefix + i)), &bList[prefix + i]));
+    }
+    return result;
+}
+
+void JPatch::diffPacked(list_t& operations, const std::string& path, const JObject& from, const JObject& to)
+{
+    // Lists are paired up as in diff(), but one of them is packed, so every
+    // pair has a number on one side and is compared here. Packed elements are
+    // made one at a time and not kept.
+    auto element = [](const JObject& list, size_t index)
+        {
+            if (const packed_t* packed = std::get_if<packed_t>(&list.m_value->value))
+                return JObject::packedValue(*packed, index);
+            return (*std::get_if<list_t>(&list.m_value->value))[index];
+        };
+
+    size_t aSize = JObject::listSize(from);
+    size_t bSize = JObject::listSize(to);
+    size_t prefix = 0;
+    while (prefix < aSize && prefix < bSize && element(from, prefix) == element(to, prefix))
+        prefix++;
+    size_t suffix = 0;
+    while (suffix < aSize - prefix && suffix < bSize - prefix &&
+        element(from, aSize - 1 - suffix) == element(to, bSize - 1 - suffix))
+        suffix++;
+
+    size_t aCount = aSize - prefix - suffix;
+    size_t bCount = bSize - prefix - suffix;
+    size_t paired = std::min(aCount, bCount);
+    for (size_t i = 0; i < paired; i++)
+    {
+        JObject value = element(to, prefix + i);
+        if (!(element(from, prefix + i) == value))
+            operations.push_back(makeOperation("replace", appendToken(path, std::to_string(prefix + i)), &value));
+    }
+    for (size_t i = paired; i < aCount; i++)
+        operations.push_back(makeOperation("remove", appendToken(path, std::to_string(prefix + paired)), nullptr));
+    for (size_t i = paired; i < bCount; i++)
+    {
+        JObject value = element(to, prefix + i);
+        operations.push_back(makeOperation("add", appendToken(path, std::to_string(prefix + i)), &value));
+    }
+}
+
+void JPatch::applyMerge(JObject& document, const JObject& patch)
+{
+    std::vector<std::pair<JObject*, const JObject*>> pending;
+    pending.emplace_back(&document, &patch);
+    while (!pending.empty())
+    {
+        auto [target, source] = pending.back();
+        pending.pop_back();
+
+        if (source->getType() != JValueType::JDict)
+        {
+            *target = *source;
+            continue;
+        }
+        if (target->getType() != JValueType::JDict)
+            *target = JObject(JValueType::JDict);
+
+        dict_t& dict = *std::get_if<dict_t>(&target->mutableValue());
+        for (const auto& [key, value] : source->getDict())
+        {
+            if (value.getType() == JValueType::JNull)
+                dict.erase(key);
+            else if (value.getType() == JValueType::JDict)
+                pending.emplace_back(&dict[key], &value);
+            else
+                dict[key] = value;
+        }
+    }
+}
+
+JObject JPatch::mergeDiff(const JObject& from, const JObject& to)
+{
+    struct Pending
+    {
+        JObject* target;
+        const JObject* from;
+        const JObject* to;
+    };
+
+    JObject result;
+    std::vector<Pending> pending;
+    // Nested patches in creation order, so that empty ones can be pruned
+    // children first once everything has been compared.
+    std::vector<std::pair<dict_t*, const std::string*>> nested;
+    pending.push_back({ &result, &from, &to });
+    while (!pending.empty())
+    {
+        Pending current = pending.back();
+        pending.pop_back();
+
+        if (current.from->getType() != JValueType::JDict || current.to->getType() != JValueType::JDict)
+        {
+            *current.target = *current.to;
+            continue;
+        }
+
+        *current.target = JObject(JValueType::JDict);
+        dict_t& patch = *std::get_if<dict_t>(&current.target->mutableValue());
+        const dict_t& fromDict = current.from->getDict();
+        const dict_t& toDict = current.to->getDict();
+        for (const auto& [key, value] : fromDict)
+        {
+            if (toDict.find(key) == toDict.end())
+                patch.emplace(key, JObject());
+        }
+        for (const auto& [key, value] : toDict)
+        {
+            auto found = fromDict.find(key);
+            if (found == fromDict.end())
+            {
+                if (value.getType() != JValueType::JNull)
+                    patch.emplace(key, value);
+            }
+            else if (found->second.m_type == value.m_type && found->second.m_value == value.m_value)
+                continue;
+            else if (found->second.getType() == JValueType::JDict && value.getType() == JValueType::JDict)
+            {
+                auto slot = patch.emplace(key, JObject()).first;
+                nested.emplace_back(&patch, &slot->first);
+                pending.push_back({ &slot->second, &found->second, &value });
+            }
+            else if (!(found->second == value))
+                patch.emplace(key, value);
+        }
+    }
+
+    for (auto itor = nested.rbegin(); itor != nested.rend(); itor++)
+    {
+        auto [parent, key] = *itor;
+        auto found = parent->find(*key);
+        if (found->second.getType() == JValueType::JDict && found->second.getDict().empty())
+            parent->erase(found);
+    }
+    return result;
+}
+
+JPatch::pointer_t JPatch::parsePointer(std::string_view pointer)
+{
+    pointer_t path;
+    if (pointer.empty())
+        return path;
+    if (pointer.front() != '/')
+        throw std::logic_error("Invalid JSON pointer: " + std::string(pointer));
+
+    size_t itor = 1;
+    while (true)
+    {
+        std::string token;
+        while (itor < pointer.size() && pointer[itor] != '/')
+        {
+            if (pointer[itor] == '~')
+            {
+                itor++;
+                if (itor < pointer.size() && pointer[itor] == '0')
+                    token += '~';
+                else if (itor < pointer.size() && pointer[itor] == '1')
+                    token += '/';
+                else
+                    throw std::logic_error("Invalid JSON pointer: " + std::string(pointer));
+            }
+            else
+                token += pointer[itor];
+            itor++;
+        }
+        path.push_back(std::move(token));
+        if (itor >= pointer.size())
+            return path;
+        itor++;
+    }
+}
+
+std::string JPatch::appendToken(const std::string& pointer, std::string_view token)
+{
+    std::string result(pointer);
+    result += '/';
+    for (char c : token)
+    {
+        if (c == '~')
+            result += "~0";
+        else if (c == '/')
+            result += "~1";
+        else
+            result += c;
+    }
+    return result;
+}
+
+size_t JPatch::getIndex(size_t size, const std::string& token, bool allowEnd)
+{
+    if (allowEnd && token == "-")
+        return size;
+    if (token.empty() || token.size() > 18 || (token.size() > 1 && token.front() == '0'))
+        throw std::logic_error("Invalid list index: " + token);
+
+    size_t index = 0;
+    for (char c : token)
+    {
+        if (c < '0' || c > '9')
+            throw std::logic_error("Invalid list index: " + token);
+        index = index * 10 + (c - '0');
+    }
+    if (index > size || (index == size && !allowEnd))
+        throw std::logic_error("The list index is out of range: " + token);
+    return index;
+}
+
+JObject& JPatch::resolve(JObject& document, const pointer_t& path, size_t length)
+{
+    // Walks through the values without handing out references, so the
+    // visited containers stay shareable.
+    JObject* node = &document;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (node->getType() == JValueType::JDict)
+        {
+            dict_t& dict = *std::get_if<dict_t>(&node->mutableValue());
+            auto found = dict.find(path[i]);
+            if (found == dict.end())
+                throw std::logic_error("The path doesn't exist: " + path[i]);
+            node = &found->second;
+        }
+        else if (node->getType() == JValueType::JList)
+        {
+            list_t& list = *std::get_if<list_t>(&node->mutableValue());
+            node = &list[getIndex(list.size(), path[i], false)];
+        }
+        else
+            throw std::logic_error("The path doesn't exist: " + path[i]);
+    }
+    return *node;
+}
+
+const JObject& JPatch::get(const JObject& document, const pointer_t& path)
+{
+    const JObject* node = &document;
+    for (const auto& token : path)
+    {
+        if (node->getType() == JValueType::JDict)
+        {
+            const dict_t& dict = node->getDict();
+            auto found = dict.find(token);
+            if (found == dict.end())
+                throw std::logic_error("The path doesn't exist: " + token);
+            node = &found->second;
+        }
+        else if (node->getType() == JValueType::JList)
+        {
+            // A packed list hands out the element without building the others.
+            node = &(*node)[getIndex(JObject::listSize(*node), token, false)];
+        }
+        else
+            throw std::logic_error("The path doesn't exist: " + token);
+    }
+    return *node;
+}
+
+void JPatch::add(JObject& document, pointer_t path, JObject value, std::vector<Undo>& undo)
+{
+    if (path.empty())
+    {
+        undo.push_back({ Undo::Replace, {}, std::move(document) });
+        document = std::move(value);
+        return;
+    }
+
+    JObject& parent = resolve(document, path, path.size() - 1);
+    if (parent.getType() == JValueType::JDict)
+    {
+        dict_t& dict = *std::get_if<dict_t>(&parent.mutableValue());
+        auto [itor, inserted] = dict.try_emplace(path.back());
+        if (inserted)
+            undo.push_back({ Undo::Remove, std::move(path), JObject() });
+        else
+            undo.push_back({ Undo::Replace, std::move(path), std::move(itor->second) });
+        itor->second = std::move(value);
+    }
+    else if (parent.getType() == JValueType::JList)
+    {
+        list_t& list = *std::get_if<list_t>(&parent.mutableValue());
+        size_t index = getIndex(list.size(), path.back(), true);
+        list.insert(list.begin() + index, std::move(value));
+        path.back() = std::to_string(index);
+        undo.push_back({ Undo::Remove, std::move(path), JObject() });
+    }
+    else
+        throw std::logic_error("The path doesn't exist: " + path.back());
+}
+
+JObject JPatch::remove(JObject& document, const pointer_t& path, std::vector<Undo>& undo)
+{
+    if (path.empty())
+        throw std::logic_error("Cannot remove the whole document.");
+
+    JObject value;
+    JObject& parent = resolve(document, path, path.size() - 1);
+    if (parent.getType() == JValueType::JDict)
+    {
+        dict_t& dict = *std::get_if<dict_t>(&parent.mutableValue());
+        auto found = dict.find(path.back());
+        if (found == dict.end())
+            throw std::logic_error("The path doesn't exist: " + path.back());
+        value = std::move(found->second);
+        dict.erase(found);
+        undo.push_back({ Undo::Add, path, value });
+    }
+    else if (parent.getType() == JValueType::JList)
+    {
+        list_t& list = *std::get_if<list_t>(&parent.mutableValue());
+        size_t index = getIndex(list.size(), path.back(), false);
+        value = std::move(list[index]);
+        list.erase(list.begin() + index);
+        undo.push_back({ Undo::Add, path, value });
+    }
+    else
+        throw std::logic_error("The path doesn't exist: " + path.back());
+    return value;
+}
+
+void JPatch::replace(JObject& document, const pointer_t& path, JObject value, std::vector<Undo>& undo)
+{
+    JObject& target = resolve(document, path, path.size());
+    undo.push_back({ Undo::Replace, path, std::move(target) });
+    target = std::move(value);
+}
+
+void JPatch::rollback(JObject& document, std::vector<Undo>& undo)
+{
+    std::vector<Undo> ignored;
+    for (auto itor = undo.rbegin(); itor != undo.rend(); itor++)
+    {
+        switch (itor->kind)
+        {
+        case Undo::Add:
+            add(document, std::move(itor->path), std::move(itor->value), ignored);
+            break;
+        case Undo::Remove:
+            remove(document, itor->path, ignored);
+            break;
+        case Undo::Replace:
+            resolve(document, itor->path, itor->path.size()) = std::move(itor->value);
+            break;
+        }
+        ignored.clear();
+    }
+    undo.clear();
+}
+
+const JObject& JPatch::getMember(const JObject& operation, const char* name)
+{
+    const dict_t& dict = operation.getDict();
+    auto found = dict.find(name);
+    if (found == dict.end())
+        throw std::logic_error(std::string("The patch operation has no member: ") + name);
+    return found->second;
+}
+
+JObject JPatch::makeOperation(const char* op, const std::string& path, const JObject* value)
+{
+    JObject operation(JValueType::JDict);
+    setMember(operation, "op", op);
+    setMember(operation, "path", path);
+    if (value != nullptr)
+        setMember(operation, "value", *value);
+    return operation;
+}
+
+void JPatch::setMember(JObject& dict, const std::string& key, JObject value)
+{
+    std::get_if<dict_t>(&dict.mutableValue())->insert_or_assign(key, std::move(value));
+}
+
+JSON_NAMESPACE_END
@@ -0,0 +1,954 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <QuqiParser/JsonPersistent.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#define JSON_NAMESPACE_START namespace qjson {
+#define JSON_NAMESPACE_END }
+
+JSON_NAMESPACE_START
+
+namespace
+{
+    constexpr unsigned branchBits = 5;
+    constexpr size_t branchSize = size_t(1) << branchBits;
+    constexpr size_t branchMask = branchSize - 1;
+    constexpr unsigned hashBits = sizeof(size_t) * 8;
+
+    size_t hashKey(std::string_view key)
+    {
+        return std::hash<std::string_view>{}(key);
+    }
+
+    std::uint32_t fragmentBit(size_t hash, unsigned shift)
+    {
+        return std::uint32_t(1) << ((hash >> shift) & branchMask);
+    }
+
+    size_t bitIndex(std::uint32_t map, std::uint32_t bit)
+    {
+        return std::popcount(map & (bit - 1));
+    }
+}
+
+/**
+ * @brief Node of the radix balanced tree: inner nodes hold children, leaves hold elements.
+ */
+struct JPersistentObject::ListNode
+{
+    ~ListNode();
+
+    std::vector<std::shared_ptr<const ListNode>> children;
+    std::vector<JPersistentObject> values;
+};
+
+/**
+ * @brief Node of the hash array mapped trie.
+ *
+ * Each of the 32 slots selected by five bits of the key hash holds either a
+ * member (dataMap) or a child node (nodeMap). Below the last hash bits a
+ * node is a collision node whose members are searched linearly.
+ */
+struct JPersistentObject::DictNode
+{
+    struct Entry
+    {
+        size_t hash;
+        std::string key;
+        JPersistentObject value;
+    };
+
+    ~DictNode();
+
+    std::uint32_t dataMap = 0;
+    std::uint32_t nodeMap = 0;
+    std::vector<Entry> entries;
+    std::vector<std::shared_ptr<const DictNode>> children;
+};
+
+JPersistentObject::JPersistentObject()
+    :m_type(JValueType::JNull)
+{
+}
+
+JPersistentObject::JPersistentObject(JValueType jvt)
+    :m_type(jvt)
+{
+    switch (jvt)
+    {
+    case JValueType::JInt:
+        m_value = int_t();
+        break;
+    case JValueType::JDouble:
+        m_value = double_t();
+        break;
+    case JValueType::JBool:
+        m_value = bool_t();
+        break;
+    case JValueType::JString:
+        m_value = std::make_shared<const std::string>();
+        break;
+    case JValueType::JList:
+        m_value = ListRoot();
+        break;
+    case JValueType::JDict:
+        m_value = DictRoot();
+        break;
+    default:
+        break;
+    }
+}
+
+JPersistentObject::JPersistentObject(long long value)
+    :m_type(JValueType::JInt),
+    m_value(std::in_place_type<int_t>, value)
+{
+}
+
+JPersistentObject::JPersistentObject(int value)
+    :m_type(JValueType::JInt),
+    m_value(std::in_place_type<int_t>, value)
+{
+}
+
+JPersistentObject::JPersistentObject(bool value)
+    :m_type(JValueType::JBool),
+    m_value(std::in_place_type<bool_t>, value)
+{
+}
+
+JPersistentObject::JPersistentObject(long double value)
+    :m_type(JValueType::JDouble),
+    m_value(std::in_place_type<double_t>, value)
+{
+}
+
+JPersistentObject::JPersistentObject(double value)
+    :m_type(JValueType::JDouble),
+    m_value(std::in_place_type<double_t>, value)
+{
+}
+
+JPersistentObject::JPersistentObject(const char* data)
+    :m_type(JValueType::JString),
+    m_value(std::make_shared<const std::string>(data))
+{
+}
+
+JPersistentObject::JPersistentObject(std::string_view data)
+    :m_type(JValueType::JString),
+    m_value(std::make_shared<const std::string>(data))
+{
+}
+
+JPersistentObject::JPersistentObject(std::string data)
+    :m_type(JValueType::JString),
+    m_value(std::make_shared<const std::string>(std::move(data)))
+{
+}
+
+/**
+ * @brief Tree algorithms shared by the members of JPersistentObject.
+ */
+struct JPersistentObject::Impl
+{
+    using Entry = DictNode::Entry;
+    using ListPtr = std::shared_ptr<const ListNode>;
+    using DictPtr = std::shared_ptr<const DictNode>;
+
+    static ListPtr newPath(unsigned level, JPersistentObject&& value)
+    {
+        auto node = std::make_shared<ListNode>();
+        if (level == 0)
+            node->values.push_back(std::move(value));
+        else
+            node->children.push_back(newPath(level - branchBits, std::move(value)));
+        return node;
+    }
+
+    static ListPtr setIn(const ListPtr& node, unsigned level, size_t index, JPersistentObject&& value)
+    {
+        auto copy = std::make_shared<ListNode>(*node);
+        size_t slot = (index >> level) & branchMask;
+        if (level == 0)
+            copy->values[slot] = std::move(value);
+        else
+            copy->children[slot] = setIn(node->children[slot], level - branchBits, index, std::move(value));
+        return copy;
+    }
+
+    static ListPtr pushIn(const ListPtr& node, unsigned level, size_t index, JPersistentObject&& value)
+    {
+        auto copy = std::make_shared<ListNode>(*node);
+        if (level == 0)
+        {
+            copy->values.push_back(std::move(value));
+            return copy;
+        }
+        size_t slot = (index >> level) & branchMask;
+        if (slot < copy->children.size())
+            copy->children[slot] = pushIn(node->children[slot], level - branchBits, index, std::move(value));
+        else
+            copy->children.push_back(newPath(level - branchBits, std::move(value)));
+        return copy;
+    }
+
+    static ListPtr popIn(const ListPtr& node, unsigned level, size_t index)
+    {
+        auto copy = std::make_shared<ListNode>(*node);
+        if (level == 0)
+        {
+            copy->values.pop_back();
+            return copy->values.empty() ? nullptr : copy;
+        }
+        size_t slot = (index >> level) & branchMask;
+        ListPtr child = popIn(node->children[slot], level - branchBits, index);
+        if (child)
+            copy->children[slot] = std::move(child);
+        else
+            copy->children.pop_back();
+        return copy->children.empty() ? nullptr : copy;
+    }
+
+    static ListRoot buildList(std::vector<JPersistentObject>&& values)
+    {
+        ListRoot list;
+        list.size = values.size();
+        if (values.empty())
+            return list;
+
+        std::vector<ListPtr> level;
+        for (size_t i = 0; i < values.size(); i += branchSize)
+        {
+            auto leaf = std::make_shared<ListNode>();
+            size_t end = std::min(values.size(), i + branchSize);
+            leaf->values.assign(std::make_move_iterator(values.begin() + i),
+                std::make_move_iterator(values.begin() + end));
+            level.push_back(std::move(leaf));
+        }
+        while (level.size() > 1)
+        {
+            std::vector<ListPtr> parents;
+            for (size_t i = 0; i < level.size(); i += branchSize)
+            {
+                auto parent = std::make_shared<ListNode>();
+                size_t end = std::min(level.size(), i + branchSize);
+                parent->children.assign(std::make_move_iterator(level.begin() + i),
+                    std::make_move_iterator(level.begin() + end));
+                parents.push_back(std::move(parent));
+            }
+            level = std::move(parents);
+            list.shift += branchBits;
+        }
+        list.root = std::move(level.front());
+        return list;
+    }
+
+    static void forEachIn(const ListNode* node, const std::function<void(const JPersistentObject&)>& func)
+    {
+        for (const auto& value : node->values)
+            func(value);
+        for (const auto& child : node->children)
+            forEachIn(child.get(), func);
+    }
+
+    static const JPersistentObject* findIn(const DictNode* node, size_t hash, std::string_view key)
+    {
+        for (unsigned shift = 0; node != nullptr; shift += branchBits)
+        {
+            if (shift >= hashBits)
+            {
+                for (const auto& entry : node->entries)
+                {
+                    if (entry.key == key)
+                        return &entry.value;
+                }
+                return nullptr;
+            }
+
+            std::uint32_t bit = fragmentBit(hash, shift);
+            if (node->dataMap & bit)
+            {
+                const Entry& entry = node->entries[bitIndex(node->dataMap, bit)];
+                return entry.hash == hash && entry.key == key ? &entry.value : nullptr;
+            }
+            if (!(node->nodeMap & bit))
+                return nullptr;
+            node = node->children[bitIndex(node->nodeMap, bit)].get();
+        }
+        return nullptr;
+    }
+
+    static DictPtr mergeEntries(Entry&& first, Entry&& second, unsigned shift)
+    {
+        auto node = std::make_shared<DictNode>();
+        if (shift >= hashBits)
+        {
+            node->entries.push_back(std::move(first));
+            node->entries.push_back(std::move(second));
+            return node;
+        }
+
+        std::uint32_t firstBit = fragmentBit(first.hash, shift);
+        std::uint32_t secondBit = fragmentBit(second.hash, shift);
+        if (firstBit == secondBit)
+        {
+            node->nodeMap = firstBit;
+            node->children.push_back(mergeEntries(std::move(first), std::move(second), shift + branchBits));
+            return node;
+        }
+        node->dataMap = firstBit | secondBit;
+        if (firstBit < secondBit)
+        {
+            node->entries.push_back(std::move(first));
+            node->entries.push_back(std::move(second));
+        }
+        else
+        {
+            node->entries.push_back(std::move(second));
+            node->entries.push_back(std::move(first));
+        }
+        return node;
+    }
+
+    static DictPtr assocIn(const DictNode* node, unsigned shift, Entry&& entry, bool& added)
+    {
+        auto copy = node ? std::make_shared<DictNode>(*node) : std::make_shared<DictNode>();
+        if (shift >= hashBits)
+        {
+            for (auto& existing : copy->entries)
+            {
+                if (existing.key == entry.key)
+                {
+                    existing.value = std::move(entry.value);
+                    return copy;
+                }
+            }
+            copy->entries.push_back(std::move(entry));
+            added = true;
+            return copy;
+        }
+
+        std::uint32_t bit = fragmentBit(entry.hash, shift);
+        if (copy->dataMap & bit)
+        {
+            size_t index = bitIndex(copy->dataMap, bit);
+            Entry& existing = copy->entries[index];
+            if (existing.hash == entry.hash && existing.key == entry.key)
+            {
+                existing.value = std::move(entry.value);
+                return copy;
+            }
+
+            DictPtr child = mergeEntries(std::move(existing), std::move(entry), shift + branchBits);
+            copy->entries.erase(copy->entries.begin() + index);
+            copy->dataMap ^= bit;
+            copy->children.insert(copy->children.begin() + bitIndex(copy->nodeMap, bit), std::move(child));
+            copy->nodeMap |= bit;
+            added = true;
+        }
+        else if (copy->nodeMap & bit)
+        {
+            size_t index = bitIndex(copy->nodeMap, bit);
+            copy->children[index] = assocIn(copy->children[index].get(), shift + branchBits, std::move(entry), added);
+        }
+        else
+        {
+            copy->entries.insert(copy->entries.begin() + bitIndex(copy->dataMap, bit), std::move(entry));
+            copy->dataMap |= bit;
+            added = true;
+        }
+        return copy;
+    }
+
+    static DictPtr dissocIn(const DictPtr& node, unsigned shift, size_t hash, std::string_view key, bool& removed)
+    {
+        if (shift >= hashBits)
+        {
+            for (size_t i = 0; i < node->entries.size(); i++)
+            {
+                if (node->entries[i].key == key)
+                {
+                    removed = true;
+                    if (node->entries.size() == 1)
+                        return nullptr;
+                    auto copy = std::make_shared<DictNode>(*node);
+                    copy->entries.erase(copy->entries.begin() + i);
+                    return copy;
+                }
+            }
+            return node;
+        }
+
+        std::uint32_t bit = fragmentBit(hash, shift);
+        if (node->dataMap & bit)
+        {
+            size_t index = bitIndex(node->dataMap, bit);
+            const Entry& existing = node->entries[index];
+            if (existing.hash != hash || existing.key != key)
+                return node;
+
+            removed = true;
+            if (node->entries.size() == 1 && node->children.empty())
+                return nullptr;
+            auto copy = std::make_shared<DictNode>(*node);
+            copy->entries.erase(copy->entries.begin() + index);
+            copy->dataMap ^= bit;
+            return copy;
+        }
+        if (!(node->nodeMap & bit))
+            return node;
+
+        size_t index = bitIndex(node->nodeMap, bit);
+        DictPtr child = dissocIn(node->children[index], shift + branchBits, hash, key, removed);
+        if (!removed)
+            return node;
+
+        auto copy = std::make_shared<DictNode>(*node);
+        if (child && (!child->children.empty() || child->entries.size() > 1))
+        {
+            copy->children[index] = std::move(child);
+            return copy;
+        }
+
+        // The child is empty or holds a single member: pull that member up.
+        copy->children.erase(copy->children.begin() + index);
+        copy->nodeMap ^= bit;
+        if (child)
+        {
+            copy->entries.insert(copy->entries.begin() + bitIndex(copy->dataMap, bit), child->entries.front());
+            copy->dataMap |= bit;
+        }
+        if (copy->entries.empty() && copy->children.empty())
+            return nullptr;
+        return copy;
+    }
+
+    static DictPtr buildDict(std::vector<Entry>&& entries, unsigned shift)
+    {
+        if (entries.empty())
+            return nullptr;
+
+        auto node = std::make_shared<DictNode>();
+        if (shift >= hashBits)
+        {
+            node->entries = std::move(entries);
+            return node;
+        }
+
+        std::vector<Entry> buckets[branchSize];
+        for (auto& entry : entries)
+            buckets[(entry.hash >> shift) & branchMask].push_back(std::move(entry));
+        for (size_t i = 0; i < branchSize; i++)
+        {
+            if (buckets[i].size() == 1)
+            {
+                node->dataMap |= std::uint32_t(1) << i;
+                node->entries.push_back(std::move(buckets[i].front()));
+            }
+            else if (buckets[i].size() > 1)
+            {
+                node->nodeMap |= std::uint32_t(1) << i;
+                node->children.push_back(buildDict(std::move(buckets[i]), shift + branchBits));
+            }
+        }
+        return node;
+    }
+
+    static void forEachIn(const DictNode* node,
+        const std::function<void(const std::string&, const JPersistentObject&)>& func)
+    {
+        for (const auto& entry : node->entries)
+            func(entry.key, entry.value);
+        for (const auto& child : node->children)
+            forEachIn(child.get(), func);
+    }
+
+    /**
+     * @brief Nodes whose last owner is gone, freed in a loop instead of by recursion.
+     *
+     * Nodes are only ever created mutable, so the const can be cast away
+     * once nothing else owns them.
+     */
+    struct Teardown
+    {
+        std::vector<ListPtr> lists;
+        std::vector<DictPtr> dicts;
+
+        void take(ListPtr& node)
+        {
+            if (node && node.use_count() == 1)
+                lists.push_back(std::move(node));
+        }
+
+        void take(DictPtr& node)
+        {
+            if (node && node.use_count() == 1)
+                dicts.push_back(std::move(node));
+        }
+
+        void take(JPersistentObject& value)
+        {
+            if (ListRoot* list = std::get_if<ListRoot>(&value.m_value))
+                take(list->root);
+            else if (DictRoot* dict = std::get_if<DictRoot>(&value.m_value))
+                take(dict->root);
+        }
+
+        void take(ListNode& node)
+        {
+            for (auto& child : node.children)
+                take(child);
+            for (auto& value : node.values)
+                take(value);
+        }
+
+        void take(DictNode& node)
+        {
+            for (auto& entry : node.entries)
+                take(entry.value);
+            for (auto& child : node.children)
+                take(child);
+        }
+
+        void run()
+        {
+            while (!lists.empty() || !dicts.empty())
+            {
+                if (!lists.empty())
+                {
+                    ListPtr node = std::move(lists.back());
+                    lists.pop_back();
+                    take(const_cast<ListNode&>(*node));
+                }
+                else
+                {
+                    DictPtr node = std::move(dicts.back());
+                    dicts.pop_back();
+                    take(const_cast<DictNode&>(*node));
+                }
+            }
+        }
+    };
+};
+
+JPersistentObject::ListNode::~ListNode()
+{
+    // Detach the nodes owned only by this one before its members are freed,
+    // as ~JObject() does, so that a deep value is torn down in a loop.
+    Impl::Teardown teardown;
+    teardown.take(*this);
+    teardown.run();
+}
+
+JPersistentObject::DictNode::~DictNode()
+{
+    Impl::Teardown teardown;
+    teardown.take(*this);
+    teardown.run();
+}
+
+JPersistentObject JPersistentObject::fromJObject(const JObject& jo)
+{
+    // Containers are built bottom-up through an explicit stack, so deep
+    // documents don't exhaust the native stack.
+    struct Frame
+    {
+        const JObject* source;
+        std::vector<const std::string*> keys;
+        std::vector<const JObject*> children;
+        std::vector<JPersistentObject> built;
+    };
+
+    auto scalar = [](const JObject& value) -> JPersistentObject
+        {
+            switch (value.getType())
+            {
+            case JValueType::JInt:
+                return value.getInt();
+            case JValueType::JDouble:
+                return value.getDouble();
+            case JValueType::JBool:
+                return value.getBool();
+            case JValueType::JString:
+                return JPersistentObject(value.getString());
+            default:
+                return JPersistentObject();
+            }
+        };
+    auto open = [](const JObject& value) -> Frame
+        {
+            Frame frame{ &value, {}, {}, {} };
+            if (const packed_t* packed = value.getType() == JValueType::JList ? std::get_if<packed_t>(&value.m_value->value) : nullptr)
+            {
+                // Packed numbers are built straight from their array; there are no children to visit.
+                std::visit([&frame](const auto& numbers)
+                    {
+                        frame.built.reserve(numbers.size());
+                        for (auto number : numbers)
+                        {
+                            if constexpr (std::is_same_v<decltype(number), double>)
+                                frame.built.push_back(JPersistentObject(number));
+                            else
+                                frame.built.push_back(JPersistentObject(static_cast<long long>(number)));
+                        }
+                    }, packed->numbers);
+                return frame;
+            }
+            if (value.getType() == JValueType::JList)
+            {
+                for (const auto& child : value.getList())
+                    frame.children.push_back(&child);
+            }
+            else
+            {
+                for (const auto& [key, child] : value.getDict())
+                {
+                    frame.keys.push_back(&key);
+                    frame.children.push_back(&child);
+                }
+            }
+            frame.built.reserve(frame.children.size());
+            return frame;
+        };
+    auto isContainer = [](const JObject& value)
+        {
+            return value.getType() == JValueType::JList || value.getType() == JValueType::JDict;
+        };
+
+    if (!isContainer(jo))
+        return scalar(jo);
+
+    std::vector<Frame> stack;
+    stack.push_back(open(jo));
+    while (true)
+    {
+        Frame& frame = stack.back();
+        if (frame.built.size() < frame.children.size())
+        {
+            const JObject& child = *frame.children[frame.built.size()];
+            if (isContainer(child))
+                stack.push_back(open(child));
+            else
+                frame.built.push_back(scalar(child));
+            continue;
+        }
+
+        JPersistentObject result;
+        if (frame.source->getType() == JValueType::JList)
+        {
+            result.m_type = JValueType::JList;
+            result.m_value = Impl::buildList(std::move(frame.built));
+        }
+        else
+        {
+            size_t size = frame.built.size();
+            std::vector<Impl::Entry> entries;
+            entries.reserve(size);
+            for (size_t i = 0; i < size; i++)
+                entries.push_back({ hashKey(*frame.keys[i]), *frame.keys[i], std::move(frame.built[i]) });
+            result.m_type = JValueType::JDict;
+            result.m_value = DictRoot{ Impl::buildDict(std::move(entries), 0), size };
+        }
+
+        stack.pop_back();
+        if (stack.empty())
+            return result;
+        stack.back().built.push_back(std::move(result));
+    }
+}
+
+JObject JPersistentObject::toJObject() const
+{
+    JObject root;
+    std::vector<std::pair<JObject*, const JPersistentObject*>> pending;
+    pending.emplace_back(&root, this);
+    while (!pending.empty())
+    {
+        auto [target, source] = pending.back();
+        pending.pop_back();
+
+        switch (source->m_type)
+        {
+        case JValueType::JInt:
+            *target = source->getInt();
+            break;
+        case JValueType::JDouble:
+            *target = source->getDouble();
+            break;
+        case JValueType::JBool:
+            *target = source->getBool();
+            break;
+        case JValueType::JString:
+            *target = source->getString();
+            break;
+        case JValueType::JList:
+        {
+            target->m_type = JValueType::JList;
+            target->m_value = std::make_shared<JObject::Storage>(std::in_place_type<list_t>, source->size());
+            list_t& list = *std::get_if<list_t>(&target->m_value->value);
+            size_t index = 0;
+            source->forEachElement([&](const JPersistentObject& element)
+                {
+                    pending.emplace_back(&list[index++], &element);
+                });
+            break;
+        }
+        case JValueType::JDict:
+        {
+            target->m_type = JValueType::JDict;
+            target->m_value = std::make_shared<JObject::Storage>(std::in_place_type<dict_t>);
+            dict_t& dict = *std::get_if<dict_t>(&target->m_value->value);
+            dict.reserve(source->size());
+            source->forEachMember([&](const std::string& key, const JPersistentObject& member)
+                {
+                    pending.emplace_back(&dict[key], &member);
+                });
+            break;
+        }
+        default:
+            *target = JObject();
+            break;
+        }
+    }
+    return root;
+}
+
+JValueType JPersistentObject::getType() const
+{
+    return m_type;
+}
+
+long long JPersistentObject::getInt() const
+{
+    if (m_type != JValueType::JInt)
+        throw std::logic_error("This JPersistentObject isn't int");
+    return *std::get_if<int_t>(&m_value);
+}
+
+long double JPersistentObject::getDouble() const
+{
+    if (m_type != JValueType::JDouble)
+        throw std::logic_error("This JPersistentObject isn't double");
+    return *std::get_if<double_t>(&m_value);
+}
+
+bool JPersistentObject::getBool() const
+{
+    if (m_type != JValueType::JBool)
+        throw std::logic_error("This JPersistentObject isn't bool");
+    return *std::get_if<bool_t>(&m_value);
+}
+
+const std::string& JPersistentObject::getString() const
+{
+    if (m_type != JValueType::JString)
+        throw std::logic_error("This JPersistentObject isn't string");
+    return **std::get_if<std::shared_ptr<const std::string>>(&m_value);
+}
+
+size_t JPersistentObject::size() const
+{
+    if (m_type == JValueType::JList)
+        return std::get_if<ListRoot>(&m_value)->size;
+    if (m_type == JValueType::JDict)
+        return std::get_if<DictRoot>(&m_value)->size;
+    throw std::logic_error("The type isn't JList or JDict.");
+}
+
+const JPersistentObject& JPersistentObject::operator[](size_t index) const
+{
+    if (m_type != JValueType::JList)
+        throw std::logic_error("The type isn't JList.");
+    const ListRoot& list = *std::get_if<ListRoot>(&m_value);
+    if (index >= list.size)
+        throw std::logic_error("The size is smaller than itor.");
+
+    const ListNode* node = list.root.get();
+    for (unsigned level = list.shift; level > 0; level -= branchBits)
+        node = node->children[(index >> level) & branchMask].get();
+    return node->values[index & branchMask];
+}
+
+const JPersistentObject& JPersistentObject::operator[](std::string_view key) const
+{
+    const JPersistentObject* member = find(key);
+    if (member == nullptr)
+        throw std::logic_error("Invalid Keyword");
+    return *member;
+}
+
+const JPersistentObject* JPersistentObject::find(std::string_view key) const
+{
+    if (m_type != JValueType::JDict)
+        throw std::logic_error("The type isn't JDict.");
+    return Impl::findIn(std::get_if<DictRoot>(&m_value)->root.get(), hashKey(key), key);
+}
+
+bool JPersistentObject::hasMember(std::string_view key) const
+{
+    return find(key) != nullptr;
+}
+
+JPersistentObject JPersistentObject::set(size_t index, JPersistentObject value) const
+{
+    if (m_type != JValueType::JList)
+        throw std::logic_error("The type isn't JList.");
+    const ListRoot& list = *std::get_if<ListRoot>(&m_value);
+    if (index >= list.size)
+        throw std::logic_error("The size is smaller than itor.");
+
+    JPersistentObject result(JValueType::JList);
+    result.m_value = ListRoot{ Impl::setIn(list.root, list.shift, index, std::move(value)), list.size, list.shift };
+    return result;
+}
+
+JPersistentObject JPersistentObject::push_back(JPersistentObject value) const
+{
+    if (m_type != JValueType::JList)
+        throw std::logic_error("The type isn't JList.");
+    const ListRoot& list = *std::get_if<ListRoot>(&m_value);
+
+    ListRoot next{ nullptr, list.size + 1, list.shift };
+    if (!list.root)
+        next.root = Impl::newPath(0, std::move(value));
+    else if (list.size == (branchSize << list.shift))
+    {
+        // The tree is full: grow it by one level.
+        auto root = std::make_shared<ListNode>();
+        root->children.push_back(list.root);
+        root->children.push_back(Impl::newPath(list.shift, std::move(value)));
+        next.root = std::move(root);
+        next.shift += branchBits;
+    }
+    else
+        next.root = Impl::pushIn(list.root, list.shift, list.size, std::move(value));
+
+    JPersistentObject result(JValueType::JList);
+    result.m_value = std::move(next);
+    return result;
+}
+
+JPersistentObject JPersistentObject::pop_back() const
+{
+    if (m_type != JValueType::JList)
+        throw std::logic_error("The type isn't JList.");
+    const ListRoot& list = *std::get_if<ListRoot>(&m_value);
+    if (list.size == 0)
+        throw std::logic_error("The JList is empty.");
+
+    ListRoot next{ Impl::popIn(list.root, list.shift, list.size - 1), list.size - 1, list.shift };
+    if (next.root && next.shift > 0 && next.root->children.size() == 1)
+    {
+        next.root = next.root->children.front();
+        next.shift -= branchBits;
+    }
+    if (!next.root)
+        next.shift = 0;
+
+    JPersistentObject result(JValueType::JList);
+    result.m_value = std::move(next);
+    return result;
+}
+
+JPersistentObject JPersistentObject::set(std::string_view key, JPersistentObject value) const
+{
+    if (m_type != JValueType::JDict)
+        throw std::logic_error("The type isn't JDict.");
+    const DictRoot& dict = *std::get_if<DictRoot>(&m_value);
+
+    bool added = false;
+    Impl::Entry entry{ hashKey(key), std::string(key), std::move(value) };
+    JPersistentObject result(JValueType::JDict);
+    result.m_value = DictRoot{ Impl::assocIn(dict.root.get(), 0, std::move(entry), added), dict.size };
+    if (added)
+        std::get_if<DictRoot>(&result.m_value)->size++;
+    return result;
+}
+
+JPersistentObject JPersistentObject::erase(std::string_view key) const
+{
+    if (m_type != JValueType::JDict)
+        throw std::logic_error("The type isn't JDict.");
+    const DictRoot& dict = *std::get_if<DictRoot>(&m_value);
+    if (!dict.root)
+        return *this;
+
+    bool removed = false;
+    DictRoot next{ Impl::dissocIn(dict.root, 0, hashKey(key), key, removed), dict.size };
+    if (!removed)
+        return *this;
+    next.size--;
+
+    JPersistentObject result(JValueType::JDict);
+    result.m_value = std::move(next);
+    return result;
+}
+
+void JPersistentObject::forEachElement(const std::function<void(const JPersistentObject&)>& func) const
+{
+    if (m_type != JValueType::JList)
+        throw std::logic_error("The type isn't JList.");
+    const ListRoot& list = *std::get_if<ListRoot>(&m_value);
+    if (list.root)
+        Impl::forEachIn(list.root.get(), func);
+}
+
+void JPersistentObject::forEachMember(const std::function<void(const std::string&, const JPersistentObject&)>& func) const
+{
+    if (m_type != JValueType::JDict)
+        throw std::logic_error("The type isn't JDict.");
+    const DictRoot& dict = *std::get_if<DictRoot>(&m_value);
+    if (dict.root)
+        Impl::forEachIn(dict.root.get(), func);
+}
+
+JPersistentDocument::JPersistentDocument()
+    :m_current(std::make_shared<const JPersistentObject>())
+{
+}
+
+JPersistentDocument::JPersistentDocument(JPersistentObject root)
+    :m_current(std::make_shared<const JPersistentObject>(std::move(root)))
+{
+}
+
+std::shared_ptr<const JPersistentObject> JPersistentDocument::load() const
+{
+    return m_current.load(std::memory_order_acquire);
+}
+
+void JPersistentDocument::store(JPersistentObject root)
+{
+    m_current.store(std::make_shared<const JPersistentObject>(std::move(root)), std::memory_order_release);
+}
+
+JPersistentObject JPersistentDocument::update(const std::function<JPersistentObject(const JPersistentObject&)>& func)
+{
+    std::shared_ptr<const JPersistentObject> current = m_current.load(std::memory_order_acquire);
+    while (true)
+    {
+        auto next = std::make_shared<const JPersistentObject>(func(*current));
+        if (m_current.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_acquire))
+            return *next;
+    }
+}
+
+JSON_NAMESPACE_END
@@ -0,0 +1,352 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <QuqiParser/JsonReader.h>
+#include <QuqiParser/Json.h>
+
+#include <charconv>
+#include <stdexcept>
+
+#define JSON_NAMESPACE_START namespace qjson {
+#define JSON_NAMESPACE_END }
+
+JSON_NAMESPACE_START
+
+JReader::JReader(std::string_view data)
+    :m_data(data)
+{
+}
+
+JTokenType JReader::next()
+{
+    skipSpace();
+    if (m_started && m_depth == 0)
+    {
+        m_type = JTokenType::End;
+        m_value = {};
+        return m_type;
+    }
+    if (m_itor >= m_data.size())
+        throw std::logic_error("Unexpected end of input.");
+
+    if (m_depth != 0)
+    {
+        char close = isObject() ? '}' : ']';
+        if (m_afterKey)
+        {
+            if (m_data[m_itor] != ':')
+                throw std::logic_error("Expected ':' after a key.");
+            m_itor++;
+            skipSpace();
+            if (m_itor >= m_data.size())
+                throw std::logic_error("Unexpected end of input.");
+        }
+        else
+        {
+            if (m_afterValue)
+            {
+                if (m_data[m_itor] == ',')
+                {
+                    m_itor++;
+                    skipSpace();
+                    if (m_itor >= m_data.size())
+                        throw std::logic_error("Unexpected end of input.");
+                }
+                else if (m_data[m_itor] != close)
+                    throw std::logic_error("Expected ',' or a closing bracket.");
+            }
+
+            // Trailing commas are accepted, as JParser accepts them.
+            if (m_data[m_itor] == close)
+            {
+                m_itor++;
+                m_type = close == '}' ? JTokenType::EndObject : JTokenType::EndArray;
+                m_value = m_data.substr(m_itor - 1, 1);
+                m_depth--;
+                m_afterValue = true;
+                return m_type;
+            }
+
+            if (isObject())
+            {
+                if (m_data[m_itor] != '\"')
+                    throw std::logic_error("Expected a key.");
+                readString();
+                m_type = JTokenType::Key;
+                m_afterKey = true;
+                m_afterValue = false;
+                return m_type;
+            }
+        }
+    }
+
+    m_started = true;
+    m_afterKey = false;
+    m_afterValue = true;
+    switch (m_data[m_itor])
+    {
+    case '{':
+    case '[':
+        push(m_data[m_itor] == '{');
+        m_type = m_data[m_itor] == '{' ? JTokenType::BeginObject : JTokenType::BeginArray;
+        m_value = m_data.substr(m_itor, 1);
+        m_itor++;
+        m_afterValue = false;
+        break;
+    case '\"':
+        readString();
+        m_type = JTokenType::String;
+        break;
+    default:
+        readScalar();
+        break;
+    }
+    return m_type;
+}
+
+void JReader::skip()
+{
+    if (m_type == JTokenType::Key)
+    {
+        next();
+        skip();
+        return;
+    }
+    if (m_type != JTokenType::BeginObject && m_type != JTokenType::BeginArray)
+        return;
+
+    size_t depth = m_depth - 1;
+    while (m_depth != depth)
+        next();
+}
+
+JTokenType JReader::getType() const
+{
+    return m_type;
+}
+
+std::string_view JReader::getValue() const
+{
+    return m_value;
+}
+
+std::string_view JReader::getString()
+{
+    if (m_type != JTokenType::String && m_type != JTokenType::Key)
+        throw std::logic_error("The token isn't a string.");
+    if (!m_escaped)
+        return m_value;
+
+    m_decoded.clear();
+    for (size_t i = 0; i < m_value.size(); i++)
+    {
+        if (m_value[i] != '\\')
+        {
+            m_decoded += m_value[i];
+            continue;
+        }
+        switch (m_value[++i])
+        {
+        case 'n':
+            m_decoded += '\n';
+            break;
+        case 'b':
+            m_decoded += '\b';
+            break;
+        case 'f':
+            m_decoded += '\f';
+            break;
+        case 'r':
+            m_decoded += '\r';
+            break;
+        case 't':
+            m_decoded += '\t';
+            break;
+        case 'u':
+            // readString() checked the escape, so the code point is valid.
+            JParser::appendUtf8(m_decoded, static_cast<std::uint32_t>(JParser::unicodeEscape(m_value, i)));
+            break;
+        default:
+            // '\\', '\"' and '/' stand for themselves; readString() rejected the rest.
+            m_decoded += m_value[i];
+            break;
+        }
+    }
+    return m_decoded;
+}
+
+std::int64_t JReader::getInt64() const
+{
+    if (m_type != JTokenType::Number)
+        throw std::logic_error("The token isn't a number.");
+    std::int64_t number;
+    auto result = std::from_chars(m_value.data(), m_value.data() + m_value.size(), number);
+    if (result.ec != std::errc() || result.ptr != m_value.data() + m_value.size())
+        throw std::logic_error("The number isn't a 64-bit integer.");
+    return number;
+}
+
+double JReader::getDouble() const
+{
+    if (m_type != JTokenType::Number)
+        throw std::logic_error("The token isn't a number.");
+    double number;
+    auto result = std::from_chars(m_value.data(), m_value.data() + m_value.size(), number);
+    if (result.ec != std::errc() || result.ptr != m_value.data() + m_value.size())
+        throw std::logic_error("Invalid number.");
+    return number;
+}
+
+bool JReader::getBool() const
+{
+    if (m_type != JTokenType::Bool)
+        throw std::logic_error("The token isn't a bool.");
+    return m_value[0] == 't';
+}
+
+size_t JReader::getDepth() const
+{
+    return m_depth;
+}
+
+size_t JReader::getOffset() const
+{
+    return m_itor;
+}
+
+void JReader::skipSpace()
+{
+    while (m_itor < m_data.size() &&
+           (m_data[m_itor] == ' ' || m_data[m_itor] == '\t' || m_data[m_itor] == '\n' || m_data[m_itor] == '\r'))
+        m_itor++;
+}
+
+void JReader::readString()
+{
+    size_t start = ++m_itor;
+    m_escaped = false;
+    while (m_itor < m_data.size() && m_data[m_itor] != '\"')
+    {
+        if (m_data[m_itor] == '\\')
+        {
+            m_escaped = true;
+            if (++m_itor >= m_data.size())
+                break;
+            switch (m_data[m_itor])
+            {
+            case 'n':
+            case 'b':
+            case 'f':
+            case 'r':
+            case 't':
+            case '\\':
+            case '\"':
+            case '/':
+                break;
+            case 'u':
+                if (JParser::unicodeEscape(m_data, m_itor) < 0)
+                    throw std::logic_error("Invalid escape in a string.");
+                break;
+            default:
+                throw std::logic_error("Invalid escape in a string.");
+            }
+        }
+        m_itor++;
+    }
+    if (m_itor >= m_data.size())
+        throw std::logic_error("Unterminated string.");
+    m_value = m_data.substr(start, m_itor - start);
+    m_itor++;
+}
+
+void JReader::readScalar()
+{
+    size_t start = m_itor;
+    char c = m_data[m_itor];
+    if (c == '-' || (c >= '0' && c <= '9'))
+    {
+        auto digits = [this]()
+            {
+                size_t begin = m_itor;
+                while (m_itor < m_data.size() && m_data[m_itor] >= '0' && m_data[m_itor] <= '9')
+                    m_itor++;
+                return m_itor != begin;
+            };
+
+        // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+        if (c == '-')
+            m_itor++;
+        if (m_itor < m_data.size() && m_data[m_itor] == '0')
+            m_itor++;
+        else if (!digits())
+            throw std::logic_error("Invalid number.");
+        if (m_itor < m_data.size() && m_data[m_itor] == '.')
+        {
+            m_itor++;
+            if (!digits())
+                throw std::logic_error("Invalid number.");
+        }
+        if (m_itor < m_data.size() && (m_data[m_itor] == 'e' || m_data[m_itor] == 'E'))
+        {
+            m_itor++;
+            if (m_itor < m_data.size() && (m_data[m_itor] == '+' || m_data[m_itor] == '-'))
+                m_itor++;
+            if (!digits())
+                throw std::logic_error("Invalid number.");
+        }
+        // A digit can't follow a leading zero.
+        if (m_itor < m_data.size() && m_data[m_itor] >= '0' && m_data[m_itor] <= '9')
+            throw std::logic_error("Invalid number.");
+        m_type = JTokenType::Number;
+    }
+    else if (m_data.substr(m_itor, 4) == "true" || m_data.substr(m_itor, 4) == "null")
+    {
+        m_type = c == 't' ? JTokenType::Bool : JTokenType::Null;
+        m_itor += 4;
+    }
+    else if (m_data.substr(m_itor, 5) == "false")
+    {
+        m_type = JTokenType::Bool;
+        m_itor += 5;
+    }
+    else
+        throw std::logic_error("Unexpected character.");
+    m_value = m_data.substr(start, m_itor - start);
+}
+
+bool JReader::isObject() const
+{
+    size_t level = m_depth - 1;
+    if (level < 256)
+        return (m_kinds[level / 64] >> (level % 64)) & 1;
+    return m_deepKinds[level - 256];
+}
+
+void JReader::push(bool isObject)
+{
+    size_t level = m_depth++;
+    if (level < 256)
+    {
+        if (isObject)
+            m_kinds[level / 64] |= std::uint64_t(1) << (level % 64);
+        else
+            m_kinds[level / 64] &= ~(std::uint64_t(1) << (level % 64));
+        return;
+    }
+    if (m_deepKinds.size() <= level - 256)
+        m_deepKinds.resize(level - 255);
+    m_deepKinds[level - 256] = isObject;
+}
+
+JSON_NAMESPACE_END
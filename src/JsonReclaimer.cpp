@@ -0,0 +1,138 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <QuqiParser/JsonReclaimer.h>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+#define JSON_NAMESPACE_START namespace qjson {
+#define JSON_NAMESPACE_END }
+
+JSON_NAMESPACE_START
+
+namespace
+{
+    /// The number of elements, lists and dicts the background thread frees between two looks at the queue.
+    constexpr size_t batchSize = 4096;
+}
+
+JReclaimer::JReclaimer(bool background)
+{
+    if (background)
+        m_worker = std::jthread([this](std::stop_token stop) { work(stop); });
+}
+
+JReclaimer::~JReclaimer()
+{
+    drain();
+}
+
+void JReclaimer::retire(JObject&& jo)
+{
+    storage_t storage = std::move(jo.m_value);
+    bool container = jo.m_type == JValueType::JList || jo.m_type == JValueType::JDict;
+    jo.m_type = JValueType::JNull;
+
+    // Shared values only lose a reference, and a scalar is freed at once.
+    if (!storage || storage.use_count() != 1 || !container)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push_back(std::move(storage));
+    }
+    m_retired.notify_one();
+}
+
+size_t JReclaimer::collect(size_t budget)
+{
+    std::vector<storage_t> batch;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Every container costs at least one, so no more than the budget is taken.
+        size_t count = std::min(budget, m_pending.size());
+        if (count == 0)
+            return 0;
+        batch.assign(std::make_move_iterator(m_pending.end() - count), std::make_move_iterator(m_pending.end()));
+        m_pending.resize(m_pending.size() - count);
+        m_busy++;
+    }
+
+    // Each element removed and each container freed costs one. A container is
+    // emptied a part at a time and freed once nothing is left; its lists and
+    // dicts are detached into the batch and freed first. What isn't reached
+    // within the budget goes back to the queue.
+    size_t freed = 0;
+    while (!batch.empty() && freed < budget)
+    {
+        storage_t storage = std::move(batch.back());
+        batch.pop_back();
+        size_t children = batch.size();
+        freed += JObject::shedChildren(*storage, budget - freed, batch);
+        if (freed < budget)
+        {
+            storage.reset();
+            freed++;
+        }
+        else
+            batch.insert(batch.begin() + children, std::move(storage));
+    }
+
+    bool left = !batch.empty();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.insert(m_pending.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        m_busy--;
+    }
+    m_idle.notify_all();
+    if (left)
+        m_retired.notify_one();
+    return freed;
+}
+
+void JReclaimer::drain()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_pending.empty() || m_busy != 0)
+    {
+        if (m_pending.empty())
+        {
+            m_idle.wait(lock);
+            continue;
+        }
+        lock.unlock();
+        collect(std::numeric_limits<size_t>::max());
+        lock.lock();
+    }
+}
+
+size_t JReclaimer::pending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending.size();
+}
+
+void JReclaimer::work(std::stop_token stop)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_retired.wait(lock, stop, [this] { return !m_pending.empty(); }))
+    {
+        lock.unlock();
+        collect(batchSize);
+        lock.lock();
+    }
+}
+
+JSON_NAMESPACE_END
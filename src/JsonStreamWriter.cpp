@@ -0,0 +1,214 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <QuqiParser/JsonStreamWriter.h>
+#include <QuqiParser/Json.h>
+
+#include <stdexcept>
+
+#define JSON_NAMESPACE_START namespace qjson {
+#define JSON_NAMESPACE_END }
+
+JSON_NAMESPACE_START
+
+JStreamWriter::JStreamWriter(bool format)
+    :m_format(format)
+{
+}
+
+JStreamWriter::JStreamWriter(sink_t sink, bool format, size_t flushSize)
+    :m_sink(std::move(sink)),
+    m_flushSize(flushSize),
+    m_format(format)
+{
+}
+
+JStreamWriter& JStreamWriter::beginObject()
+{
+    beforeValue();
+    m_buffer += m_format ? "{\n" : "{";
+    m_stack.push_back({ true, true });
+    return *this;
+}
+
+JStreamWriter& JStreamWriter::endObject()
+{
+    if (m_stack.empty() || !m_stack.back().isObject)
+        throw std::logic_error("endObject() without a matching beginObject().");
+    if (m_expectValue)
+        throw std::logic_error("The key has no value.");
+    if (m_format)
+    {
+        m_buffer += '\n';
+        indent(m_stack.size() - 1);
+    }
+    m_buffer += '}';
+    m_stack.pop_back();
+    afterValue();
+    return *this;
+}
+
+JStreamWriter& JStreamWriter::beginArray()
+{
+    beforeValue();
+    m_buffer += m_format ? "[\n" : "[";
+    m_stack.push_back({ false, true });
+    return *this;
+}
+
+JStreamWriter& JStreamWriter::endArray()
+{
+    if (m_stack.empty() || m_stack.back().isObject)
+        throw std::logic_error("endArray() without a matching beginArray().");
+    if (m_format)
+    {
+        m_buffer += '\n';
+        indent(m_stack.size() - 1);
+    }
+    m_buffer += ']';
+    m_stack.pop_back();
+    afterValue();
+    return *this;
+}
+
+JStreamWriter& JStreamWriter::key(std::string_view name)
+{
+    if (m_stack.empty() || !m_stack.back().isObject)
+        throw std::logic_error("A key can only be written inside an object.");
+    if (m_expectValue)
+        throw std::logic_error("The previous key has no value.");
+    separate();
+    JWriter::writeString(m_buffer, name);
+    m_buffer += m_format ? ": " : ":";
+    m_expectValue = true;
+    return *this;
+}
+
+JStreamWriter& JStreamWriter::null()
+{
+    return rawValue("null");
+}
+
+JStreamWriter& JStreamWriter::value(bool data)
+{
+    return rawValue(data ? "true" : "false");
+}
+
+JStreamWriter& JStreamWriter::value(double data)
+{
+    return rawValue(std::to_string(static_cast<long double>(data)));
+}
+
+JStreamWriter& JStreamWriter::value(long double data)
+{
+    return rawValue(std::to_string(data));
+}
+
+JStreamWriter& JStreamWriter::value(const char* data)
+{
+    return value(std::string_view(data));
+}
+
+JStreamWriter& JStreamWriter::value(std::string_view data)
+{
+    beforeValue();
+    JWriter::writeString(m_buffer, data);
+    afterValue();
+    return *this;
+}
+
+JStreamWriter& JStreamWriter::rawValue(std::string_view json)
+{
+    beforeValue();
+    m_buffer += json;
+    afterValue();
+    return *this;
+}
+
+bool JStreamWriter::isComplete() const
+{
+    return m_complete;
+}
+
+const std::string& JStreamWriter::getBuffer() const
+{
+    return m_buffer;
+}
+
+std::string JStreamWriter::release()
+{
+    std::string buffer(std::move(m_buffer));
+    m_buffer.clear();
+    return buffer;
+}
+
+void JStreamWriter::flush()
+{
+    if (m_sink && !m_buffer.empty())
+    {
+        m_sink(m_buffer);
+        m_buffer.clear();
+    }
+}
+
+void JStreamWriter::reset()
+{
+    m_buffer.clear();
+    m_stack.clear();
+    m_expectValue = false;
+    m_complete = false;
+}
+
+void JStreamWriter::beforeValue()
+{
+    if (m_complete)
+        throw std::logic_error("The document already has a top-level value.");
+    if (m_stack.empty())
+        return;
+    if (m_stack.back().isObject)
+    {
+        if (!m_expectValue)
+            throw std::logic_error("A value inside an object needs a key.");
+        m_expectValue = false;
+        return;
+    }
+    separate();
+}
+
+void JStreamWriter::afterValue()
+{
+    if (!m_stack.empty())
+        return;
+    m_complete = true;
+    flush();
+}
+
+void JStreamWriter::separate()
+{
+    Frame& frame = m_stack.back();
+    if (!frame.first)
+        m_buffer += m_format ? ",\n" : ",";
+    frame.first = false;
+    if (m_format)
+        indent(m_stack.size());
+    if (m_sink && m_buffer.size() >= m_flushSize)
+        flush();
+}
+
+void JStreamWriter::indent(size_t n)
+{
+    m_buffer.append(n * 4, ' ');
+}
+
+JSON_NAMESPACE_END
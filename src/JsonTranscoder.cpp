@@ -0,0 +1,416 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <QuqiParser/JsonTranscoder.h>
+
+#include <stdexcept>
+
+#define JSON_NAMESPACE_START namespace qjson {
+#define JSON_NAMESPACE_END }
+
+JSON_NAMESPACE_START
+
+JTranscoder::JTranscoder(const JTranscodeOptions& options)
+    :m_options(options)
+{
+}
+
+JTranscoder::JTranscoder(sink_t sink, const JTranscodeOptions& options, size_t flushSize)
+    :m_sink(std::move(sink)),
+    m_flushSize(flushSize),
+    m_options(options)
+{
+}
+
+void JTranscoder::feed(std::string_view data)
+{
+    size_t itor = 0;
+    while (itor < data.size())
+    {
+        if (m_inString)
+        {
+            if (m_escape)
+            {
+                char c = data[itor++];
+                if (m_highSurrogate && c != 'u')
+                    throw std::logic_error("Invalid escape in a string.");
+                switch (c)
+                {
+                case 'n':
+                case 'b':
+                case 'f':
+                case 'r':
+                case 't':
+                case '\\':
+                case '\"':
+                case '/':
+                    break;
+                case 'u':
+                    m_hexLeft = 4;
+                    m_unit = 0;
+                    break;
+                default:
+                    throw std::logic_error("Invalid escape in a string.");
+                }
+                m_buffer += c;
+                m_escape = false;
+                continue;
+            }
+            if (m_hexLeft > 0)
+            {
+                readHexDigit(data[itor++]);
+                continue;
+            }
+            // A high surrogate must be followed by an escaped low one.
+            if (m_highSurrogate && data[itor] != '\\')
+                throw std::logic_error("Invalid escape in a string.");
+
+            // Copies the run up to the next quote or backslash at once.
+            size_t end = data.find_first_of("\"\\", itor);
+            if (end == std::string_view::npos)
+            {
+                m_buffer.append(data.substr(itor));
+                break;
+            }
+            m_buffer.append(data.substr(itor, end + 1 - itor));
+            if (data[end] == '\\')
+                m_escape = true;
+            else
+                m_inString = false;
+            itor = end + 1;
+            continue;
+        }
+
+        char c = data[itor];
+        if (m_scalar != Scalar::None)
+        {
+            if (continueScalar(c))
+            {
+                itor++;
+                continue;
+            }
+            endScalar();
+        }
+
+        switch (c)
+        {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            if (m_stack.empty())
+                m_spaced = true;
+            break;
+        case '{':
+        case '[':
+            open(c);
+            break;
+        case '}':
+        case ']':
+            close(c);
+            break;
+        case ',':
+            if (m_stack.empty() || m_stack.back().expect != Expect::Comma)
+                throw std::logic_error("Unexpected comma.");
+            m_stack.back().expect = Expect::Element;
+            m_pendingComma = true;
+            break;
+        case ':':
+            if (m_stack.empty() || m_stack.back().expect != Expect::Colon)
+                throw std::logic_error("Unexpected colon.");
+            m_stack.back().expect = Expect::Value;
+            m_buffer += m_options.pretty ? ": " : ":";
+            break;
+        case '\"':
+            beginValue(true);
+            m_buffer += c;
+            m_inString = true;
+            break;
+        default:
+            beginScalar(c);
+            break;
+        }
+        itor++;
+    }
+
+    if (m_sink && m_buffer.size() >= m_flushSize)
+        flush();
+}
+
+void JTranscoder::feed(std::ifstream& infile)
+{
+    std::string block(64 * 1024, '\0');
+    while (infile)
+    {
+        infile.read(block.data(), block.size());
+        feed(std::string_view(block.data(), static_cast<size_t>(infile.gcount())));
+    }
+}
+
+void JTranscoder::finish()
+{
+    if (m_inString)
+        throw std::logic_error("Unterminated string.");
+    if (m_scalar != Scalar::None)
+        endScalar();
+    if (!m_stack.empty())
+        throw std::logic_error("Unexpected end of input.");
+    flush();
+}
+
+const std::string& JTranscoder::getBuffer() const
+{
+    return m_buffer;
+}
+
+std::string JTranscoder::release()
+{
+    std::string buffer(std::move(m_buffer));
+    m_buffer.clear();
+    return buffer;
+}
+
+void JTranscoder::reset()
+{
+    m_buffer.clear();
+    m_stack.clear();
+    m_count = 0;
+    m_inString = false;
+    m_escape = false;
+    m_hexLeft = 0;
+    m_unit = 0;
+    m_highSurrogate = false;
+    m_spaced = true;
+    m_scalar = Scalar::None;
+    m_pendingOpen = false;
+    m_pendingComma = false;
+}
+
+std::string JTranscoder::minify(std::string_view data)
+{
+    JTranscoder transcoder;
+    transcoder.feed(data);
+    transcoder.finish();
+    return transcoder.release();
+}
+
+std::string JTranscoder::prettify(std::string_view data, size_t indentWidth, char indentChar)
+{
+    JTranscoder transcoder({ true, indentWidth, indentChar });
+    transcoder.feed(data);
+    transcoder.finish();
+    return transcoder.release();
+}
+
+void JTranscoder::readHexDigit(char c)
+{
+    unsigned digit;
+    if (c >= '0' && c <= '9')
+        digit = c - '0';
+    else if (c >= 'a' && c <= 'f')
+        digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+        digit = c - 'A' + 10;
+    else
+        throw std::logic_error("Invalid escape in a string.");
+    m_unit = (m_unit << 4) | digit;
+    m_buffer += c;
+    if (--m_hexLeft != 0)
+        return;
+
+    // Surrogates are paired the way JParser pairs them.
+    bool low = m_unit >= 0xDC00 && m_unit < 0xE000;
+    if (low != m_highSurrogate)
+        throw std::logic_error("Invalid escape in a string.");
+    m_highSurrogate = m_unit >= 0xD800 && m_unit < 0xDC00;
+}
+
+void JTranscoder::beginScalar(char c)
+{
+    if (c == '-')
+        m_scalar = Scalar::Minus;
+    else if (c == '0')
+        m_scalar = Scalar::Zero;
+    else if (c >= '1' && c <= '9')
+        m_scalar = Scalar::Integer;
+    else if (c == 't' || c == 'f' || c == 'n')
+    {
+        m_scalar = Scalar::Literal;
+        m_literal = c == 't' ? "true" : c == 'f' ? "false" : "null";
+        m_matched = 1;
+    }
+    else
+        throw std::logic_error("Unexpected character.");
+    beginValue(false);
+    m_buffer += c;
+}
+
+bool JTranscoder::continueScalar(char c)
+{
+    // Follows the JSON number grammar one character at a time, so a token
+    // split across chunks is checked the same way as a whole one.
+    bool digit = c >= '0' && c <= '9';
+    bool exponent = c == 'e' || c == 'E';
+    Scalar next = Scalar::None;
+    switch (m_scalar)
+    {
+    case Scalar::Minus:
+        next = c == '0' ? Scalar::Zero : digit ? Scalar::Integer : Scalar::None;
+        break;
+    case Scalar::Zero:
+    case Scalar::Integer:
+        if (digit && m_scalar == Scalar::Integer)
+            next = Scalar::Integer;
+        else if (c == '.')
+            next = Scalar::Point;
+        else if (exponent)
+            next = Scalar::Exponent;
+        break;
+    case Scalar::Point:
+    case Scalar::Fraction:
+        if (digit)
+            next = Scalar::Fraction;
+        else if (exponent && m_scalar == Scalar::Fraction)
+            next = Scalar::Exponent;
+        break;
+    case Scalar::Exponent:
+        next = digit ? Scalar::ExponentDigits : c == '+' || c == '-' ? Scalar::ExponentSign : Scalar::None;
+        break;
+    case Scalar::ExponentSign:
+    case Scalar::ExponentDigits:
+        next = digit ? Scalar::ExponentDigits : Scalar::None;
+        break;
+    case Scalar::Literal:
+        if (m_literal[m_matched] != '\0' && c == m_literal[m_matched])
+        {
+            m_matched++;
+            m_buffer += c;
+            return true;
+        }
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+            throw std::logic_error("Invalid literal.");
+        break;
+    default:
+        break;
+    }
+    if (next == Scalar::None)
+        return false;
+    m_scalar = next;
+    m_buffer += c;
+    return true;
+}
+
+void JTranscoder::endScalar()
+{
+    Scalar scalar = m_scalar;
+    m_scalar = Scalar::None;
+    if (scalar == Scalar::Literal)
+    {
+        if (m_literal[m_matched] != '\0')
+            throw std::logic_error("Invalid literal.");
+    }
+    else if (scalar != Scalar::Zero && scalar != Scalar::Integer &&
+        scalar != Scalar::Fraction && scalar != Scalar::ExponentDigits)
+        throw std::logic_error("Invalid number.");
+}
+
+void JTranscoder::beginValue(bool isString)
+{
+    if (m_stack.empty())
+    {
+        // Top-level values after the first go on their own lines, and must
+        // be separated by whitespace in the input too.
+        if (m_count++ != 0)
+        {
+            if (!m_spaced)
+                throw std::logic_error("Missing whitespace between top-level values.");
+            m_buffer += '\n';
+        }
+        m_spaced = false;
+        return;
+    }
+
+    Frame& frame = m_stack.back();
+    switch (frame.expect)
+    {
+    case Expect::Value:
+        frame.expect = Expect::Comma;
+        return;
+    case Expect::First:
+    case Expect::Element:
+        if (frame.isObject && !isString)
+            throw std::logic_error("A key must be a string.");
+        beginElement();
+        frame.expect = frame.isObject ? Expect::Colon : Expect::Comma;
+        return;
+    default:
+        throw std::logic_error(frame.expect == Expect::Colon ? "Missing colon." : "Missing comma.");
+    }
+}
+
+void JTranscoder::beginElement()
+{
+    if (m_pendingComma)
+        m_buffer += ',';
+    if (m_options.pretty)
+    {
+        m_buffer += '\n';
+        indent(m_stack.size());
+    }
+    m_pendingOpen = false;
+    m_pendingComma = false;
+}
+
+void JTranscoder::open(char bracket)
+{
+    beginValue(false);
+    m_buffer += bracket;
+    m_stack.push_back({ bracket == '{', Expect::First });
+    m_pendingOpen = true;
+}
+
+void JTranscoder::close(char bracket)
+{
+    if (m_stack.empty() || m_stack.back().isObject != (bracket == '}'))
+        throw std::logic_error("Mismatched bracket.");
+    Expect expect = m_stack.back().expect;
+    if (expect == Expect::Colon || expect == Expect::Value)
+        throw std::logic_error("The key has no value.");
+
+    if (m_options.pretty && !m_pendingOpen)
+    {
+        m_buffer += '\n';
+        indent(m_stack.size() - 1);
+    }
+    m_buffer += bracket;
+    m_stack.pop_back();
+    m_pendingOpen = false;
+    m_pendingComma = false;
+}
+
+void JTranscoder::indent(size_t n)
+{
+    m_buffer.append(n * m_options.indentWidth, m_options.indentChar);
+}
+
+void JTranscoder::flush()
+{
+    if (m_sink && !m_buffer.empty())
+    {
+        m_sink(m_buffer);
+        m_buffer.clear();
+    }
+}
+
+JSON_NAMESPACE_END
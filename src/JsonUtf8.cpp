@@ -0,0 +1,286 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include <QuqiParser/Json.h>
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define JSON_UTF8_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define JSON_TARGET(isa) __attribute__((target(isa)))
+#else
+#define JSON_TARGET(isa)
+#endif
+
+#define JSON_NAMESPACE_START namespace qjson {
+#define JSON_NAMESPACE_END }
+
+JSON_NAMESPACE_START
+
+namespace
+{
+    bool validateScalar(const unsigned char* data, size_t size)
+    {
+        size_t i = 0;
+        while (i < size)
+        {
+            // Skips ASCII eight bytes at a time.
+            if (i + 8 <= size)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data + i, 8);
+                if ((word & 0x8080808080808080ULL) == 0)
+                {
+                    i += 8;
+                    continue;
+                }
+            }
+            unsigned char lead = data[i];
+            if (lead < 0x80)
+            {
+                i++;
+                continue;
+            }
+            size_t length;
+            unsigned char low = 0x80, high = 0xBF; // The range of the second byte.
+            if (lead >= 0xC2 && lead <= 0xDF)
+                length = 2;
+            else if (lead >= 0xE0 && lead <= 0xEF)
+            {
+                length = 3;
+                if (lead == 0xE0)
+                    low = 0xA0; // overlong
+                else if (lead == 0xED)
+                    high = 0x9F; // surrogates
+            }
+            else if (lead >= 0xF0 && lead <= 0xF4)
+            {
+                length = 4;
+                if (lead == 0xF0)
+                    low = 0x90; // overlong
+                else if (lead == 0xF4)
+                    high = 0x8F; // above U+10FFFF
+            }
+            else
+                return false;
+            if (i + length > size || data[i + 1] < low || data[i + 1] > high)
+                return false;
+            for (size_t j = 2; j < length; j++)
+                if ((data[i + j] & 0xC0) != 0x80)
+                    return false;
+            i += length;
+        }
+        return true;
+    }
+
+#ifdef JSON_UTF8_X86
+    // The vector validators classify every byte by its high nibble, its low
+    // nibble and the high nibble of the byte before, and look up the errors
+    // each class allows in three tables; an error survives the AND of the
+    // three only if all of them agree. Sequences of three and four bytes are
+    // then checked for continuation bytes in the right places. The tail of
+    // the input is copied into a zero-filled block, so a sequence cut off at
+    // the end shows up as too short.
+    constexpr unsigned char tooShort = 1 << 0;   // a lead byte not followed by enough continuations
+    constexpr unsigned char tooLong = 1 << 1;    // a continuation after ASCII
+    constexpr unsigned char overlong3 = 1 << 2;
+    constexpr unsigned char tooLarge = 1 << 3;
+    constexpr unsigned char surrogate = 1 << 4;
+    constexpr unsigned char overlong2 = 1 << 5;
+    constexpr unsigned char tooLarge1000 = 1 << 6;
+    constexpr unsigned char overlong4 = 1 << 6;
+    constexpr unsigned char twoConts = 1 << 7;   // a continuation after a continuation
+    constexpr unsigned char carry = tooShort | tooLong | twoConts;
+
+#define JSON_BYTE_1_HIGH \
+    tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, \
+    twoConts, twoConts, twoConts, twoConts, \
+    tooShort | overlong2, \
+    tooShort, \
+    tooShort | overlong3 | surrogate, \
+    tooShort | tooLarge | tooLarge1000 | overlong4
+
+#define JSON_BYTE_1_LOW \
+    carry | overlong3 | overlong2 | overlong4, \
+    carry | overlong2, \
+    carry, \
+    carry, \
+    carry | tooLarge, \
+    carry | tooLarge | tooLarge1000, \
+    carry | tooLarge | tooLarge1000, \
+    carry | tooLarge | tooLarge1000, \
+    carry | tooLarge | tooLarge1000, \
+    carry | tooLarge | tooLarge1000, \
+    carry | tooLarge | tooLarge1000, \
+    carry | tooLarge | tooLarge1000, \
+    carry | tooLarge | tooLarge1000, \
+    carry | tooLarge | tooLarge1000 | surrogate, \
+    carry | tooLarge | tooLarge1000, \
+    carry | tooLarge | tooLarge1000
+
+#define JSON_BYTE_2_HIGH \
+    tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, \
+    tooLong | overlong2 | twoConts | overlong3 | tooLarge1000 | overlong4, \
+    tooLong | overlong2 | twoConts | overlong3 | tooLarge, \
+    tooLong | overlong2 | twoConts | surrogate | tooLarge, \
+    tooLong | overlong2 | twoConts | surrogate | tooLarge, \
+    tooShort, tooShort, tooShort, tooShort
+
+    alignas(16) constexpr unsigned char byte1High[16] = { JSON_BYTE_1_HIGH };
+    alignas(16) constexpr unsigned char byte1Low[16] = { JSON_BYTE_1_LOW };
+    alignas(16) constexpr unsigned char byte2High[16] = { JSON_BYTE_2_HIGH };
+    // Subtracted with saturation from the last block: nonzero where a sequence starts too late to end in it.
+    alignas(32) constexpr unsigned char incompleteMax[32] = {
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1 };
+
+    JSON_TARGET("ssse3") void checkSse(__m128i input, __m128i& previous, __m128i& incomplete, __m128i& error)
+    {
+        if (_mm_movemask_epi8(input) == 0)
+        {
+            error = _mm_or_si128(error, incomplete);
+            previous = input;
+            return;
+        }
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        __m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+        __m128i prev2 = _mm_alignr_epi8(input, previous, 14);
+        __m128i prev3 = _mm_alignr_epi8(input, previous, 13);
+        __m128i special = _mm_and_si128(
+            _mm_and_si128(
+                _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(byte1High)), _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(byte1Low)), _mm_and_si128(prev1, nibble))),
+            _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(byte2High)), _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+        __m128i must23 = _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xE0 - 0x80))),
+            _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80))));
+        error = _mm_or_si128(error, _mm_xor_si128(_mm_and_si128(must23, _mm_set1_epi8(static_cast<char>(0x80))), special));
+        incomplete = _mm_subs_epu8(input, _mm_loadu_si128(reinterpret_cast<const __m128i*>(incompleteMax + 16)));
+        previous = input;
+    }
+
+    JSON_TARGET("ssse3") bool validateSse(const unsigned char* data, size_t size)
+    {
+        __m128i previous = _mm_setzero_si128(), incomplete = _mm_setzero_si128(), error = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16)
+            checkSse(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), previous, incomplete, error);
+        unsigned char tail[16] = {};
+        if (size > i)
+            std::memcpy(tail, data + i, size - i);
+        checkSse(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tail)), previous, incomplete, error);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+    }
+
+    JSON_TARGET("avx2") void checkAvx2(__m256i input, __m256i& previous, __m256i& incomplete, __m256i& error)
+    {
+        if (_mm256_movemask_epi8(input) == 0)
+        {
+            error = _mm256_or_si256(error, incomplete);
+            previous = input;
+            return;
+        }
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        // The upper half of the previous block followed by the lower half of this one.
+        __m256i shifted = _mm256_permute2x128_si256(previous, input, 0x21);
+        __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+        __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+        __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+        __m256i special = _mm256_and_si256(
+            _mm256_and_si256(
+                _mm256_shuffle_epi8(_mm256_setr_epi8(JSON_BYTE_1_HIGH, JSON_BYTE_1_HIGH), _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                _mm256_shuffle_epi8(_mm256_setr_epi8(JSON_BYTE_1_LOW, JSON_BYTE_1_LOW), _mm256_and_si256(prev1, nibble))),
+            _mm256_shuffle_epi8(_mm256_setr_epi8(JSON_BYTE_2_HIGH, JSON_BYTE_2_HIGH), _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+        __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80))),
+            _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80))));
+        error = _mm256_or_si256(error, _mm256_xor_si256(_mm256_and_si256(must23, _mm256_set1_epi8(static_cast<char>(0x80))), special));
+        incomplete = _mm256_subs_epu8(input, _mm256_load_si256(reinterpret_cast<const __m256i*>(incompleteMax)));
+        previous = input;
+    }
+
+    JSON_TARGET("avx2") bool validateAvx2(const unsigned char* data, size_t size)
+    {
+        __m256i previous = _mm256_setzero_si256(), incomplete = _mm256_setzero_si256(), error = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+            checkAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), previous, incomplete, error);
+        unsigned char tail[32] = {};
+        if (size > i)
+            std::memcpy(tail, data + i, size - i);
+        checkAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail)), previous, incomplete, error);
+        return _mm256_testz_si256(error, error) != 0;
+    }
+
+#undef JSON_BYTE_1_HIGH
+#undef JSON_BYTE_1_LOW
+#undef JSON_BYTE_2_HIGH
+
+    bool hasAvx2()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        // The OS must save the AVX registers (OSXSAVE, and XCR0 bits 1 and 2).
+        if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    bool hasSsse3()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+#else
+        return __builtin_cpu_supports("ssse3");
+#endif
+    }
+#endif
+
+    using validator_t = bool(*)(const unsigned char*, size_t);
+
+    validator_t pickValidator()
+    {
+#ifdef JSON_UTF8_X86
+        if (hasAvx2())
+            return validateAvx2;
+        if (hasSsse3())
+            return validateSse;
+#endif
+        return validateScalar;
+    }
+}
+
+bool JParser::isValidUtf8(std::string_view data)
+{
+    static const validator_t validator = pickValidator();
+    return validator(reinterpret_cast<const unsigned char*>(data.data()), data.size());
+}
+
+JSON_NAMESPACE_END
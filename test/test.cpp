@@ -13,7 +13,6 @@
 //    limitations under the License.
 
 #include <iostream>
-#include <format>
 
 #include <QuqiParser/Json.h>
 #include <QuqiParser/Ini.h>
@@ -35,7 +34,7 @@ int main()
         std::string name = jobject["name"].getString();
         long long age = jobject["age"].getInt();
 
-        std::cout << std::format("id: {}, name: {}, age: {}\n", id, name, age);
+        std::cout << "id: " << id << ", name: " << name << ", age: " << age << '\n';
 
         std::cout << "一行json数据：" << qjson::JWriter::fastWrite(jobject) << '\n';
         std::cout << "多行json数据：" << qjson::JWriter::fastFormatWrite(jobject) << '\n';
@@ -0,0 +1,79 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Allocations.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // Each allocation is preceded by its size, padded to keep the default alignment.
+    constexpr size_t header = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+    std::atomic<size_t> count{ 0 };
+    std::atomic<size_t> bytes{ 0 };
+}
+
+size_t qtest::allocationCount()
+{
+    return count;
+}
+
+size_t qtest::allocatedBytes()
+{
+    return bytes;
+}
+
+void* operator new(size_t size)
+{
+    void* memory = std::malloc(header + size);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    *static_cast<size_t*>(memory) = size;
+    count++;
+    bytes += size;
+    return static_cast<char*>(memory) + header;
+}
+
+void operator delete(void* memory) noexcept
+{
+    if (memory == nullptr)
+        return;
+    void* block = static_cast<char*>(memory) - header;
+    bytes -= *static_cast<size_t*>(block);
+    std::free(block);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    operator delete(memory);
+}
+
+// The array forms are replaced too, since sanitizers intercept them separately.
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    operator delete(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+    operator delete(memory);
+}
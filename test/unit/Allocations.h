@@ -0,0 +1,37 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef QUQI_TEST_ALLOCATIONS_HPP
+#define QUQI_TEST_ALLOCATIONS_HPP
+
+#include <cstddef>
+
+// The test binary replaces the global operator new and delete to count what goes through them.
+
+namespace qtest
+{
+    /**
+     * @brief Gets the number of calls to operator new so far.
+     * @return The number of calls.
+     */
+    size_t allocationCount();
+
+    /**
+     * @brief Gets the bytes allocated by operator new and not yet freed.
+     * @return The bytes.
+     */
+    size_t allocatedBytes();
+}
+
+#endif // !QUQI_TEST_ALLOCATIONS_HPP
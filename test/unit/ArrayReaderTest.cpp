@@ -0,0 +1,86 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/JsonArrayReader.h>
+
+#include <sstream>
+#include <vector>
+
+using namespace qjson;
+
+namespace
+{
+    std::vector<JObject> readAll(const std::string& data, size_t blockSize)
+    {
+        std::istringstream stream(data);
+        JArrayReader reader(stream, JParserOptions(), blockSize);
+        std::vector<JObject> elements;
+        for (const JObject& element : reader)
+            elements.push_back(element);
+        return elements;
+    }
+}
+
+TEST_CASE(arrayReaderReadsEveryElement)
+{
+    std::string data = " [ 1, \"a, ]\\\"b\" ,{\"k\":[1,{\"x\":\"}\"}]}, [], true ,null,-2.5e3 ]";
+    JObject whole = JParser().parse(data);
+    for (size_t blockSize : { 1, 2, 3, 7, 64, 4096 })
+    {
+        std::vector<JObject> elements = readAll(data, blockSize);
+        CHECK(elements.size() == whole.getList().size());
+        for (size_t i = 0; i < elements.size() && i < whole.getList().size(); i++)
+            CHECK(elements[i] == whole.getList()[i]);
+    }
+}
+
+TEST_CASE(arrayReaderReadsLongArrays)
+{
+    std::string data = "[";
+    for (int i = 0; i < 20000; i++)
+        data += (i ? "," : "") + std::string("{\"id\":") + std::to_string(i) + ",\"name\":\"element\"}";
+    data += "]";
+    for (size_t blockSize : { 5, 1 << 16 })
+    {
+        std::istringstream stream(data);
+        JArrayReader reader(stream, JParserOptions(), blockSize);
+        JObject element;
+        long long count = 0;
+        bool ordered = true;
+        while (reader.next(element))
+            ordered = ordered && element["id"].getInt() == count++;
+        CHECK(count == 20000);
+        CHECK(ordered);
+        CHECK(!reader.next(element));
+    }
+}
+
+TEST_CASE(arrayReaderReadsEmptyArrays)
+{
+    CHECK(readAll("[]", 1).empty());
+    CHECK(readAll("  [ \n ]  ", 3).empty());
+}
+
+TEST_CASE(arrayReaderRejectsMalformedInput)
+{
+    CHECK_THROWS(readAll("", 4), std::logic_error);
+    CHECK_THROWS(readAll("{\"a\":1}", 4), std::logic_error);
+    CHECK_THROWS(readAll("[1 2]", 4), std::logic_error);
+    CHECK_THROWS(readAll("[1,2", 4), std::logic_error);
+    CHECK_THROWS(readAll("[1,{\"a\":", 1), std::logic_error);
+    CHECK_THROWS(readAll("[\"unterminated", 2), std::logic_error);
+    CHECK_THROWS(readAll("[1,{\"a\"}]", 4), std::logic_error);
+}
@@ -0,0 +1,104 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+#include <string>
+#include <utility>
+
+using namespace qjson;
+
+TEST_CASE(reserveKeepsListsAndDictsInPlace)
+{
+    JObject list(JValueType::JList);
+    list.reserve(1000);
+    const JObject* first = &list.emplace_back(0);
+    for (int i = 1; i < 1000; i++)
+        list.emplace_back(i);
+    CHECK(&list[0] == first);
+    CHECK(list.getList().size() == 1000);
+    CHECK(list[999].getInt() == 999);
+
+    JObject dict(JValueType::JDict);
+    dict.reserve(1000);
+    size_t buckets = dict.getDict().bucket_count();
+    for (int i = 0; i < 1000; i++)
+        dict.emplace(std::to_string(i), i);
+    CHECK(dict.getDict().bucket_count() == buckets);
+    CHECK(dict["500"].getInt() == 500);
+
+    CHECK_THROWS(JObject(1).reserve(4), std::logic_error);
+}
+
+TEST_CASE(reserveKeepsPackedListsPacked)
+{
+    JObject ints = JParser().parse("[1,2,3]");
+    CHECK(ints.isPacked());
+    ints.reserve(100);
+    CHECK(ints.isPacked());
+    CHECK(ints == JParser().parse("[1,2,3]"));
+}
+
+TEST_CASE(emplaceConstructsInPlace)
+{
+    JObject jo;
+    std::string text(100, 'x');
+    const char* data = text.data();
+    JObject& added = jo.emplace("s", std::move(text));
+    CHECK(jo.getType() == JValueType::JDict);
+    CHECK(added.getString().data() == data);
+
+    // An existing member is kept, as with try_emplace.
+    CHECK(jo.emplace("s", "other").getString() == std::string(100, 'x'));
+
+    JObject items;
+    items.emplace_back("a");
+    items.emplace_back(JValueType::JDict)["k"] = 1;
+    CHECK(items.getType() == JValueType::JList);
+    CHECK(items[1]["k"].getInt() == 1);
+    CHECK_THROWS(items.emplace("k", 1), std::logic_error);
+}
+
+TEST_CASE(pushBackMovesElements)
+{
+    JObject element = JObject::makeList({ 1, 2, 3 });
+    const JObject* inner = &element[0];
+    JObject list;
+    list.push_back(std::move(element));
+    CHECK(&list[0][0] == inner);
+}
+
+TEST_CASE(makeBuildsNestedObjects)
+{
+    JObject jo = JObject::makeDict({
+        { "name", "quqi" },
+        { "tags", JObject::makeList({ "a", "b" }) },
+        { "size", JObject::makeDict({ { "w", 2 }, { "h", 1.5 } }) },
+        { "name", "last" },
+    });
+    CHECK(jo == JParser().parse("{\"name\":\"last\",\"tags\":[\"a\",\"b\"],\"size\":{\"w\":2,\"h\":1.5}}"));
+    CHECK(JObject::makeList({}).getList().empty());
+}
+
+TEST_CASE(subscriptInsertsMissingKeys)
+{
+    JObject jo;
+    jo["a"]["b"] = 1;
+    CHECK(jo["a"]["b"].getInt() == 1);
+    CHECK(jo.hasMember("a"));
+    const JObject& constJo = jo;
+    CHECK_THROWS(constJo["missing"], std::out_of_range);
+}
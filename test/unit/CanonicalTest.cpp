@@ -0,0 +1,77 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+#include <cstdint>
+
+using namespace qjson;
+
+TEST_CASE(canonicalFormSortsKeysAndDropsSpace)
+{
+    JObject jo = JParser::fastParse("{ \"b\" : [ 1 , 0.1 , 1e300 ], \"a\" : { \"z\": true, \"\\u00e9\": null, \"Z\": \"\\n\" } }");
+    CHECK(JWriter().canonicalWrite(jo) == "{\"a\":{\"Z\":\"\\n\",\"z\":true,\"\xc3\xa9\":null},\"b\":[1,0.1,1e+300]}");
+}
+
+TEST_CASE(equalValuesHaveEqualCanonicalBytes)
+{
+    JObject a = JParser::fastParse("{\"k\":[1,2],\"j\":{\"x\":1,\"y\":2}}");
+    JObject b(JValueType::JDict);
+    b["j"]["y"] = 2;
+    b["j"]["x"] = 1;
+    b["k"].push_back(1);
+    b["k"].push_back(2);
+
+    std::uint64_t digestA = 0;
+    std::uint64_t digestB = 0;
+    JWriter writer;
+    std::string textA = writer.canonicalWrite(a, digestA);
+    std::string textB = writer.canonicalWrite(b, digestB);
+    CHECK(textA == textB);
+    CHECK(digestA == digestB && digestA != 0);
+    CHECK(JWriter::fastCanonicalWrite(a) == textA);
+
+    b["k"].push_back(3);
+    writer.canonicalWrite(b, digestB);
+    CHECK(digestA != digestB);
+}
+
+TEST_CASE(canonicalDoublesReadBack)
+{
+    for (long double value : { 0.1L, 1.0L / 3, 123456.789L, -2.5e-10L, 1e21L })
+    {
+        JObject jo = JParser::fastParse(JWriter().canonicalWrite(JObject(static_cast<double>(value))));
+        CHECK(static_cast<double>(jo.getDouble()) == static_cast<double>(value));
+    }
+}
+
+TEST_CASE(canonicalWriteReadsShapedDictsInPlace)
+{
+    const char* data = "[{\"b\":1,\"a\":{\"y\":2,\"x\":1}},{\"b\":2,\"a\":{\"y\":4,\"x\":3}},{\"b\":3,\"a\":{\"y\":6,\"x\":5}}]";
+    JObject shaped = JParser().parse(data);
+    const JObject& constShaped = shaped;
+    CHECK(constShaped[2].isShaped());
+    JParserOptions options;
+    options.shareShapes = false;
+    JObject plain = JParser(options).parse(data);
+
+    // Shaped dicts are sorted through their shape, without building a dict_t.
+    size_t dicts = shaped.memoryUsage().dicts;
+    std::string text = JWriter().canonicalWrite(shaped);
+    CHECK(shaped.memoryUsage().dicts == dicts);
+    CHECK(text == JWriter().canonicalWrite(plain));
+    CHECK(text == "[{\"a\":{\"x\":1,\"y\":2},\"b\":1},{\"a\":{\"x\":3,\"y\":4},\"b\":2},{\"a\":{\"x\":5,\"y\":6},\"b\":3}]");
+}
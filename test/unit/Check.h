@@ -0,0 +1,82 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#ifndef QUQI_TEST_CHECK_HPP
+#define QUQI_TEST_CHECK_HPP
+
+#include <vector>
+
+namespace qtest
+{
+    /**
+     * @brief A test case, registered by TEST_CASE before main() runs.
+     */
+    struct TestCase
+    {
+        const char* name; ///< The name of the test function.
+        void (*run)(); ///< The test function.
+    };
+
+    /**
+     * @brief Gets the registered test cases, in the order they were registered.
+     * @return The test cases.
+     */
+    std::vector<TestCase>& registry();
+
+    /**
+     * @brief Records a failed check in the running test case.
+     * @param expression The text of the check.
+     * @param file The file of the check.
+     * @param line The line of the check.
+     */
+    void fail(const char* expression, const char* file, int line);
+
+    struct Registrar
+    {
+        Registrar(const char* name, void (*run)())
+        {
+            registry().push_back({ name, run });
+        }
+    };
+}
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static const qtest::Registrar name##Registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+            qtest::fail(#condition, __FILE__, __LINE__); \
+    } while (false)
+
+#define CHECK_THROWS(statement, exception) \
+    do \
+    { \
+        bool thrown = false; \
+        try \
+        { \
+            statement; \
+        } \
+        catch (const exception&) \
+        { \
+            thrown = true; \
+        } \
+        if (!thrown) \
+            qtest::fail(#statement " throws " #exception, __FILE__, __LINE__); \
+    } while (false)
+
+#endif // !QUQI_TEST_CHECK_HPP
@@ -0,0 +1,96 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Allocations.h"
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+#include <string>
+
+using namespace qjson;
+
+namespace
+{
+    std::string records(size_t count)
+    {
+        std::string data = "[";
+        for (size_t i = 0; i < count; i++)
+        {
+            if (i > 0)
+                data += ',';
+            data += "{\"id\":" + std::to_string(i) + ",\"name\":\"record number " + std::to_string(i) +
+                "\",\"tags\":[\"a\",\"b\"],\"score\":1.5}";
+        }
+        return data + "]";
+    }
+}
+
+TEST_CASE(compactKeepsTheValue)
+{
+    std::string data = records(100);
+    JObject jo = JParser().parse(data);
+    JObject copy = jo;
+    jo.compact();
+    CHECK(jo == JParser().parse(data));
+    CHECK(jo[3].isShaped());
+    CHECK(copy == jo);
+    CHECK(jo.memoryUsage().lists <= copy.memoryUsage().lists);
+}
+
+TEST_CASE(memoryUsageCountsByCategory)
+{
+    JParserOptions options;
+    options.shareShapes = false;
+    JObject jo = JParser(options).parse("{\"a\": [1, 2, 3], \"b\": [\"a string too long to be stored inline\", {}]}");
+    JMemoryUsage usage = jo.memoryUsage();
+    CHECK(usage.nodes > 0);
+    CHECK(usage.strings >= 37);
+    CHECK(usage.lists >= 3 * sizeof(std::int64_t));
+    CHECK(usage.dicts > 0);
+    CHECK(usage.shapes == 0);
+    CHECK(usage.total() == usage.nodes + usage.strings + usage.lists + usage.dicts + usage.shapes + usage.sources);
+}
+
+TEST_CASE(compactGivesBackEmptiedBlocks)
+{
+    size_t before = qtest::allocatedBytes();
+    JObject jo = JParser().parse(records(20000));
+    jo.compact();
+    CHECK(qtest::allocatedBytes() - before > 1024 * 1024);
+
+    // Dropping the records frees every arena block but the one holding the root.
+    jo.getList().clear();
+    jo.getList().shrink_to_fit();
+    CHECK(qtest::allocatedBytes() - before < 64 * 1024);
+}
+
+TEST_CASE(editedCompactDocumentsShrink)
+{
+    size_t before = qtest::allocatedBytes();
+    JObject jo = JParser().parse(records(5000));
+    jo.compact();
+    size_t compacted = qtest::allocatedBytes() - before;
+
+    // Replacing every record with a shared copy moves it out of the arena, which gives its blocks back.
+    JObject replacement = JParser().parse(records(1))[0];
+    for (JObject& record : jo.getList())
+        record = replacement;
+    CHECK(qtest::allocatedBytes() - before < compacted / 10);
+
+    JObject expected(JValueType::JList);
+    for (int i = 0; i < 5000; i++)
+        expected.push_back(replacement);
+    CHECK(jo == expected);
+}
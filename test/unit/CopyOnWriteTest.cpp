@@ -0,0 +1,64 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+using namespace qjson;
+
+TEST_CASE(copiesShareUntilModified)
+{
+    JObject original = JParser::fastParse("{\"a\":[1,2,3],\"b\":{\"c\":\"x\"}}");
+    JObject copy = original;
+    const JObject& constOriginal = original;
+    const JObject& constCopy = copy;
+    CHECK(&constOriginal["b"]["c"].getString() == &constCopy["b"]["c"].getString());
+
+    copy["b"]["c"] = "y";
+    CHECK(constOriginal["b"]["c"].getString() == "x");
+    CHECK(constCopy["b"]["c"].getString() == "y");
+    // The untouched subtree is still shared.
+    CHECK(&constOriginal["a"].getList() == &constCopy["a"].getList());
+}
+
+TEST_CASE(modifyingTheOriginalLeavesCopiesAlone)
+{
+    JObject original = JParser::fastParse("[{\"k\":1},{\"k\":2}]");
+    JObject copy = original;
+    original[0]["k"] = 10;
+    original.push_back(3);
+    CHECK(copy.getList().size() == 2);
+    CHECK(copy[0]["k"].getInt() == 1);
+    CHECK(original[0]["k"].getInt() == 10);
+}
+
+TEST_CASE(mutableReferencesAreNotSeenByLaterCopies)
+{
+    JObject original(JValueType::JList);
+    original.push_back(1);
+    long long& first = original[0].getInt();
+    JObject copy = original;
+    first = 5;
+    CHECK(original[0].getInt() == 5);
+    CHECK(copy[0].getInt() == 1);
+}
+
+TEST_CASE(assignmentFromOwnChild)
+{
+    JObject jo = JParser::fastParse("{\"a\":{\"b\":[1,{\"c\":true}]}}");
+    jo = jo["a"]["b"];
+    CHECK(jo.getList().size() == 2);
+    CHECK(jo[1]["c"].getBool());
+}
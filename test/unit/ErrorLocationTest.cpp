@@ -0,0 +1,86 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Ini.h>
+#include <QuqiParser/Json.h>
+
+#include <string>
+
+using namespace qjson;
+using namespace qini;
+
+TEST_CASE(describeComputesLineAndColumn)
+{
+    std::string data = "{\n  \"a\": 1,\n  \"b\": tru\n}";
+    JParseError error = JParser().tryParse(data).error;
+    CHECK(error.code == JErrorCode::InvalidLiteral);
+    CHECK(error.describe(data) == "Invalid literal at line 3, column 8:\n  \"b\": tru\n       ^");
+}
+
+TEST_CASE(describeKeepsTabsAndDropsCarriageReturns)
+{
+    std::string data = "[\r\n\t1,\r\n\t?]";
+    JParseError error = JParser().tryParse(data).error;
+    CHECK(error.offset == 9);
+    CHECK(error.describe(data) == "Unexpected character at line 3, column 2:\n\t?]\n\t^");
+}
+
+TEST_CASE(describeCutsLongLines)
+{
+    std::string data = "[" + std::string(100, '1') + ", x" + std::string(100, ' ') + "]";
+    JParseError error = JParser().tryParse(data).error;
+    std::string message = error.describe(data);
+    CHECK(message.find("at line 1, column 104:\n...") == message.find("at line"));
+    std::string excerpt = message.substr(message.find('\n') + 1);
+    std::string text = excerpt.substr(0, excerpt.find('\n'));
+    std::string caret = excerpt.substr(excerpt.find('\n') + 1);
+    CHECK(text.size() == 3 + 80 + 3);
+    CHECK(caret.size() == 3 + 40 + 1);
+    CHECK(text[caret.size() - 1] == 'x');
+}
+
+TEST_CASE(parseMessageHasTheLocation)
+{
+    std::string message;
+    try
+    {
+        JParser().parse("[1,\n 2,\n x]");
+    }
+    catch (const std::logic_error& e)
+    {
+        message = e.what();
+    }
+    CHECK(message.find("line 3, column 2") != std::string::npos);
+}
+
+TEST_CASE(iniDescribeComputesLineAndColumn)
+{
+    std::string data = "[a]\nx=1\n; note\n[b]\ny 2\n";
+    INIParseError error = INIParser().tryParse(data).error;
+    CHECK(error.code == INIErrorCode::UnexpectedCharacter);
+    CHECK(error.describe(data) == "Unexpected character at line 5, column 2:\ny 2\n ^");
+
+    std::string message;
+    try
+    {
+        INIParser().parse(data);
+    }
+    catch (const std::logic_error& e)
+    {
+        message = e.what();
+    }
+    CHECK(message == error.describe(data));
+}
@@ -0,0 +1,57 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+#include <unordered_set>
+
+using namespace qjson;
+
+TEST_CASE(equalValuesHashEqual)
+{
+    JObject a = JParser::fastParse("{\"x\":[1,2.5,\"s\"],\"y\":{\"z\":null},\"w\":true}");
+    JObject b = JParser::fastParse("{\"w\":true,\"y\":{\"z\":null},\"x\":[1,2.5,\"s\"]}");
+    CHECK(a == b);
+    CHECK(a.hash() == b.hash());
+    CHECK(std::hash<JObject>{}(a) == a.hash());
+}
+
+TEST_CASE(hashFollowsModifications)
+{
+    JObject a = JParser::fastParse("{\"x\":[1,2,3]}");
+    size_t before = a.hash();
+    JObject copy = a;
+    a["x"][1] = 5;
+    CHECK(a.hash() != before);
+    CHECK(copy.hash() == before);
+    a["x"][1] = 2;
+    CHECK(a.hash() == before);
+    CHECK(a == copy);
+}
+
+TEST_CASE(distinguishesTypesAndOrder)
+{
+    CHECK(!(JParser::fastParse("[1,2]") == JParser::fastParse("[2,1]")));
+    CHECK(!(JParser::fastParse("[1]") == JParser::fastParse("[1.5]")));
+    CHECK(!(JParser::fastParse("{\"a\":1}") == JParser::fastParse("{\"a\":1,\"b\":1}")));
+    CHECK(!(JObject("1") == JObject(1)));
+
+    std::unordered_set<JObject> set;
+    set.insert(JParser::fastParse("{\"a\":[1]}"));
+    set.insert(JParser::fastParse("{ \"a\" : [ 1 ] }"));
+    set.insert(JParser::fastParse("{\"a\":[2]}"));
+    CHECK(set.size() == 2);
+}
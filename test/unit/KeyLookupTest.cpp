@@ -0,0 +1,94 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Allocations.h"
+#include "Check.h"
+
+#include <QuqiParser/Ini.h>
+#include <QuqiParser/Json.h>
+
+#include <string>
+#include <utility>
+
+using namespace qjson;
+using namespace qini;
+
+namespace
+{
+    // Longer than any short-string buffer, so a temporary std::string would allocate.
+    constexpr const char* longKey = "a_member_name_that_is_too_long_for_sso_0123456789";
+}
+
+TEST_CASE(keyLookupDoesntAllocate)
+{
+    JParserOptions options;
+    options.shareShapes = false;
+    const JObject jo = JParser(options).parse(std::string("{\"") + longKey + "\": 1, \"b\": 2}");
+    const JKey key(longKey);
+    size_t before = qtest::allocationCount();
+    long long sum = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        sum += jo[longKey].getInt();
+        sum += jo[key].getInt();
+        sum += jo.find(std::string_view(longKey))->getInt();
+        sum += jo.hasMember(key) ? 1 : 0;
+    }
+    CHECK(qtest::allocationCount() == before);
+    CHECK(sum == 400);
+}
+
+TEST_CASE(keyLookupWorksOnSharedShapes)
+{
+    JObject jo = JParser().parse(std::string("[{\"") + longKey + "\": 1}, {\"" + longKey + "\": 2}]");
+    const JObject& second = jo[1];
+    const JKey key(longKey);
+    const JKey other(std::string(longKey) + "_other");
+    size_t before = qtest::allocationCount();
+    CHECK(second[key].getInt() == 2);
+    CHECK(second.find(key) == &second[longKey]);
+    CHECK(second.hasMember(longKey));
+    CHECK(!second.hasMember(other));
+    CHECK(qtest::allocationCount() == before);
+}
+
+TEST_CASE(keyHandleMatchesStringLookup)
+{
+    JKey key("name");
+    CHECK(key.str() == "name");
+    CHECK(key.hash() == key_hash_t{}(std::string_view("name")));
+    CHECK(key == "name");
+
+    JObject jo;
+    jo[key] = 5;
+    CHECK(jo["name"].getInt() == 5);
+    CHECK(jo.getDict().find(key) != jo.getDict().end());
+    CHECK(jo.find(JKey("missing")) == nullptr);
+    CHECK_THROWS(std::as_const(jo)[JKey("missing")], std::out_of_range);
+}
+
+TEST_CASE(iniLookupTakesStringView)
+{
+    INIObject ini = INIParser().parse("[server]\nport=80\n");
+    std::string_view section = "server";
+    std::string_view name = "port";
+    CHECK(ini[section][name] == "80");
+    CHECK(*ini.find(section, name) == "80");
+    const INIObject& constIni = ini;
+    CHECK(constIni[section][name] == "80");
+    CHECK_THROWS(constIni[section][std::string_view("host")], std::logic_error);
+
+    ini[section][std::string_view("host")] = "local";
+    CHECK(*ini.find("server", "host") == "local");
+}
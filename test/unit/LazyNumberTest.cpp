@@ -0,0 +1,105 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+#include <thread>
+#include <vector>
+
+using namespace qjson;
+
+namespace
+{
+    JObject parseLazy(std::string_view data)
+    {
+        JParserOptions options;
+        options.lazyNumbers = true;
+        return JParser(options).parse(data);
+    }
+}
+
+TEST_CASE(lazyNumbersAreWrittenAsParsed)
+{
+    std::string data = "[1.50,1e2,-0,18446744073709551615,99999999999999999999999,0.100000000000000000000001]";
+    JObject jo = parseLazy(data);
+    CHECK(JWriter().write(jo) == data);
+    const JObject& constJo = jo;
+    CHECK(constJo[0].getLexeme() == "1.50");
+    CHECK(constJo[4].getLexeme() == "99999999999999999999999");
+    CHECK(!jo.isPacked());
+}
+
+TEST_CASE(lazyNumbersDecodeOnAccess)
+{
+    JObject jo = parseLazy("{\"i\":-42,\"d\":2.5e-1,\"u\":18446744073709551615,\"big\":1e400}");
+    const JObject& constJo = jo;
+    CHECK(constJo["i"].getType() == JValueType::JInt);
+    CHECK(constJo["i"].getInt() == -42);
+    CHECK(constJo["d"].getDouble() == 0.25);
+    CHECK(constJo["u"].getUInt() == 18446744073709551615ULL);
+    CHECK_THROWS(constJo["i"].getUInt(), std::logic_error);
+    CHECK_THROWS(constJo["d"].getInt(), std::logic_error);
+    CHECK(jo == JParser().parse("{\"i\":-42,\"d\":0.25,\"u\":18446744073709551615,\"big\":1e400}"));
+}
+
+TEST_CASE(lazyNumbersEqualEagerOnes)
+{
+    std::string data = "[1,2.5,-3,{\"a\":[0.1,7]}]";
+    JObject lazy = parseLazy(data);
+    JObject eager = JParser().parse(data);
+    CHECK(lazy == eager);
+    CHECK(lazy.hash() == eager.hash());
+    CHECK(JWriter().canonicalWrite(lazy) == JWriter().canonicalWrite(eager));
+}
+
+TEST_CASE(mutableAccessDropsTheLexeme)
+{
+    JObject jo = parseLazy("[1.50,7]");
+    jo[0].getDouble() += 1;
+    jo[1] = 8;
+    const JObject& constJo = jo;
+    CHECK(constJo[0].getLexeme().empty());
+    CHECK(constJo[0].getDouble() == 2.5);
+    CHECK(JParser().parse(JWriter().write(jo)) == JParser().parse("[2.5,8]"));
+}
+
+TEST_CASE(lazyNumbersDecodeOnceAcrossThreads)
+{
+    JObject jo = parseLazy("[3.25,12345678901]");
+    const JObject& constJo = jo;
+    std::vector<std::thread> threads;
+    std::vector<int> correct(8, 0);
+    for (size_t t = 0; t < correct.size(); t++)
+    {
+        threads.emplace_back([&constJo, &correct, t]()
+            {
+                correct[t] = constJo[0].getDouble() == 3.25 && constJo[1].getInt() == 12345678901;
+            });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    for (int ok : correct)
+        CHECK(ok);
+}
+
+TEST_CASE(lazyNumbersKeepTheGrammar)
+{
+    JParserOptions options;
+    options.lazyNumbers = true;
+    JParser parser(options);
+    for (std::string_view data : { "[-]", "[1.]", "[.5]", "[1e]", "[+1]", "[1e+]" })
+        CHECK_THROWS(parser.parse(data), std::logic_error);
+}
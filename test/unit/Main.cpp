@@ -0,0 +1,65 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+namespace
+{
+    size_t failures = 0; ///< The failed checks of the running test case.
+}
+
+std::vector<qtest::TestCase>& qtest::registry()
+{
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+void qtest::fail(const char* expression, const char* file, int line)
+{
+    std::cout << "    " << file << ":" << line << ": CHECK(" << expression << ") failed\n";
+    failures++;
+}
+
+int main(int argc, char** argv)
+{
+    // An optional argument runs only the test cases whose name contains it.
+    const char* filter = argc > 1 ? argv[1] : "";
+    size_t run = 0;
+    size_t failed = 0;
+    for (const qtest::TestCase& test : qtest::registry())
+    {
+        if (std::strstr(test.name, filter) == nullptr)
+            continue;
+        failures = 0;
+        try
+        {
+            test.run();
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "    unexpected exception: " << e.what() << '\n';
+            failures++;
+        }
+        run++;
+        if (failures != 0)
+            failed++;
+        std::cout << (failures == 0 ? "[  OK  ] " : "[ FAIL ] ") << test.name << '\n';
+    }
+    std::cout << run - failed << " of " << run << " test cases passed\n";
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+#include <QuqiParser/JsonPatch.h>
+#include <QuqiParser/JsonPersistent.h>
+
+#include <string>
+
+using namespace qjson;
+
+namespace
+{
+    JObject unpacked(std::string_view data)
+    {
+        // Lists of lazy numbers are never packed.
+        JParserOptions options;
+        options.lazyNumbers = true;
+        JObject jo = JParser(options).parse(data);
+        JObject result(JValueType::JList);
+        for (const JObject& element : jo.getList())
+        {
+            if (element.getType() == JValueType::JInt)
+                result.push_back(element.getInt());
+            else
+                result.push_back(element.getDouble());
+        }
+        return result;
+    }
+
+    std::string longIntList(int count)
+    {
+        std::string data = "[";
+        for (int i = 0; i < count; i++)
+            data += (i ? "," : "") + std::to_string(i * 3);
+        return data + "]";
+    }
+}
+
+TEST_CASE(numberListsArePacked)
+{
+    JObject ints = JParser().parse("[1,-2,3000000000]");
+    CHECK(ints.isPacked());
+    CHECK(ints.getInts().size() == 3);
+    CHECK(ints.getInts()[2] == 3000000000);
+
+    JObject doubles = JParser().parse("[0.5,-2.25,1e3]");
+    CHECK(doubles.isPacked());
+    CHECK(doubles.getDoubles()[1] == -2.25);
+
+    CHECK(!JParser().parse("[1,2.5]").isPacked());
+    CHECK(!JParser().parse("[1,\"x\"]").isPacked());
+}
+
+TEST_CASE(packedListsKeepParsedPrecision)
+{
+    for (std::string_view data : { "[0.1]", "[0.1,0.2,0.3]", "[0.5,0.1]", "[3.141592653589793238462643383279]" })
+    {
+        JObject parsed = JParser().parse(data);
+        CHECK(parsed == unpacked(data));
+        CHECK(parsed.hash() == unpacked(data).hash());
+        JObject single = JParser().parse(std::string(data.substr(1, data.find_first_of(",]") - 1)));
+        const JObject& constParsed = parsed;
+        CHECK(constParsed[0] == single);
+    }
+}
+
+TEST_CASE(packedListsEqualUnpackedOnes)
+{
+    JObject parsed = JParser().parse("[1,2,3]");
+    JObject built(JValueType::JList);
+    built.push_back(1);
+    built.push_back(2);
+    built.push_back(3);
+    CHECK(parsed == built);
+    CHECK(built == parsed);
+    built.push_back(4);
+    CHECK(!(parsed == built));
+
+    JObject doubles(JValueType::JList);
+    doubles.push_back(1);
+    doubles.push_back(2);
+    doubles.push_back(3.0);
+    CHECK(!(parsed == doubles));
+}
+
+TEST_CASE(constAccessDoesNotUnpack)
+{
+    JObject jo = JParser().parse(longIntList(1000));
+    const JObject& constJo = jo;
+    size_t before = jo.memoryUsage().total();
+    CHECK(constJo[10].getInt() == 30);
+    CHECK(constJo.find(999)->getInt() == 2997);
+    CHECK(constJo.find(1000) == nullptr);
+    CHECK(&constJo[10] == &constJo[10]);
+    CHECK(jo.isPacked());
+    // Only the two elements asked for are built, not all thousand.
+    CHECK(jo.memoryUsage().total() - before < 1000 * sizeof(JObject));
+}
+
+TEST_CASE(writersReadPackedNumbersInPlace)
+{
+    std::string data = "[1,2,3,4]";
+    JObject packed = JParser().parse(data);
+    JObject plain = unpacked(data);
+    size_t before = packed.memoryUsage().total();
+    JWriter writer;
+    CHECK(writer.write(packed) == writer.write(plain));
+    CHECK(writer.formatWrite(packed) == writer.formatWrite(plain));
+    CHECK(writer.canonicalWrite(packed) == writer.canonicalWrite(plain));
+    CHECK(writer.canonicalWrite(JParser().parse("[0.5,-0.0]")) == "[0.5,0.0]");
+    CHECK(packed.memoryUsage().total() == before);
+}
+
+TEST_CASE(diffAndPersistentReadPackedLists)
+{
+    JObject from = JParser().parse("{\"a\":[1,2,3,4]}");
+    JObject to = JParser().parse("{\"a\":[1,5,3,4,6]}");
+    JObject patch = JPatch::diff(from, to);
+    JObject document = from;
+    JPatch::apply(document, patch);
+    CHECK(document == to);
+
+    JObject mixed = JParser().parse("{\"a\":[1,[2],3]}");
+    patch = JPatch::diff(from, mixed);
+    document = from;
+    JPatch::apply(document, patch);
+    CHECK(document == mixed);
+    CHECK(from.memoryUsage().total() == JParser().parse("{\"a\":[1,2,3,4]}").memoryUsage().total());
+
+    JObject doubles = JParser().parse("[0.5,1.5]");
+    CHECK(JPersistentObject::fromJObject(doubles).toJObject() == doubles);
+    CHECK(JPersistentObject::fromJObject(from).toJObject() == from);
+}
+
+TEST_CASE(packedListsUnpackOnOtherValues)
+{
+    JObject jo = JParser().parse("[1,2]");
+    jo.push_back(3);
+    CHECK(jo.isPacked());
+    jo.push_back("x");
+    CHECK(!jo.isPacked());
+    CHECK(jo == JParser().parse("[1,2,3,\"x\"]"));
+
+    JObject doubles = JParser().parse("[0.5]");
+    doubles.push_back(1);
+    CHECK(!doubles.isPacked());
+    CHECK(doubles.getList()[1].getType() == JValueType::JInt);
+}
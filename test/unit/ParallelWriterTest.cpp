@@ -0,0 +1,107 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/JsonParallelWriter.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+using namespace qjson;
+
+namespace
+{
+    JObject sample()
+    {
+        JObject root(JValueType::JDict);
+        JObject& rows = root["rows"];
+        for (int i = 0; i < 3000; i++)
+        {
+            JObject& row = rows.emplace_back(JValueType::JDict);
+            row["id"] = i;
+            row["name"] = "n\\t\"" + std::to_string(i);
+            row["score"] = i * 0.5;
+            for (int k = 0; k < i % 5; k++)
+                row["tags"].push_back(k);
+        }
+        for (int i = 0; i < 2000; i++)
+            root["flags"][std::to_string(i).c_str()] = i % 3 == 0;
+        root["packed"] = JParser::fastParse("[1,2,3,4,5,6,7,8,9,10]");
+        root["empty"] = JObject(JValueType::JList);
+        return root;
+    }
+}
+
+TEST_CASE(parallelOutputIsByteIdentical)
+{
+    JObject root = sample();
+    std::string expected = JWriter().write(root);
+    for (size_t threads : { 1, 2, 4, 8 })
+    {
+        for (size_t chunk : { 1, 7, 64, 100000 })
+        {
+            JParallelWriter writer(threads, chunk);
+            CHECK(writer.write(root) == expected);
+            std::string joined;
+            for (const std::string& piece : writer.writeChunks(root))
+                joined += piece;
+            CHECK(joined == expected);
+        }
+    }
+    JParallelWriter writer(4, 1);
+    for (JObject small : { JObject(1), JObject("s"), JObject(JValueType::JList), JObject(JValueType::JDict), JObject() })
+        CHECK(writer.write(small) == JWriter().write(small));
+}
+
+TEST_CASE(parallelWriterReusesItsWorkers)
+{
+    JObject root = sample();
+    std::string expected = JWriter().write(root);
+    JParallelWriter writer(4, 16);
+    for (int i = 0; i < 50; i++)
+        CHECK(writer.write(root) == expected);
+
+    std::vector<std::jthread> callers;
+    for (int t = 0; t < 4; t++)
+        callers.emplace_back([&]
+            {
+                for (int i = 0; i < 10; i++)
+                    CHECK(writer.write(root) == expected);
+            });
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST_CASE(parallelWriterWritesToFileDescriptor)
+{
+    JObject root = sample();
+    std::string expected = JWriter().write(root);
+    std::FILE* file = std::tmpfile();
+    CHECK(file != nullptr);
+    size_t written = JParallelWriter(4, 32).writeTo(fileno(file), root);
+    CHECK(written == expected.size());
+
+    std::string back(written, '\0');
+    std::rewind(file);
+    CHECK(std::fread(back.data(), 1, back.size(), file) == back.size());
+    std::fclose(file);
+    CHECK(back == expected);
+}
+#endif
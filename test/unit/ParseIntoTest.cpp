@@ -0,0 +1,100 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+using namespace qjson;
+
+TEST_CASE(parseIntoMatchesParse)
+{
+    JParser parser;
+    JObject jo;
+    for (std::string_view data : { "{\"a\":[1,2.5,\"x\"],\"b\":{\"c\":null}}", "[true,false,{}]", "\"text\"", "42" })
+    {
+        parser.parseInto(data, jo);
+        CHECK(jo == JParser().parse(data));
+    }
+}
+
+TEST_CASE(parseIntoReusesBuffers)
+{
+    JParser parser;
+    JObject jo;
+    parser.parseInto("[{\"name\":\"a long string that is not stored inline\",\"id\":1},{\"name\":\"b\",\"id\":2}]", jo);
+    const JObject& constJo = jo;
+    const list_t* list = &constJo.getList();
+    const JObject* first = list->data();
+    const char* name = constJo[0]["name"].getString().data();
+
+    parser.parseInto("[{\"name\":\"a shorter string, still not inline\",\"id\":3},{\"name\":\"c\",\"id\":4}]", jo);
+    CHECK(&constJo.getList() == list);
+    CHECK(constJo.getList().data() == first);
+    CHECK(constJo[0]["name"].getString().data() == name);
+    CHECK(constJo[0]["name"].getString() == "a shorter string, still not inline");
+    CHECK(constJo[1]["id"].getInt() == 4);
+}
+
+TEST_CASE(parseIntoKeepsListCapacity)
+{
+    JParser parser;
+    JObject jo;
+    parser.parseInto("[\"a\",\"b\",\"c\",\"d\"]", jo);
+    const JObject& constJo = jo;
+    const JObject* data = constJo.getList().data();
+    parser.parseInto("[\"e\"]", jo);
+    CHECK(constJo.getList().size() == 1);
+    CHECK(constJo.getList().data() == data);
+    CHECK(constJo[0].getString() == "e");
+}
+
+TEST_CASE(parseIntoHandlesShapeChanges)
+{
+    JParser parser;
+    JObject jo;
+    parser.parseInto("{\"a\":1,\"b\":[1,2]}", jo);
+    parser.parseInto("{\"b\":\"x\",\"c\":{\"d\":true}}", jo);
+    CHECK(jo == JParser().parse("{\"b\":\"x\",\"c\":{\"d\":true}}"));
+    parser.parseInto("[1,2,3]", jo);
+    CHECK(jo == JParser().parse("[1,2,3]"));
+}
+
+TEST_CASE(parseIntoLeavesCopiesAlone)
+{
+    JParser parser;
+    JObject jo;
+    parser.parseInto("{\"a\":[\"x\",\"y\"],\"b\":\"z\"}", jo);
+    JObject copy = jo;
+    parser.parseInto("{\"a\":[\"p\"],\"b\":\"q\"}", jo);
+    CHECK(copy == JParser().parse("{\"a\":[\"x\",\"y\"],\"b\":\"z\"}"));
+    CHECK(jo == JParser().parse("{\"a\":[\"p\"],\"b\":\"q\"}"));
+}
+
+TEST_CASE(parseIntoFailureLeavesValidTarget)
+{
+    JParser parser;
+    JObject jo;
+    parser.parseInto("[1,2,3]", jo);
+    CHECK_THROWS(parser.parseInto("[4,5,", jo), std::logic_error);
+    CHECK(jo.getType() == JValueType::JList);
+    JWriter().write(jo);
+
+    JParseError error = parser.tryParseInto("{\"a\":}", jo);
+    CHECK(static_cast<bool>(error));
+    CHECK(error.code == JErrorCode::UnexpectedCharacter);
+
+    parser.parseInto("{\"a\":1}", jo);
+    CHECK(jo == JParser().parse("{\"a\":1}"));
+}
@@ -0,0 +1,126 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+#include <stdexcept>
+#include <string>
+
+using namespace qjson;
+
+namespace
+{
+    std::string nested(size_t depth)
+    {
+        return std::string(depth, '[') + std::string(depth, ']');
+    }
+
+    std::string nestedDicts(size_t depth)
+    {
+        std::string data;
+        for (size_t i = 0; i < depth; i++)
+            data += "{\"a\":";
+        return data + "1" + std::string(depth, '}');
+    }
+}
+
+TEST_CASE(parsesDeepInputWithoutRecursion)
+{
+    JObject jo = JParser::fastParse(nested(200000));
+    const JObject* node = &jo;
+    size_t depth = 1;
+    while (!node->getList().empty())
+    {
+        node = &node->getList()[0];
+        depth++;
+    }
+    CHECK(depth == 200000);
+
+    JObject copy = jo;
+    CHECK(copy == jo);
+    jo = JObject();
+    CHECK(copy.getType() == JValueType::JList);
+}
+
+TEST_CASE(destroysDeepShapedDictsWithoutRecursion)
+{
+    // getDict() const gives each shaped dict a dict_t sharing its values,
+    // which must not make the teardown recursive.
+    JObject jo = JParser::fastParse(nestedDicts(200000));
+    const JObject* node = &jo;
+    CHECK(node->getDict().at("a").isShaped());
+    size_t depth = 0;
+    while (node->getType() == JValueType::JDict)
+    {
+        node = &node->getDict().at("a");
+        depth++;
+    }
+    CHECK(depth == 200000);
+    CHECK(node->getInt() == 1);
+    CHECK(JWriter().canonicalWrite(jo).size() == 200000 * 6 + 1);
+    jo = JObject();
+    CHECK(jo.getType() == JValueType::JNull);
+}
+
+TEST_CASE(enforcesDepthLimit)
+{
+    JParserOptions options;
+    options.maxDepth = 3;
+    JParser parser(options);
+    CHECK(parser.parse("[[[1]]]")[0][0][0].getInt() == 1);
+    CHECK(parser.parse("{\"a\":[{}]}").hasMember("a"));
+    CHECK_THROWS(parser.parse("[[[[1]]]]"), std::logic_error);
+    CHECK_THROWS(parser.parse("{\"a\":[{\"b\":[]}]}"), std::logic_error);
+}
+
+TEST_CASE(enforcesSizeLimit)
+{
+    JParserOptions options;
+    options.maxSize = 8;
+    JParser parser(options);
+    CHECK(parser.parse("[1,2,3]").getList().size() == 3);
+    CHECK_THROWS(parser.parse("[1,2,3,4]"), std::logic_error);
+}
+
+TEST_CASE(enforcesNodeLimit)
+{
+    JParserOptions options;
+    options.maxNodes = 4;
+    JParser parser(options);
+    CHECK(parser.parse("[1,2,3]").getList().size() == 3);
+    CHECK(parser.parse("{\"a\":1,\"b\":[]}").getDict().size() == 2);
+    CHECK_THROWS(parser.parse("[1,2,3,4]"), std::logic_error);
+    CHECK_THROWS(parser.parse("[[],[],[],[]]"), std::logic_error);
+}
+
+TEST_CASE(parsesAllValueTypes)
+{
+    JObject jo = JParser::fastParse(" {\"i\": -12, \"d\": 2.5e1, \"b\": true, \"n\": null,"
+        " \"s\": \"a\\\"b\", \"l\": [false, {}], \"o\": {\"k\": []}} ");
+    CHECK(jo["i"].getInt() == -12);
+    CHECK(jo["d"].getDouble() == 25);
+    CHECK(jo["b"].getBool());
+    CHECK(jo["n"].getType() == JValueType::JNull);
+    CHECK(jo["s"].getString() == "a\"b");
+    CHECK(jo["l"].getList().size() == 2 && !jo["l"][0].getBool());
+    CHECK(jo["o"]["k"].getList().empty());
+}
+
+TEST_CASE(rejectsMalformedInput)
+{
+    for (const char* data : { "", "[", "[1", "{\"a\"", "{\"a\":}", "[1 2]", "tru", "nul", "\"abc", "{1:2}" })
+        CHECK_THROWS(JParser::fastParse(data), std::logic_error);
+}
@@ -0,0 +1,75 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/JsonPatch.h>
+
+#include <stdexcept>
+
+using namespace qjson;
+
+TEST_CASE(appliesEveryPatchOperation)
+{
+    JObject document = JParser::fastParse("{\"a\":{\"b\":[1,2]},\"c\":\"x\",\"d\":1}");
+    JPatch::apply(document, JParser::fastParse(R"([
+        {"op":"add","path":"/a/b/1","value":9},
+        {"op":"add","path":"/a/b/-","value":3},
+        {"op":"remove","path":"/d"},
+        {"op":"replace","path":"/c","value":"y"},
+        {"op":"move","from":"/c","path":"/e"},
+        {"op":"copy","from":"/a/b","path":"/f"},
+        {"op":"test","path":"/f/0","value":1}
+    ])"));
+    CHECK(document == JParser::fastParse("{\"a\":{\"b\":[1,9,2,3]},\"e\":\"y\",\"f\":[1,9,2,3]}"));
+}
+
+TEST_CASE(failedPatchRollsBack)
+{
+    JObject document = JParser::fastParse("{\"a\":[1,2],\"b\":true}");
+    JObject before = document;
+    JObject patch = JParser::fastParse(R"([
+        {"op":"remove","path":"/a/0"},
+        {"op":"add","path":"/c","value":1},
+        {"op":"test","path":"/b","value":false}
+    ])");
+    CHECK_THROWS(JPatch::apply(document, patch), std::logic_error);
+    CHECK(document == before);
+    CHECK_THROWS(JPatch::apply(document, JParser::fastParse(R"([{"op":"remove","path":"/missing"}])")), std::logic_error);
+    CHECK(document == before);
+}
+
+TEST_CASE(diffRoundTrips)
+{
+    JObject from = JParser::fastParse("{\"a\":[1,2,3],\"b\":{\"c\":1,\"d\":2},\"e\":\"s\",\"~/\":0}");
+    JObject to = JParser::fastParse("{\"a\":[1,3,4,5],\"b\":{\"c\":1,\"x\":[]},\"f\":null,\"~/\":1}");
+    JObject patch = JPatch::diff(from, to);
+    JObject document = from;
+    JPatch::apply(document, patch);
+    CHECK(document == to);
+    CHECK(JPatch::diff(to, to).getList().empty());
+}
+
+TEST_CASE(mergePatchRoundTrips)
+{
+    JObject document = JParser::fastParse("{\"a\":\"b\",\"c\":{\"d\":\"e\",\"f\":\"g\"}}");
+    JPatch::applyMerge(document, JParser::fastParse("{\"a\":\"z\",\"c\":{\"f\":null}}"));
+    CHECK(document == JParser::fastParse("{\"a\":\"z\",\"c\":{\"d\":\"e\"}}"));
+
+    JObject from = JParser::fastParse("{\"a\":1,\"b\":{\"c\":[1],\"d\":2},\"e\":3}");
+    JObject to = JParser::fastParse("{\"a\":1,\"b\":{\"c\":[2]},\"f\":{\"g\":true}}");
+    JObject merged = from;
+    JPatch::applyMerge(merged, JPatch::mergeDiff(from, to));
+    CHECK(merged == to);
+}
@@ -0,0 +1,89 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/JsonPersistent.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace qjson;
+
+TEST_CASE(deepPersistentValuesConvertAndDestroy)
+{
+    const size_t depth = 100000;
+    JObject jo = JParser::fastParse(std::string(depth, '[') + "1" + std::string(depth, ']'));
+    {
+        JPersistentObject value = JPersistentObject::fromJObject(jo);
+        JObject back = value.toJObject();
+        CHECK(back == jo);
+    }
+
+    JObject dicts;
+    JObject* node = &dicts;
+    for (size_t i = 0; i < depth; i++)
+        node = &(*node)["k"];
+    *node = 1;
+    JPersistentObject value = JPersistentObject::fromJObject(dicts);
+    JPersistentObject copy = value;
+    value = JPersistentObject();
+    CHECK(copy.toJObject() == dicts);
+}
+
+TEST_CASE(updatesReturnNewVersions)
+{
+    JPersistentObject list(JValueType::JList);
+    for (int i = 0; i < 1000; i++)
+        list = list.push_back(i);
+    JPersistentObject changed = list.set(500, "x").pop_back();
+    CHECK(list.size() == 1000 && list[500].getInt() == 500 && list[999].getInt() == 999);
+    CHECK(changed.size() == 999 && changed[500].getString() == "x" && changed[499].getInt() == 499);
+
+    JPersistentObject dict(JValueType::JDict);
+    for (int i = 0; i < 1000; i++)
+        dict = dict.set(std::to_string(i), i);
+    JPersistentObject erased = dict.erase("7").set("new", true);
+    CHECK(dict.size() == 1000 && dict.hasMember("7") && !dict.hasMember("new"));
+    CHECK(erased.size() == 1000 && !erased.hasMember("7") && erased["new"].getBool());
+    CHECK(erased["999"].getInt() == 999 && erased.find("missing") == nullptr);
+}
+
+TEST_CASE(roundTripsThroughJObject)
+{
+    JObject jo = JParser::fastParse("{\"a\":[1,2.5,\"s\",true,null],\"b\":{\"c\":{}},\"d\":[]}");
+    CHECK(JPersistentObject::fromJObject(jo).toJObject() == jo);
+}
+
+TEST_CASE(documentReadersSeeWholeVersions)
+{
+    JPersistentDocument document(JPersistentObject(JValueType::JList));
+    std::vector<std::jthread> readers;
+    for (int r = 0; r < 4; r++)
+        readers.emplace_back([&document]
+            {
+                for (int i = 0; i < 2000; i++)
+                {
+                    auto snapshot = document.load();
+                    size_t size = snapshot->size();
+                    if (size != 0)
+                        CHECK((*snapshot)[size - 1].getInt() == static_cast<long long>(size - 1));
+                }
+            });
+    for (int i = 0; i < 500; i++)
+        document.update([i](const JPersistentObject& current) { return current.push_back(i); });
+    readers.clear();
+    CHECK(document.load()->size() == 500);
+}
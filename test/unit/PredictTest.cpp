@@ -0,0 +1,99 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+#include <string>
+
+using namespace qjson;
+
+namespace
+{
+    JParser predictingParser()
+    {
+        JParserOptions options;
+        options.predictKeys = true;
+        return JParser(options);
+    }
+
+    std::string message(int id)
+    {
+        return "{\"id\":" + std::to_string(id) + ",\"user\":{\"name\":\"n" + std::to_string(id) +
+            "\",\"roles\":[\"a\"]},\"items\":[{\"sku\":1,\"qty\":2},{\"sku\":3,\"qty\":4}]}";
+    }
+}
+
+TEST_CASE(predictedMessagesMatchPlainParse)
+{
+    JParser parser = predictingParser();
+    JObject jo;
+    for (int i = 0; i < 5; i++)
+    {
+        parser.parseInto(message(i), jo);
+        CHECK(jo == JParser().parse(message(i)));
+    }
+    // After the first message, the root takes the learned shape.
+    CHECK(jo.isShaped());
+    const JObject& constJo = jo;
+    CHECK(constJo["user"]["name"].getString() == "n4");
+    CHECK(constJo["items"][1]["qty"].getInt() == 4);
+}
+
+TEST_CASE(mispredictedKeysFallBack)
+{
+    JParser parser = predictingParser();
+    JObject jo;
+    parser.parseInto(message(1), jo);
+    parser.parseInto(message(2), jo);
+
+    for (std::string_view data : {
+        "{\"user\":{\"name\":\"x\"},\"id\":1}",
+        "{\"id\":1,\"user\":{\"name\":\"x\",\"roles\":[]},\"items\":[],\"extra\":null}",
+        "{\"id\":1}",
+        "{\"i\\u0064\":1,\"user\":{},\"items\":[]}",
+        "{\"idx\":1,\"user\":2,\"items\":3}",
+        "{}" })
+    {
+        parser.parseInto(data, jo);
+        CHECK(jo == JParser().parse(data));
+    }
+
+    parser.parseInto(message(3), jo);
+    CHECK(jo == JParser().parse(message(3)));
+}
+
+TEST_CASE(predictionWorksWithParse)
+{
+    JParser parser = predictingParser();
+    for (int i = 0; i < 3; i++)
+        CHECK(parser.parse(message(i)) == JParser().parse(message(i)));
+    JObject other = parser.parse("[{\"id\":1},{\"id\":2}]");
+    CHECK(other == JParser().parse("[{\"id\":1},{\"id\":2}]"));
+}
+
+TEST_CASE(escapedKeysAreNotLearnedRaw)
+{
+    JParser parser = predictingParser();
+    JObject jo;
+    std::string data = "{\"a\\\"b\":1,\"c\":2}";
+    parser.parseInto(data, jo);
+    parser.parseInto(data, jo);
+    const JObject& constJo = jo;
+    CHECK(constJo["a\"b"].getInt() == 1);
+    parser.parseInto("{\"a\\\"c\":1,\"c\":2}", jo);
+    CHECK(constJo.hasMember("a\"c"));
+    CHECK(!constJo.hasMember("a\"b"));
+}
@@ -0,0 +1,111 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/JsonReader.h>
+
+#include <stdexcept>
+#include <vector>
+
+using namespace qjson;
+
+namespace
+{
+    std::vector<JTokenType> readAll(std::string_view data)
+    {
+        JReader reader(data);
+        std::vector<JTokenType> tokens;
+        while (reader.next() != JTokenType::End)
+            tokens.push_back(reader.getType());
+        return tokens;
+    }
+}
+
+TEST_CASE(readerReadsTokens)
+{
+    JReader reader("{ \"a\" : [ 1, -2.5e3, \"s\" ], \"b\" : true, \"c\" : null }");
+    CHECK(reader.next() == JTokenType::BeginObject);
+    CHECK(reader.next() == JTokenType::Key);
+    CHECK(reader.getString() == "a");
+    CHECK(reader.next() == JTokenType::BeginArray);
+    CHECK(reader.getDepth() == 2);
+    CHECK(reader.next() == JTokenType::Number);
+    CHECK(reader.getInt64() == 1);
+    CHECK(reader.next() == JTokenType::Number);
+    CHECK(reader.getDouble() == -2500.0);
+    CHECK(reader.getValue() == "-2.5e3");
+    CHECK(reader.next() == JTokenType::String);
+    CHECK(reader.getString() == "s");
+    CHECK(reader.next() == JTokenType::EndArray);
+    CHECK(reader.next() == JTokenType::Key);
+    CHECK(reader.next() == JTokenType::Bool);
+    CHECK(reader.getBool());
+    CHECK(reader.next() == JTokenType::Key);
+    CHECK(reader.getValue() == "c");
+    CHECK(reader.next() == JTokenType::Null);
+    CHECK(reader.next() == JTokenType::EndObject);
+    CHECK(reader.next() == JTokenType::End);
+}
+
+TEST_CASE(readerSkipsValues)
+{
+    JReader reader("{\"skip\":{\"x\":[1,[2,{}]]},\"keep\":7}");
+    reader.next();
+    reader.next();
+    reader.skip();
+    CHECK(reader.next() == JTokenType::Key);
+    CHECK(reader.getString() == "keep");
+    CHECK(reader.next() == JTokenType::Number);
+    CHECK(reader.getInt64() == 7);
+}
+
+TEST_CASE(readerDecodesEscapes)
+{
+    JReader reader("[\"a\\n\\t\\\"\\\\\\/b\"]");
+    reader.next();
+    reader.next();
+    CHECK(reader.getString() == "a\n\t\"\\/b");
+    CHECK(reader.getValue() == "a\\n\\t\\\"\\\\\\/b");
+}
+
+TEST_CASE(readerAcceptsJsonNumbers)
+{
+    for (std::string_view number : { "0", "-0", "7", "-120", "0.5", "-0.25", "1e5", "1E+5", "2.5e-3", "0e0" })
+    {
+        JReader reader(number);
+        CHECK(reader.next() == JTokenType::Number);
+        CHECK(reader.getValue() == number);
+    }
+    CHECK(readAll("[0,-1,2.0e1]").size() == 5);
+}
+
+TEST_CASE(readerRejectsInvalidNumbers)
+{
+    for (std::string_view number : { "-", "01", "-01", "00", "1.", ".5", "1.e5", "1e", "1e+", "+1", "--1",
+        "[1-2]", "[1e5e5]", "[0x10]", "[1.2.3]" })
+        CHECK_THROWS(readAll(number), std::logic_error);
+}
+
+TEST_CASE(readerRejectsMalformedInput)
+{
+    CHECK_THROWS(readAll(""), std::logic_error);
+    CHECK_THROWS(readAll("[1 2]"), std::logic_error);
+    CHECK_THROWS(readAll("{\"a\" 1}"), std::logic_error);
+    CHECK_THROWS(readAll("{1:2}"), std::logic_error);
+    CHECK_THROWS(readAll("[\"open"), std::logic_error);
+    CHECK_THROWS(readAll("[\"\\x\"]"), std::logic_error);
+    CHECK_THROWS(readAll("[tru]"), std::logic_error);
+    CHECK_THROWS(readAll("[1,"), std::logic_error);
+}
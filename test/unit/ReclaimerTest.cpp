@@ -0,0 +1,134 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Allocations.h"
+#include "Check.h"
+
+#include <QuqiParser/JsonReclaimer.h>
+
+#include <string>
+
+using namespace qjson;
+
+namespace
+{
+    JObject strings(size_t count)
+    {
+        JObject list(JValueType::JList);
+        list.reserve(count);
+        for (size_t i = 0; i < count; i++)
+            list.emplace_back(std::string(32, 'a') + std::to_string(i));
+        return list;
+    }
+}
+
+TEST_CASE(retireLeavesNull)
+{
+    JReclaimer reclaimer(false);
+    JObject jo = strings(10);
+    reclaimer.retire(std::move(jo));
+    CHECK(jo.getType() == JValueType::JNull);
+    CHECK(reclaimer.pending() == 1);
+
+    JObject scalar(5);
+    reclaimer.retire(std::move(scalar));
+    CHECK(scalar.getType() == JValueType::JNull);
+    CHECK(reclaimer.pending() == 1);
+}
+
+TEST_CASE(collectCountsElements)
+{
+    JReclaimer reclaimer(false);
+    size_t before = qtest::allocatedBytes();
+    reclaimer.retire(strings(100000));
+    size_t retired = qtest::allocatedBytes() - before;
+
+    // One call frees no more than its budget, however wide the list is.
+    CHECK(reclaimer.collect(1) == 1);
+    CHECK(reclaimer.pending() == 1);
+    CHECK(reclaimer.collect(1000) == 1000);
+    CHECK(qtest::allocatedBytes() - before > retired * 9 / 10);
+
+    size_t calls = 0;
+    while (reclaimer.pending() > 0)
+    {
+        CHECK(reclaimer.collect(1000) <= 1000);
+        calls++;
+    }
+    CHECK(calls >= 99);
+    CHECK(qtest::allocatedBytes() - before < 1024);
+}
+
+TEST_CASE(collectReachesNestedContainers)
+{
+    JReclaimer reclaimer(false);
+    JObject jo = JParser().parse("{\"a\": [[1, \"x\"], {\"b\": [true]}], \"c\": {\"d\": {}}}");
+    reclaimer.retire(std::move(jo));
+    size_t freed = 0;
+    size_t calls = 0;
+    while (reclaimer.pending() > 0)
+    {
+        size_t step = reclaimer.collect(2);
+        CHECK(step <= 2);
+        freed += step;
+        calls++;
+    }
+    CHECK(calls > 1);
+    CHECK(freed >= 7);
+}
+
+TEST_CASE(collectFreesPackedCaches)
+{
+    size_t before = qtest::allocatedBytes();
+    {
+        JReclaimer reclaimer(false);
+        JObject jo = JParser().parse("[1,2,3,4,5,6,7,8]");
+        const JObject& constJo = jo;
+        CHECK(constJo[3].getInt() == 4);
+        CHECK(constJo.getList().size() == 8);
+        reclaimer.retire(std::move(jo));
+        CHECK(reclaimer.collect(4) == 4);
+        CHECK(reclaimer.pending() == 1);
+        reclaimer.drain();
+        CHECK(reclaimer.pending() == 0);
+    }
+    CHECK(qtest::allocatedBytes() == before);
+}
+
+TEST_CASE(retireOnlyReleasesSharedValues)
+{
+    JReclaimer reclaimer(false);
+    JObject jo = JParser().parse("[\"a\", \"b\", [\"c\"]]");
+    JObject copy = jo;
+    reclaimer.retire(std::move(jo));
+    CHECK(reclaimer.pending() == 0);
+    CHECK(copy == JParser().parse("[\"a\", \"b\", [\"c\"]]"));
+}
+
+TEST_CASE(backgroundThreadDrains)
+{
+    size_t before = qtest::allocatedBytes();
+    {
+        JReclaimer reclaimer;
+        for (int i = 0; i < 8; i++)
+            reclaimer.retire(strings(10000));
+        reclaimer.drain();
+        CHECK(reclaimer.pending() == 0);
+        CHECK(qtest::allocatedBytes() < before + 64 * 1024);
+
+        // The destructor frees what is still retired.
+        reclaimer.retire(strings(10000));
+    }
+    CHECK(qtest::allocatedBytes() <= before);
+}
@@ -0,0 +1,121 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+#include <random>
+#include <string>
+
+using namespace qjson;
+
+namespace
+{
+    JParser keepingParser()
+    {
+        JParserOptions options;
+        options.keepSource = true;
+        return JParser(options);
+    }
+
+    JObject applyEdit(JParser& parser, const JObject& previous, std::string& text, size_t offset, size_t removed,
+        std::string_view inserted)
+    {
+        JObject next = parser.reparse(previous, text, { offset, removed, inserted });
+        text.replace(offset, removed, inserted);
+        return next;
+    }
+}
+
+TEST_CASE(reparseMatchesFullParse)
+{
+    JParser parser = keepingParser();
+    std::string text = "{ \"a\" : [ 1 , 2 , 3 ], \"b\" : { \"c\" : [ \"x\" ] }, \"d\" : [ [ 4 ], [ 5 ] ] }";
+    JObject jo = parser.parse(text);
+
+    jo = applyEdit(parser, jo, text, text.find('2'), 1, "20");
+    CHECK(jo == JParser().parse(text));
+    jo = applyEdit(parser, jo, text, text.find("\"x\""), 3, "\"y\", true");
+    CHECK(jo == JParser().parse(text));
+    jo = applyEdit(parser, jo, text, text.find('5'), 1, "{ \"e\" : null }");
+    CHECK(jo == JParser().parse(text));
+    // Replacing a closing bracket changes the structure, so an enclosing container is reparsed.
+    jo = applyEdit(parser, jo, text, text.find("] }"), 1, ", 7 ]");
+    CHECK(jo == JParser().parse(text));
+    CHECK(JParser().parse(JWriter().write(jo)) == JParser().parse(text));
+}
+
+TEST_CASE(reparseKeepsUnchangedSubtrees)
+{
+    JParser parser = keepingParser();
+    std::string text = "[ { \"a\" : [ 1 ] }, { \"b\" : [ 2 ] } ]";
+    JObject previous = parser.parse(text);
+    JObject next = applyEdit(parser, previous, text, text.find('2'), 1, "3");
+    const JObject& constPrevious = previous;
+    const JObject& constNext = next;
+    CHECK(&constPrevious[0].getDict() == &constNext[0].getDict());
+    CHECK(constNext[0].getSource() == "{ \"a\" : [ 1 ] }");
+    CHECK(constNext[1]["b"].getSource() == "[ 3 ]");
+    // The containers around the edit are written again.
+    CHECK(constNext.getSource().empty());
+    CHECK(JWriter().write(next) == "[{ \"a\" : [ 1 ] },{\"b\":[ 3 ]}]");
+    // The previous object still writes its own text.
+    CHECK(JWriter().write(previous) == "[ { \"a\" : [ 1 ] }, { \"b\" : [ 2 ] } ]");
+}
+
+TEST_CASE(reparseComparesTheOldText)
+{
+    JParser parser = keepingParser();
+    std::string text = "[ [ 1 ], [ 2 ] ]";
+    JObject previous = parser.parse(text);
+    // Same size, different content: the kept text doesn't match, so the new text is parsed in full.
+    std::string other = "[ [ 8 ], [ 9 ] ]";
+    JObject next = parser.reparse(previous, other, { other.find('9'), 1, "7" });
+    CHECK(next == JParser().parse("[ [ 8 ], [ 7 ] ]"));
+
+    CHECK_THROWS(parser.reparse(previous, text, { text.size(), 1, "" }), std::logic_error);
+}
+
+TEST_CASE(reparseWithoutSourceParsesInFull)
+{
+    JParser parser = keepingParser();
+    std::string text = "[1,2]";
+    JObject previous = JParser().parse(text);
+    JObject next = parser.reparse(previous, text, { 1, 1, "5" });
+    CHECK(next == JParser().parse("[5,2]"));
+    CHECK_THROWS(parser.reparse(previous, text, { 4, 1, "," }), std::logic_error);
+}
+
+TEST_CASE(reparseReleasesOldText)
+{
+    std::string text = "[";
+    for (int i = 0; i < 1000; i++)
+        text += (i ? ", " : "") + std::string("{ \"id\" : ") + std::to_string(i) + ", \"v\" : [ 0 ] }";
+    text += "]";
+    JParser parser = keepingParser();
+    JObject jo = parser.parse(text);
+    size_t parsed = jo.memoryUsage().sources;
+
+    std::mt19937 random(7);
+    for (int i = 0; i < 500; i++)
+    {
+        size_t offset = text.find("[ ", 1 + random() % (text.size() - 16)) + 2;
+        size_t removed = text.find(' ', offset) - offset;
+        jo = applyEdit(parser, jo, text, offset, removed, std::to_string(i));
+    }
+    CHECK(jo == JParser().parse(text));
+    // Each edit keeps only the text of the list it changed, not a copy of the document.
+    CHECK(jo.memoryUsage().sources < parsed + 500 * 256);
+}
@@ -0,0 +1,121 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+using namespace qjson;
+
+namespace
+{
+    const char* records = "[{\"id\":1,\"name\":\"a\",\"tags\":[1]},{\"id\":2,\"name\":\"b\",\"tags\":[]},"
+        "{\"id\":3,\"name\":\"c\",\"tags\":[3,4]}]";
+}
+
+TEST_CASE(repeatedKeySequencesShareShapes)
+{
+    JObject jo = JParser().parse(records);
+    const JObject& constJo = jo;
+    // The first dict with a key sequence keeps its own table; the ones after it share the shape.
+    CHECK(!constJo[0].isShaped());
+    CHECK(constJo[1].isShaped());
+    CHECK(constJo[2].isShaped());
+    CHECK(constJo[2]["name"].getString() == "c");
+    CHECK(constJo[1].hasMember("tags"));
+    CHECK(!constJo[1].hasMember("missing"));
+    CHECK(constJo[2].find("id")->getInt() == 3);
+    CHECK(constJo[2].find("missing") == nullptr);
+    CHECK(constJo[1].getDict().size() == 3);
+}
+
+TEST_CASE(shapesDependOnKeyOrder)
+{
+    JObject jo = JParser().parse("[{\"a\":1,\"b\":2},{\"b\":3,\"a\":4},{\"a\":5,\"b\":6}]");
+    const JObject& constJo = jo;
+    CHECK(!constJo[1].isShaped());
+    CHECK(constJo[2].isShaped());
+    CHECK(constJo[1]["a"].getInt() == 4);
+}
+
+TEST_CASE(shapedDictsEqualPlainOnes)
+{
+    JObject shaped = JParser().parse(records);
+    JParserOptions options;
+    options.shareShapes = false;
+    JObject plain = JParser(options).parse(records);
+    const JObject& constPlain = plain;
+    CHECK(!constPlain[1].isShaped());
+    CHECK(shaped == plain);
+    CHECK(shaped.hash() == plain.hash());
+    CHECK(JParser().parse(JWriter().write(shaped)) == plain);
+    CHECK(JWriter().canonicalWrite(shaped) == JWriter().canonicalWrite(plain));
+}
+
+TEST_CASE(shapedDictsAreWrittenInKeyOrder)
+{
+    JObject jo = JParser().parse("[{\"z\":1,\"a\":2},{\"z\":3,\"a\":4}]");
+    std::string written = JWriter().write(jo);
+    CHECK(written.find("{\"z\":3,\"a\":4}") != std::string::npos);
+}
+
+TEST_CASE(formatWriteReadsShapedDictsInPlace)
+{
+    JObject jo = JParser().parse(records);
+    size_t dicts = jo.memoryUsage().dicts;
+    std::string formatted = JWriter().formatWrite(jo);
+    CHECK(jo.memoryUsage().dicts == dicts);
+    CHECK(formatted.find("\"id\": 3,\n") != std::string::npos);
+    CHECK(JParser().parse(formatted) == jo);
+}
+
+TEST_CASE(mutableAccessUnshapes)
+{
+    JObject jo = JParser().parse(records);
+    JObject copy = jo;
+    jo[1]["extra"] = true;
+    const JObject& constJo = jo;
+    const JObject& constCopy = copy;
+    CHECK(!constJo[1].isShaped());
+    CHECK(constJo[1]["name"].getString() == "b");
+    CHECK(constJo[1]["extra"].getBool());
+    // The copy still has its shaped dict.
+    CHECK(constCopy[1].isShaped());
+    CHECK(!constCopy[1].hasMember("extra"));
+}
+
+TEST_CASE(duplicateKeysKeepTheLastValue)
+{
+    JObject jo = JParser().parse("[{\"a\":1,\"a\":2},{\"a\":3,\"a\":4}]");
+    const JObject& constJo = jo;
+    CHECK(constJo[0]["a"].getInt() == 2);
+    CHECK(constJo[1]["a"].getInt() == 4);
+    CHECK(constJo[1].getDict().size() == 1);
+}
+
+TEST_CASE(shapesAreCountedOnce)
+{
+    std::string data = "[";
+    for (int i = 0; i < 100; i++)
+        data += (i ? "," : "") + std::string("{\"first\":1,\"second\":2}");
+    data += "]";
+    JMemoryUsage usage = JParser().parse(data).memoryUsage();
+    CHECK(usage.shapes > 0);
+    CHECK(usage.shapes < 100 * 2 * sizeof(std::string));
+
+    JParserOptions options;
+    options.shareShapes = false;
+    JMemoryUsage plain = JParser(options).parse(data).memoryUsage();
+    CHECK(usage.dicts + usage.shapes < plain.dicts);
+}
@@ -0,0 +1,93 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+
+using namespace qjson;
+
+namespace
+{
+    JObject parseKept(std::string_view data)
+    {
+        JParserOptions options;
+        options.keepSource = true;
+        return JParser(options).parse(data);
+    }
+}
+
+TEST_CASE(keptSourceIsWrittenVerbatim)
+{
+    std::string data = "{ \"a\" : [ 1 , 2.50 ],\n  \"b\" : { \"c\" : \"\\u0041\" } }";
+    JObject jo = parseKept(data);
+    CHECK(jo.getSource() == data);
+    CHECK(JWriter().write(jo) == data);
+    const JObject& constJo = jo;
+    CHECK(constJo["a"].getSource() == "[ 1 , 2.50 ]");
+}
+
+TEST_CASE(sourceIsNotKeptByDefault)
+{
+    JObject jo = JParser().parse("[ 1 , 2 ]");
+    CHECK(jo.getSource().empty());
+    CHECK(JWriter().write(jo) == "[1,2]");
+}
+
+TEST_CASE(modifiedContainersAreWrittenAgain)
+{
+    JObject jo = parseKept("[ [ 1 ], [ 2 ] ]");
+    jo[0].push_back(3);
+    std::string written = JWriter().write(jo);
+    CHECK(JParser().parse(written)[0].getList().size() == 2);
+    CHECK(written.find("[ 2 ]") != std::string::npos);
+}
+
+TEST_CASE(trailingCommaIsNotWrittenBack)
+{
+    JObject jo = parseKept("[1,2,]");
+    CHECK(jo.getSource().empty());
+    CHECK(JWriter().write(jo) == "[1,2]");
+
+    JObject dict = parseKept("{\"a\":1,}");
+    CHECK(JWriter().write(dict) == "{\"a\":1}");
+}
+
+TEST_CASE(nestedTrailingCommaDropsEnclosingSources)
+{
+    JObject jo = parseKept("[ [ 1 ], { \"a\" : [ 2 , ] } , [ 3 ] ]");
+    const JObject& constJo = jo;
+    CHECK(constJo.getSource().empty());
+    CHECK(constJo[1].getSource().empty());
+    CHECK(constJo[1]["a"].getSource().empty());
+    // Siblings without a trailing comma keep theirs.
+    CHECK(constJo[0].getSource() == "[ 1 ]");
+    CHECK(constJo[2].getSource() == "[ 3 ]");
+
+    std::string written = JWriter().write(jo);
+    CHECK(written.find(",]") == std::string::npos);
+    CHECK(JParser().parse(written) == JParser().parse("[[1],{\"a\":[2]},[3]]"));
+}
+
+TEST_CASE(reparseIntroducingTrailingCommaDropsSources)
+{
+    std::string oldText = "{ \"a\" : [ 1 , 2 ] }";
+    JParserOptions options;
+    options.keepSource = true;
+    JParser parser(options);
+    JObject previous = parser.parse(oldText);
+    size_t offset = oldText.find('2') + 1;
+    JObject next = parser.reparse(previous, oldText, { offset, 0, " ," });
+    CHECK(JWriter().write(next) == "{\"a\":[1,2]}");
+}
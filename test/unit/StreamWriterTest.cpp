@@ -0,0 +1,108 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+#include <QuqiParser/JsonStreamWriter.h>
+
+#include <stdexcept>
+#include <string>
+
+using namespace qjson;
+
+namespace
+{
+    // Dicts have one member each, since JWriter writes members in hash order.
+    // A raw value is copied as it is, so only compact output can match it.
+    void writeSample(JStreamWriter& writer, bool raw)
+    {
+        writer.beginArray()
+            .value(7)
+            .value("a\"b")
+            .value(true)
+            .null()
+            .beginArray().value(1).value(2.5).beginObject().endObject().endArray()
+            .beginObject().key("k").beginArray().value(-3).endArray().endObject()
+            .beginArray();
+        if (raw)
+            writer.rawValue("{\"x\":[]}");
+        writer.endArray().endArray();
+    }
+}
+
+TEST_CASE(streamOutputMatchesJWriter)
+{
+    JStreamWriter compact;
+    writeSample(compact, true);
+    CHECK(compact.isComplete());
+    std::string text = compact.release();
+    JObject jo = JParser::fastParse(text);
+    CHECK(text == JWriter().write(jo));
+
+    JStreamWriter formatted(true);
+    writeSample(formatted, false);
+    std::string formattedText = formatted.release();
+    CHECK(formattedText == JWriter().formatWrite(JParser::fastParse(formattedText)));
+}
+
+TEST_CASE(writersEscapeStringsAlike)
+{
+    // Every writer goes through JWriter::writeString, so a string is written the same way by all.
+    const std::string data("q\"b\\s/\b\f\n\r\t\x01\x1f\xc3\xa9 end");
+    const std::string expected = "\"q\\\"b\\\\s/\\b\\f\\n\\r\\t\\u0001\\u001f\xc3\xa9 end\"";
+    std::string escaped;
+    JWriter::writeString(escaped, data);
+    CHECK(escaped == expected);
+
+    JObject jo(std::string_view{ data });
+    CHECK(JWriter().write(jo) == expected);
+    CHECK(JWriter().formatWrite(jo) == expected);
+    CHECK(JWriter().canonicalWrite(jo) == expected);
+
+    JStreamWriter writer;
+    writer.beginObject().key(data).value(data).endObject();
+    CHECK(writer.release() == "{" + expected + ":" + expected + "}");
+    CHECK(JParser::fastParse(expected).getString() == data);
+}
+
+TEST_CASE(streamWriterFlushesToSink)
+{
+    std::string out;
+    size_t calls = 0;
+    {
+        JStreamWriter writer([&](std::string_view chunk) { out += chunk; calls++; }, false, 16);
+        writer.beginArray();
+        for (int i = 0; i < 100; i++)
+            writer.value(i);
+        writer.endArray();
+        writer.flush();
+    }
+    CHECK(calls > 1);
+    JObject jo = JParser::fastParse(out);
+    CHECK(jo.getList().size() == 100 && jo[99].getInt() == 99);
+}
+
+TEST_CASE(streamWriterRejectsMisuse)
+{
+    JStreamWriter writer;
+    writer.beginObject();
+    CHECK_THROWS(writer.value(1), std::logic_error);
+    CHECK_THROWS(writer.endArray(), std::logic_error);
+    writer.key("a");
+    CHECK_THROWS(writer.key("b"), std::logic_error);
+    CHECK_THROWS(writer.endObject(), std::logic_error);
+    writer.value(1).endObject();
+    CHECK_THROWS(writer.value(2), std::logic_error);
+}
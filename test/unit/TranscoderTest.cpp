@@ -0,0 +1,101 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/JsonTranscoder.h>
+
+#include <stdexcept>
+#include <string>
+
+using namespace qjson;
+
+namespace
+{
+    // Feeds the input one byte at a time, so every token is split across chunks.
+    std::string minifyByBytes(std::string_view data)
+    {
+        JTranscoder transcoder;
+        for (char c : data)
+            transcoder.feed(std::string_view(&c, 1));
+        transcoder.finish();
+        return transcoder.release();
+    }
+}
+
+TEST_CASE(minifiesAndPrettifies)
+{
+    std::string data = " { \"a\" : [ 1 , -0.5e+3 , \"x \\\" y\" , true , false , null , [ ] ] , \"b\" : { } } ";
+    std::string minified = "{\"a\":[1,-0.5e+3,\"x \\\" y\",true,false,null,[]],\"b\":{}}";
+    CHECK(JTranscoder::minify(data) == minified);
+    CHECK(minifyByBytes(data) == minified);
+    CHECK(JTranscoder::prettify("{\"a\":[1,{}],\"b\":2}", 2) == "{\n  \"a\": [\n    1,\n    {}\n  ],\n  \"b\": 2\n}");
+    CHECK(JTranscoder::minify(JTranscoder::prettify(minified)) == minified);
+}
+
+TEST_CASE(dropsTrailingCommasAndSplitsLines)
+{
+    CHECK(JTranscoder::minify("[1,2,]") == "[1,2]");
+    CHECK(JTranscoder::minify("{\"a\":1,}") == "{\"a\":1}");
+    CHECK(JTranscoder::minify("{\"a\":1} [2] 3") == "{\"a\":1}\n[2]\n3");
+}
+
+TEST_CASE(acceptsEveryNumberForm)
+{
+    for (const char* data : { "0", "-0", "12", "-12", "0.5", "1.25", "1e5", "1E+5", "1e-5", "-0.0e0", "10.01E10" })
+    {
+        std::string wrapped = std::string("[") + data + "]";
+        CHECK(JTranscoder::minify(wrapped) == wrapped);
+        CHECK(minifyByBytes(wrapped) == wrapped);
+        CHECK(JTranscoder::minify(data) == data);
+    }
+}
+
+TEST_CASE(copiesEscapesVerbatim)
+{
+    std::string data = "[\"\\u00e9\\ud83d\\ude00\\n\\/\\\\\\\"\"]";
+    CHECK(JTranscoder::minify(data) == data);
+    CHECK(minifyByBytes(data) == data);
+    CHECK(JTranscoder::minify("1\ttrue\r\n\"a\" []") == "1\ntrue\n\"a\"\n[]");
+}
+
+TEST_CASE(rejectsMalformedScalars)
+{
+    for (const char* data : { "[tru]", "[nope]", "[1.2.3]", "[--1]", "[01]", "[1.]", "[.5]", "[1e]", "[1e+]",
+        "[-]", "[+1]", "[truex]", "[true1]", "[nul", "fals", "1x", "[1 2]", "[\"a\" \"b\"]",
+        "\"a\\qb\"", "\"\\u12\"", "[\"\\u12g4\"]", "[\"\\ud83d\"]", "[\"\\ud83dx\"]", "[\"\\ud83d\\n\"]",
+        "[\"\\ud83d\\u0041\"]", "[\"\\ude00\"]", "1true", "\"a\"\"b\"", "[1]2", "{}{}", "null[]" })
+    {
+        CHECK_THROWS(JTranscoder::minify(data), std::logic_error);
+        CHECK_THROWS(minifyByBytes(data), std::logic_error);
+    }
+}
+
+TEST_CASE(rejectsMalformedStructure)
+{
+    for (const char* data : { "[", "{\"a\"}", "{\"a\":}", "{1:2}", "[1]]", "[}", "\"open", "[,1]", "{\"a\"::1}" })
+        CHECK_THROWS(JTranscoder::minify(data), std::logic_error);
+}
+
+TEST_CASE(transcoderFlushesToSink)
+{
+    std::string out;
+    JTranscoder transcoder([&out](std::string_view chunk) { out += chunk; }, { true, 1, '\t' }, 8);
+    transcoder.feed("[1,[2");
+    transcoder.feed(",3]]");
+    transcoder.finish();
+    CHECK(out == "[\n\t1,\n\t[\n\t\t2,\n\t\t3\n\t]\n]");
+    transcoder.reset();
+    CHECK(transcoder.getBuffer().empty());
+}
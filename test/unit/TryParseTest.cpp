@@ -0,0 +1,104 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Ini.h>
+#include <QuqiParser/Json.h>
+
+using namespace qjson;
+using namespace qini;
+
+TEST_CASE(tryParseReportsErrorCodes)
+{
+    JParser parser;
+    JParseResult ok = parser.tryParse("{\"a\": [1, 2]}");
+    CHECK(ok);
+    CHECK(ok.value["a"][1].getInt() == 2);
+
+    JParseResult result = parser.tryParse("[1, 2,, 3]");
+    CHECK(!result);
+    CHECK(result.error.code == JErrorCode::UnexpectedCharacter);
+    CHECK(result.error.offset == 6);
+    CHECK(result.value.getType() == JValueType::JNull);
+
+    CHECK(parser.tryParse("").error.code == JErrorCode::Empty);
+    CHECK(parser.tryParse("[1, 2").error.code == JErrorCode::UnexpectedEnd);
+    CHECK(parser.tryParse("[tru]").error.code == JErrorCode::InvalidLiteral);
+    CHECK(parser.tryParse("[-]").error.code == JErrorCode::InvalidNumber);
+    CHECK(parser.tryParse("\"\\q\"").error.code == JErrorCode::InvalidString);
+}
+
+TEST_CASE(tryParseMatchesParse)
+{
+    JParser parser;
+    CHECK_THROWS(parser.parse("{\"a\" 1}"), std::logic_error);
+    CHECK(parser.tryParse("{\"a\" 1}").error.code == JErrorCode::UnexpectedCharacter);
+    CHECK(parser.tryParse("{\"a\": 1}").value == parser.parse("{\"a\": 1}"));
+}
+
+TEST_CASE(tryParseIntoReportsErrors)
+{
+    JParser parser;
+    JObject jo;
+    CHECK(!parser.tryParseInto("[1, 2, 3]", jo));
+    CHECK(jo.getList().size() == 3);
+    JParseError error = parser.tryParseInto("[1, }", jo);
+    CHECK(error.code == JErrorCode::UnexpectedCharacter);
+    CHECK(error.offset == 4);
+    CHECK(!parser.tryParseInto("{\"b\": null}", jo));
+    CHECK(jo["b"].getType() == JValueType::JNull);
+}
+
+TEST_CASE(tryGettersDontThrow)
+{
+    JObject jo = JParser().parse("{\"i\": 3, \"d\": 1.5, \"b\": true, \"s\": \"x\", \"l\": [7]}");
+    CHECK(jo["i"].tryGetInt() == 3);
+    CHECK(!jo["i"].tryGetDouble());
+    CHECK(jo["d"].tryGetDouble() == 1.5L);
+    CHECK(!jo["d"].tryGetInt());
+    CHECK(jo["b"].tryGetBool() == true);
+    CHECK(!jo["s"].tryGetBool());
+    CHECK(*jo["s"].tryGetString() == "x");
+    CHECK(jo["i"].tryGetString() == nullptr);
+
+    CHECK(jo.find("i") != nullptr);
+    CHECK(jo.find("missing") == nullptr);
+    CHECK(jo.find(0) == nullptr);
+    CHECK(jo["l"].find(0)->getInt() == 7);
+    CHECK(jo["l"].find(1) == nullptr);
+    CHECK(jo["l"].find("i") == nullptr);
+}
+
+TEST_CASE(iniTryParseReportsErrors)
+{
+    INIParser parser;
+    INIParseResult ok = parser.tryParse("[server]\nport=80\n");
+    CHECK(ok);
+    CHECK(*ok.value.find("server", "port") == "80");
+    CHECK(ok.value.find("server", "host") == nullptr);
+    CHECK(ok.value.find("client", "port") == nullptr);
+
+    INIParseResult outside = parser.tryParse("port=80\n");
+    CHECK(outside.error.code == INIErrorCode::KeyOutsideSection);
+    CHECK(outside.error.offset == 0);
+
+    INIParseResult noEquals = parser.tryParse("[a]\nkey value\n");
+    CHECK(noEquals.error.code == INIErrorCode::UnexpectedCharacter);
+    CHECK(noEquals.error.offset == 7);
+    CHECK(noEquals.value == INIObject());
+
+    CHECK(parser.tryParse("[a").error.code == INIErrorCode::UnexpectedEnd);
+    CHECK_THROWS(parser.parse("[a]\n=1\n"), std::logic_error);
+}
@@ -0,0 +1,86 @@
+﻿//    Copyright 2023-2024 Xuan Xiao
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+
+#include "Check.h"
+
+#include <QuqiParser/Json.h>
+#include <QuqiParser/JsonReader.h>
+
+#include <string>
+
+using namespace qjson;
+
+namespace
+{
+    std::string readString(std::string_view data)
+    {
+        JReader reader(data);
+        reader.next();
+        return std::string(reader.getString());
+    }
+}
+
+TEST_CASE(readerDecodesUnicodeEscapes)
+{
+    CHECK(readString("\"\\u0041\"") == "A");
+    CHECK(readString("\"\\u00e9\"") == "\xC3\xA9");
+    CHECK(readString("\"\\u4E2D!\"") == "\xE4\xB8\xAD!");
+    CHECK(readString("\"a\\ud83d\\ude00b\"") == "a\xF0\x9F\x98\x80" "b");
+    CHECK(readString("\"\\n\\u0022\\/\"") == "\n\"/");
+}
+
+TEST_CASE(readerRejectsBadUnicodeEscapes)
+{
+    CHECK_THROWS(readString("\"\\u00g1\""), std::logic_error);
+    CHECK_THROWS(readString("\"\\u12\""), std::logic_error);
+    CHECK_THROWS(readString("\"\\ud83d\""), std::logic_error);
+    CHECK_THROWS(readString("\"\\ud83d\\u0041\""), std::logic_error);
+    CHECK_THROWS(readString("\"\\ude00\""), std::logic_error);
+}
+
+TEST_CASE(readerMatchesParserOnEscapes)
+{
+    std::string data = "[\"\\u00e9\\ud834\\udd1e\\t\"]";
+    JParser parser;
+    JObject jo = parser.parse(data);
+    JReader reader(data);
+    reader.next();
+    reader.next();
+    CHECK(reader.getString() == jo[0].getString());
+}
+
+TEST_CASE(parserDecodesUnicodeEscapes)
+{
+    JParser parser;
+    CHECK(parser.parse("\"\\u0041\\u00e9\"").getString() == "A\xC3\xA9");
+    CHECK(parser.parse("\"\\ud83d\\ude00\"").getString() == "\xF0\x9F\x98\x80");
+    CHECK(parser.tryParse("\"\\ud83d\"").error.code == JErrorCode::InvalidString);
+    CHECK(parser.tryParse("\"\\ude00\"").error.code == JErrorCode::InvalidString);
+    CHECK(parser.tryParse("\"\\uzzzz\"").error.code == JErrorCode::InvalidString);
+}
+
+TEST_CASE(parserValidatesUtf8)
+{
+    CHECK(JParser::isValidUtf8("plain \xC3\xA9 \xE4\xB8\xAD \xF0\x9F\x98\x80"));
+    CHECK(!JParser::isValidUtf8("\xC3"));
+    CHECK(!JParser::isValidUtf8("\xC0\xAF"));
+    CHECK(!JParser::isValidUtf8("\xED\xA0\x80"));
+    CHECK(!JParser::isValidUtf8("\xF4\x90\x80\x80"));
+
+    JParserOptions options;
+    options.validateUtf8 = true;
+    JParser strict(options);
+    CHECK(strict.tryParse("\"\xFF\"").error.code == JErrorCode::InvalidUtf8);
+    CHECK(strict.parse("\"\xC3\xA9\"").getString() == "\xC3\xA9");
+}